@@ -50,6 +50,9 @@
 #define CMD_READ_SECTOR_RETRY 0x20      /* READ SECTOR with retries. */
 #define CMD_WRITE_SECTOR_RETRY 0x30     /* WRITE SECTOR with retries. */
 
+/* Most sectors one READ SECTOR or WRITE SECTOR command transfers. */
+#define MAX_SECTOR_CNT 256
+
 /* An ATA device. */
 struct ata_disk
   {
@@ -85,7 +88,12 @@ static void reset_channel (struct channel *);
 static bool check_device_type (struct ata_disk *);
 static void identify_ata_device (struct ata_disk *);
 
-static void select_sector (struct ata_disk *, block_sector_t);
+static void ide_read_multiple (void *, block_sector_t, size_t,
+                               void *const[]);
+static void ide_write_multiple (void *, block_sector_t, size_t,
+                                const void *const[]);
+
+static void select_sector (struct ata_disk *, block_sector_t, size_t cnt);
 static void issue_pio_command (struct channel *, uint8_t command);
 static void input_sector (struct channel *, void *);
 static void output_sector (struct channel *, const void *);
@@ -344,16 +352,7 @@ descramble_ata_string (char *string, int size)
 static void
 ide_read (void *d_, block_sector_t sec_no, void *buffer)
 {
-  struct ata_disk *d = d_;
-  struct channel *c = d->channel;
-  lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_READ_SECTOR_RETRY);
-  sema_down (&c->completion_wait);
-  if (!wait_while_busy (d))
-    PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no);
-  input_sector (c, buffer);
-  lock_release (&c->lock);
+  ide_read_multiple (d_, sec_no, 1, &buffer);
 }
 
 /* Write sector SEC_NO to disk D from BUFFER, which must contain
@@ -363,37 +362,97 @@ ide_read (void *d_, block_sector_t sec_no, void *buffer)
    per-disk locking is unneeded. */
 static void
 ide_write (void *d_, block_sector_t sec_no, const void *buffer)
+{
+  ide_write_multiple (d_, sec_no, 1, &buffer);
+}
+
+/* Reads the CNT sectors starting at SEC_NO from disk D, sector
+   SEC_NO + I into BUFFERS[I], each of which must have room for
+   BLOCK_SECTOR_SIZE bytes.  Up to MAX_SECTOR_CNT sectors are
+   read with one command, which interrupts once per sector.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+static void
+ide_read_multiple (void *d_, block_sector_t sec_no, size_t cnt,
+                   void *const buffers[])
 {
   struct ata_disk *d = d_;
   struct channel *c = d->channel;
+  size_t i;
+
   lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
-  if (!wait_while_busy (d))
-    PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
-  output_sector (c, buffer);
-  sema_down (&c->completion_wait);
+  for (i = 0; i < cnt; i++)
+    {
+      if (i % MAX_SECTOR_CNT == 0)
+        {
+          size_t left = cnt - i;
+          select_sector (d, sec_no + i,
+                         left < MAX_SECTOR_CNT ? left : MAX_SECTOR_CNT);
+          issue_pio_command (c, CMD_READ_SECTOR_RETRY);
+        }
+      sema_down (&c->completion_wait);
+      if (!wait_while_busy (d))
+        PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no + i);
+      input_sector (c, buffers[i]);
+    }
+  lock_release (&c->lock);
+}
+
+/* Writes the CNT sectors starting at SEC_NO to disk D, sector
+   SEC_NO + I from BUFFERS[I], each of which must contain
+   BLOCK_SECTOR_SIZE bytes.  Up to MAX_SECTOR_CNT sectors are
+   written with one command, which interrupts once per sector.
+   Returns after the disk has acknowledged receiving the data.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+static void
+ide_write_multiple (void *d_, block_sector_t sec_no, size_t cnt,
+                    const void *const buffers[])
+{
+  struct ata_disk *d = d_;
+  struct channel *c = d->channel;
+  size_t i;
+
+  lock_acquire (&c->lock);
+  for (i = 0; i < cnt; i++)
+    {
+      if (i % MAX_SECTOR_CNT == 0)
+        {
+          size_t left = cnt - i;
+          select_sector (d, sec_no + i,
+                         left < MAX_SECTOR_CNT ? left : MAX_SECTOR_CNT);
+          issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
+        }
+      if (!wait_while_busy (d))
+        PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no + i);
+      output_sector (c, buffers[i]);
+      sema_down (&c->completion_wait);
+    }
   lock_release (&c->lock);
 }
 
 static struct block_operations ide_operations =
   {
     ide_read,
-    ide_write
+    ide_write,
+    ide_read_multiple,
+    ide_write_multiple
   };
-
+
 /* Selects device D, waiting for it to become ready, and then
-   writes SEC_NO to the disk's sector selection registers.  (We
+   writes SEC_NO and the number of sectors CNT, at most
+   MAX_SECTOR_CNT, to the disk's sector selection registers.  (We
    use LBA mode.) */
 static void
-select_sector (struct ata_disk *d, block_sector_t sec_no)
+select_sector (struct ata_disk *d, block_sector_t sec_no, size_t cnt)
 {
   struct channel *c = d->channel;
 
-  ASSERT (sec_no < (1UL << 28));
+  ASSERT (sec_no + cnt <= (1UL << 28));
+  ASSERT (cnt > 0 && cnt <= MAX_SECTOR_CNT);
   
   select_device_wait (d);
-  outb (reg_nsect (c), 1);
+  outb (reg_nsect (c), cnt);  /* 256 wraps to 0, which means 256. */
   outb (reg_lbal (c), sec_no);
   outb (reg_lbam (c), sec_no >> 8);
   outb (reg_lbah (c), (sec_no >> 16));
@@ -5,9 +5,11 @@
 #include "devices/serial.h"
 #include "devices/timer.h"
 #include "threads/io.h"
+#include "threads/palloc.h"
 #include "threads/thread.h"
 #ifdef USERPROG
 #include "userprog/exception.h"
+#include "userprog/syscall.h"
 #endif
 #ifdef FILESYS
 #include "devices/block.h"
@@ -87,13 +89,22 @@ shutdown_reboot (void)
 void
 shutdown_power_off (void)
 {
-  const char s[] = "Shutdown";
-  const char *p;
-
 #ifdef FILESYS
   filesys_done ();
 #endif
 
+  shutdown_power_cut ();
+}
+
+/* Powers down the machine like shutdown_power_off(), but without
+   writing back the file system first, as if the power failed, so
+   that the next boot has to recover it from the journal. */
+void
+shutdown_power_cut (void)
+{
+  const char s[] = "Shutdown";
+  const char *p;
+
   print_stats ();
 
   printf ("Powering off...\n");
@@ -131,6 +142,7 @@ print_stats (void)
 {
   timer_print_stats ();
   thread_print_stats ();
+  palloc_print_stats ();
 #ifdef FILESYS
   block_print_stats ();
 #endif
@@ -138,5 +150,6 @@ print_stats (void)
   kbd_print_stats ();
 #ifdef USERPROG
   exception_print_stats ();
+  syscall_print_stats ();
 #endif
 }
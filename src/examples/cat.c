@@ -13,8 +13,8 @@ main (int argc, char *argv[])
   
   for (i = 1; i < argc; i++) 
     {
-      int fd = open (argv[i]);
-      if (fd < 0) 
+      FILE *f = fopen (argv[i], "r");
+      if (f == NULL) 
         {
           printf ("%s: open failed\n", argv[i]);
           success = false;
@@ -23,12 +23,12 @@ main (int argc, char *argv[])
       for (;;) 
         {
           char buffer[1024];
-          int bytes_read = read (fd, buffer, sizeof buffer);
+          size_t bytes_read = fread (buffer, 1, sizeof buffer, f);
           if (bytes_read == 0)
             break;
-          write (STDOUT_FILENO, buffer, bytes_read);
+          fwrite (buffer, 1, bytes_read, stdout);
         }
-      close (fd);
+      fclose (f);
     }
   return success ? EXIT_SUCCESS : EXIT_FAILURE;
 }
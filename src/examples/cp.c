@@ -5,10 +5,15 @@ Copies one file to another. */
 #include <stdio.h>
 #include <syscall.h>
 
+/* Bytes copied per system call. */
+#define CHUNK_SIZE 65536
+
 int
 main (int argc, char *argv[]) 
 {
   int in_fd, out_fd;
+  int bytes_copied;
+  unsigned ofs;
 
   if (argc != 3) 
     {
@@ -37,16 +42,15 @@ main (int argc, char *argv[])
       return EXIT_FAILURE;
     }
 
-  /* Copy data. */
-  for (;;) 
+  /* Copy data inside the kernel. */
+  for (ofs = 0;; ofs += bytes_copied) 
     {
-      char buffer[1024];
-      int bytes_read = read (in_fd, buffer, sizeof buffer);
-      if (bytes_read == 0)
+      bytes_copied = copy_file_range (in_fd, ofs, out_fd, ofs, CHUNK_SIZE);
+      if (bytes_copied == 0)
         break;
-      if (write (out_fd, buffer, bytes_read) != bytes_read) 
+      if (bytes_copied < 0) 
         {
-          printf ("%s: write failed\n", argv[2]);
+          printf ("%s: copy failed\n", argv[2]);
           return EXIT_FAILURE;
         }
     }
@@ -10,11 +10,14 @@ main (int argc, char *argv[])
 {
   bool success = true;
   int i;
+
+  /* Write the dump a buffer at a time, not a line at a time. */
+  setvbuf (stdout, NULL, _IOFBF, 0);
   
   for (i = 1; i < argc; i++) 
     {
-      int fd = open (argv[i]);
-      if (fd < 0) 
+      FILE *f = fopen (argv[i], "r");
+      if (f == NULL) 
         {
           printf ("%s: open failed\n", argv[i]);
           success = false;
@@ -23,13 +26,13 @@ main (int argc, char *argv[])
       for (;;) 
         {
           char buffer[1024];
-          int pos = tell (fd);
-          int bytes_read = read (fd, buffer, sizeof buffer);
+          long pos = ftell (f);
+          size_t bytes_read = fread (buffer, 1, sizeof buffer, f);
           if (bytes_read == 0)
             break;
           hex_dump (pos, buffer, bytes_read, true);
         }
-      close (fd);
+      fclose (f);
     }
   return success ? EXIT_SUCCESS : EXIT_FAILURE;
 }
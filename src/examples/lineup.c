@@ -15,32 +15,35 @@ int
 main (int argc, char *argv[])
 {
   char buf[1024];
-  int handle;
+  FILE *f;
 
   if (argc != 2)
     exit (1);
 
-  handle = open (argv[1]);
-  if (handle < 0)
+  f = fopen (argv[1], "r+");
+  if (f == NULL)
     exit (2);
 
   for (;;) 
     {
-      int n, i;
+      size_t n, i;
 
-      n = read (handle, buf, sizeof buf);
-      if (n <= 0)
+      n = fread (buf, 1, sizeof buf, f);
+      if (n == 0)
         break;
 
       for (i = 0; i < n; i++)
         buf[i] = toupper ((unsigned char) buf[i]);
 
-      seek (handle, tell (handle) - n);
-      if (write (handle, buf, n) != n)
+      fseek (f, -(long) n, SEEK_CUR);
+      if (fwrite (buf, 1, n, f) != n)
         printf ("write failed\n");
+
+      /* switching back from writing to reading needs a seek */
+      fseek (f, 0, SEEK_CUR);
     }
 
-  close (handle);
+  fclose (f);
 
   return EXIT_SUCCESS;
 }
@@ -1,18 +1,16 @@
 /* mcp.c
 
-   Copies one file to another, using mmap. */
+   Copies one file to another in a single call, letting the kernel
+   move the data.  (This used to map both files and memcpy between
+   them.) */
 
 #include <stdio.h>
-#include <string.h>
 #include <syscall.h>
 
 int
 main (int argc, char *argv[]) 
 {
   int in_fd, out_fd;
-  mapid_t in_map, out_map;
-  void *in_data = (void *) 0x10000000;
-  void *out_data = (void *) 0x20000000;
   int size;
 
   if (argc != 3) 
@@ -43,26 +41,12 @@ main (int argc, char *argv[])
       return EXIT_FAILURE;
     }
 
-  /* Map files. */
-  in_map = mmap (in_fd, in_data);
-  if (in_map == MAP_FAILED) 
-    {
-      printf ("%s: mmap failed\n", argv[1]);
-      return EXIT_FAILURE;
-    }
-  out_map = mmap (out_fd, out_data);
-  if (out_map == MAP_FAILED)
+  /* Copy files. */
+  if (copy_file_range (in_fd, 0, out_fd, 0, size) != size)
     {
-      printf ("%s: mmap failed\n", argv[2]);
+      printf ("%s: copy failed\n", argv[2]);
       return EXIT_FAILURE;
     }
 
-  /* Copy files. */
-  memcpy (out_data, in_data, size);
-
-  /* Unmap files (optional). */
-  munmap (in_map);
-  munmap (out_map);
-
   return EXIT_SUCCESS;
 }
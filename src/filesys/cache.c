@@ -1,7 +1,10 @@
 #include "filesys/cache.h"
 #include "filesys/filesys.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
+#include <debug.h>
 #include <list.h>
+#include <stdlib.h>
 #include <string.h>
 
 /* Index for the clock algorithm used for cache eviction. */
@@ -16,18 +19,24 @@ struct buffer_cache_entry
   bool dirty;         /* dirty bit */
   bool valid;         /* valid bit, false on init, always true after */
   bool used_recently; /* for clock algorithm */
+  bool pinned;        /* holds an uncommitted journal update, not evictable */
 
   block_sector_t disk_sector; /* sector the cache represents */
 
-  struct lock lock; /* lock for cache members */
+  struct lock lock; /* held while data is copied or transferred */
 };
 
 /* Our buffer cache, as suggested in the supplemental docs. */
 static struct buffer_cache_entry buffer_cache[BUFFER_CACHE_SIZE];
 
-/* A lock to maintain synchronization on the buffer cache. */
+/* Protects the mapping from sectors to entries (valid, disk_sector and
+   used_recently) and the clock hand.  It is never held while copying
+   data, so threads working on different sectors only contend on the
+   lock of the entry they touch. */
 static struct lock buffer_cache_lock;
 
+static struct buffer_cache_entry *buffer_cache_lookup (block_sector_t);
+
 /* Initialize the buffer cache system. */
 void
 buffer_cache_init (void)
@@ -41,6 +50,7 @@ buffer_cache_init (void)
       bce = &buffer_cache[i];
       bce->valid = false;
       bce->dirty = false;
+      bce->pinned = false;
       lock_init (&bce->lock);
     }
 }
@@ -49,6 +59,8 @@ buffer_cache_init (void)
 static void
 buffer_cache_flush_entry (struct buffer_cache_entry *bce)
 {
+  ASSERT (lock_held_by_current_thread (&bce->lock));
+
   block_write (fs_device, bce->disk_sector, bce->data);
   bce->dirty = false;
 }
@@ -64,18 +76,102 @@ buffer_cache_close (void)
   for (size_t i = 0; i < BUFFER_CACHE_SIZE; i++)
     {
       bce = &buffer_cache[i];
+      lock_acquire (&bce->lock);
       if (bce->valid && bce->dirty)
-        {
-          lock_acquire (&bce->lock);
-          buffer_cache_flush_entry (bce);
-          lock_release (&bce->lock);
-        }
+        buffer_cache_flush_entry (bce);
+      lock_release (&bce->lock);
     }
 
   lock_release (&buffer_cache_lock);
 }
 
-/* Obtian a buffer cache entry from the buffer cache if it exists. */
+/* Writes every dirty entry that is not pinned back to disk, leaving it
+   in the cache.  Pinned entries hold metadata whose journal transaction
+   has not committed yet and must not reach their home sector. */
+void
+buffer_cache_flush (void)
+{
+  struct buffer_cache_entry *bce;
+
+  for (size_t i = 0; i < BUFFER_CACHE_SIZE; i++)
+    {
+      bce = &buffer_cache[i];
+      lock_acquire (&bce->lock);
+      if (bce->valid && bce->dirty && !bce->pinned)
+        buffer_cache_flush_entry (bce);
+      lock_release (&bce->lock);
+    }
+}
+
+/* Compares two block sector numbers, for sort and binary_search. */
+int
+compare_sectors (const void *a_, const void *b_, void *aux UNUSED)
+{
+  const block_sector_t *a = a_;
+  const block_sector_t *b = b_;
+
+  return *a < *b ? -1 : *a > *b;
+}
+
+/* Writes back the dirty entries caching any of the CNT sectors in
+   SECTORS, which must be sorted in ascending order, in ascending sector
+   order.  Other entries and pinned entries are left alone.  Used to sync
+   a single file without flushing the whole cache. */
+void
+buffer_cache_flush_sectors (const block_sector_t *sectors, size_t cnt)
+{
+  block_sector_t dirty[BUFFER_CACHE_SIZE];
+  size_t dirty_cnt = 0;
+  struct buffer_cache_entry *bce;
+
+  /* find the cached sectors that need writing */
+  lock_acquire (&buffer_cache_lock);
+  for (size_t i = 0; i < BUFFER_CACHE_SIZE; i++)
+    {
+      bce = &buffer_cache[i];
+      if (bce->valid && bce->dirty && !bce->pinned
+          && binary_search (&bce->disk_sector, sectors, cnt, sizeof *sectors,
+                            compare_sectors, NULL)
+                 != NULL)
+        dirty[dirty_cnt++] = bce->disk_sector;
+    }
+  lock_release (&buffer_cache_lock);
+
+  sort (dirty, dirty_cnt, sizeof *dirty, compare_sectors, NULL);
+  for (size_t i = 0; i < dirty_cnt; i++)
+    {
+      lock_acquire (&buffer_cache_lock);
+      bce = buffer_cache_lookup (dirty[i]);
+      lock_release (&buffer_cache_lock);
+      if (bce == NULL)
+        continue; /* evicted, so already written */
+
+      lock_acquire (&bce->lock);
+      if (bce->valid && bce->disk_sector == dirty[i] && bce->dirty
+          && !bce->pinned)
+        buffer_cache_flush_entry (bce);
+      lock_release (&bce->lock);
+    }
+}
+
+/* Makes every pinned entry evictable again, once the journal
+   transaction covering them has committed. */
+void
+buffer_cache_unpin_all (void)
+{
+  struct buffer_cache_entry *bce;
+
+  for (size_t i = 0; i < BUFFER_CACHE_SIZE; i++)
+    {
+      bce = &buffer_cache[i];
+      lock_acquire (&bce->lock);
+      bce->pinned = false;
+      lock_release (&bce->lock);
+    }
+}
+
+/* Obtian a buffer cache entry from the buffer cache if it exists.
+   The caller must hold buffer_cache_lock. */
 static struct buffer_cache_entry *
 buffer_cache_lookup (block_sector_t sector)
 {
@@ -91,97 +187,176 @@ buffer_cache_lookup (block_sector_t sector)
   return NULL;
 }
 
-/* evict an entry using the clock algorithm */
+/* evict an entry using the clock algorithm and return it with its lock
+   held.  Entries that are busy (locked by another thread) or pinned by
+   the journal are skipped.  The caller must hold buffer_cache_lock. */
 static struct buffer_cache_entry *
 buffer_cache_evict (void)
 {
   struct buffer_cache_entry *bce;
+  size_t busy = 0;
 
   // clock algorithm
   while (true)
     {
       bce = &buffer_cache[clock];
+      clock++;
+      clock %= BUFFER_CACHE_SIZE;
+
+      if (!lock_try_acquire (&bce->lock))
+        {
+          /* every entry is in use, let the holders make progress */
+          if (++busy >= 2 * BUFFER_CACHE_SIZE)
+            {
+              thread_yield ();
+              busy = 0;
+            }
+          continue;
+        }
 
       /* if it is invalid (empty), just return it */
       if (!bce->valid)
         return bce;
 
+      /* uncommitted metadata stays until the journal commits it */
+      if (bce->pinned)
+        {
+          lock_release (&bce->lock);
+          if (++busy >= 2 * BUFFER_CACHE_SIZE)
+            {
+              thread_yield ();
+              busy = 0;
+            }
+          continue;
+        }
+
       /* don't return it if it is used recently */
       if (bce->used_recently)
         bce->used_recently = false;
       else
         {
-          /* if dirty, write to block */
+          /* if dirty, write to block.  This happens with the cache lock
+             held so nobody can read the old sector back from disk before
+             the write reaches it. */
           if (bce->dirty)
-            {
-              lock_acquire (&bce->lock);
-              buffer_cache_flush_entry (bce);
-              lock_release (&bce->lock);
-            }
+            buffer_cache_flush_entry (bce);
 
           /* now it is safe to return */
           bce->valid = false;
           return bce;
         }
-
-      clock++;
-      clock %= BUFFER_CACHE_SIZE;
+      lock_release (&bce->lock);
     }
 }
 
-/* read to buffer cache from block */
-void
-buffer_cache_read (block_sector_t sector, void *buffer)
+/* Returns the entry caching SECTOR with its lock held, bringing the
+   sector into the cache first if needed.  If LOAD is false the caller is
+   about to overwrite the whole sector, so a missing sector is not read
+   from disk. */
+static struct buffer_cache_entry *
+buffer_cache_get (block_sector_t sector, bool load)
 {
-  lock_acquire (&buffer_cache_lock);
-
-  struct buffer_cache_entry *bce = buffer_cache_lookup (sector);
+  struct buffer_cache_entry *bce;
 
-  /* if entry is not in the cache */
-  if (bce == NULL)
+  while (true)
     {
-      bce = buffer_cache_evict ();
+      lock_acquire (&buffer_cache_lock);
+      bce = buffer_cache_lookup (sector);
+
+      /* if entry is in the cache */
+      if (bce != NULL)
+        {
+          bce->used_recently = true;
+          lock_release (&buffer_cache_lock);
+
+          lock_acquire (&bce->lock);
+          /* the entry may have been recycled while we waited */
+          if (bce->valid && bce->disk_sector == sector)
+            return bce;
+          lock_release (&bce->lock);
+          continue;
+        }
 
+      bce = buffer_cache_evict ();
       bce->disk_sector = sector;
       bce->valid = true;
       bce->dirty = false;
-
-      /* read data from block */
-      lock_acquire (&bce->lock);
-      block_read (fs_device, sector, bce->data);
-      lock_release (&bce->lock);
+      bce->pinned = false;
+      bce->used_recently = true;
+      lock_release (&buffer_cache_lock);
+
+      /* read data from block, other threads wanting this sector wait on
+         the entry lock */
+      if (load)
+        block_read (fs_device, sector, bce->data);
+      return bce;
     }
+}
 
-  bce->used_recently = true;
+/* read to buffer cache from block */
+void
+buffer_cache_read (block_sector_t sector, void *buffer)
+{
+  buffer_cache_read_at (sector, buffer, 0, BLOCK_SECTOR_SIZE);
+}
+
+/* write from block to buffer cache */
+void
+buffer_cache_write (block_sector_t sector, const void *buffer)
+{
+  buffer_cache_write_at (sector, buffer, 0, BLOCK_SECTOR_SIZE);
+}
+
+/* Copies SIZE bytes starting at byte OFS of SECTOR into BUFFER. */
+void
+buffer_cache_read_at (block_sector_t sector, void *buffer, int ofs, int size)
+{
+  ASSERT (ofs >= 0 && size >= 0 && ofs + size <= BLOCK_SECTOR_SIZE);
+
+  struct buffer_cache_entry *bce = buffer_cache_get (sector, true);
 
   /* copy from cache data into memory */
-  memcpy (buffer, bce->data, BLOCK_SECTOR_SIZE);
+  memcpy (buffer, bce->data + ofs, size);
 
-  lock_release (&buffer_cache_lock);
+  lock_release (&bce->lock);
 }
 
-/* write from block to buffer cache */
+/* Copies SIZE bytes from BUFFER into SECTOR starting at byte OFS.  The
+   update is atomic with respect to other readers and writers of the
+   same sector. */
 void
-buffer_cache_write (block_sector_t sector, void *buffer)
+buffer_cache_write_at (block_sector_t sector, const void *buffer, int ofs,
+                       int size)
 {
-  lock_acquire (&buffer_cache_lock);
+  ASSERT (ofs >= 0 && size >= 0 && ofs + size <= BLOCK_SECTOR_SIZE);
 
-  struct buffer_cache_entry *bce = buffer_cache_lookup (sector);
+  struct buffer_cache_entry *bce
+      = buffer_cache_get (sector, size != BLOCK_SECTOR_SIZE);
 
-  /* if entry is not in the cache */
-  if (bce == NULL)
-    {
-      bce = buffer_cache_evict ();
+  /* copy data from memory to cache */
+  memcpy (bce->data + ofs, buffer, size);
+  bce->dirty = true;
 
-      bce->disk_sector = sector;
-      bce->valid = true;
-    }
+  lock_release (&bce->lock);
+}
 
-  bce->dirty = true;
-  bce->used_recently = true;
+/* Like buffer_cache_write_at, but for metadata covered by the journal:
+   the entry is pinned in the cache until buffer_cache_unpin_all and the
+   updated sector is copied into IMAGE, all under the entry lock, so the
+   journal records exactly what the cache holds. */
+void
+buffer_cache_log_at (block_sector_t sector, const void *buffer, int ofs,
+                     int size, void *image)
+{
+  ASSERT (ofs >= 0 && size >= 0 && ofs + size <= BLOCK_SECTOR_SIZE);
 
-  /* copy data from memory to cache */
-  memcpy (bce->data, buffer, BLOCK_SECTOR_SIZE);
+  struct buffer_cache_entry *bce
+      = buffer_cache_get (sector, size != BLOCK_SECTOR_SIZE);
 
-  lock_release (&buffer_cache_lock);
-}
\ No newline at end of file
+  memcpy (bce->data + ofs, buffer, size);
+  memcpy (image, bce->data, BLOCK_SECTOR_SIZE);
+  bce->dirty = true;
+  bce->pinned = true;
+
+  lock_release (&bce->lock);
+}
@@ -8,8 +8,18 @@
 
 void buffer_cache_init (void);
 void buffer_cache_close (void);
+void buffer_cache_flush (void);
+void buffer_cache_flush_sectors (const block_sector_t *sectors, size_t cnt);
+void buffer_cache_unpin_all (void);
+int compare_sectors (const void *, const void *, void *aux);
 
 void buffer_cache_read (block_sector_t sector, void *buffer);
-void buffer_cache_write (block_sector_t sector, void *buffer);
+void buffer_cache_write (block_sector_t sector, const void *buffer);
+void buffer_cache_read_at (block_sector_t sector, void *buffer, int ofs,
+                           int size);
+void buffer_cache_write_at (block_sector_t sector, const void *buffer,
+                            int ofs, int size);
+void buffer_cache_log_at (block_sector_t sector, const void *buffer, int ofs,
+                          int size, void *image);
 
-#endif
\ No newline at end of file
+#endif
@@ -123,10 +123,12 @@ dir_lookup (const struct dir *dir, const char *name, struct inode **inode)
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
+  inode_acquire_lock (dir->inode);
   if (lookup (dir, name, &e, NULL))
     *inode = inode_open (e.inode_sector);
   else
     *inode = NULL;
+  inode_release_lock (dir->inode);
 
   return *inode != NULL;
 }
@@ -151,6 +153,9 @@ dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
   if (*name == '\0' || strlen (name) > NAME_MAX)
     return false;
 
+  /* The check for NAME and the write of its slot must be atomic. */
+  inode_acquire_lock (dir->inode);
+
   /* Check that NAME is not in use. */
   if (lookup (dir, name, NULL, NULL))
     goto done;
@@ -174,14 +179,18 @@ dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
   success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
 
 done:
+  inode_release_lock (dir->inode);
   return success;
 }
 
 /* Removes any entry for NAME in DIR.
    Returns true if successful, false on failure,
-   which occurs only if there is no file with the given NAME. */
+   which occurs only if there is no file with the given NAME.
+   On success, sets *INODE to the removed file's inode, still open, so
+   that freeing it is left to the caller, otherwise to a null pointer.
+   The caller must close *INODE. */
 bool
-dir_remove (struct dir *dir, const char *name)
+dir_remove (struct dir *dir, const char *name, struct inode **inodep)
 {
   struct dir_entry e;
   struct inode *inode = NULL;
@@ -190,6 +199,10 @@ dir_remove (struct dir *dir, const char *name)
 
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
+  ASSERT (inodep != NULL);
+
+  /* Only one of several racing removals of NAME may succeed. */
+  inode_acquire_lock (dir->inode);
 
   /* Find directory entry. */
   if (!lookup (dir, name, &e, &ofs))
@@ -210,10 +223,29 @@ dir_remove (struct dir *dir, const char *name)
   success = true;
 
 done:
-  inode_close (inode);
+  inode_release_lock (dir->inode);
+  if (!success)
+    {
+      inode_close (inode);
+      inode = NULL;
+    }
+  *inodep = inode;
   return success;
 }
 
+/* Returns the most sectors a journal operation logs to add an entry to
+   or remove one from DIR: the two data sectors an entry may straddle,
+   and whatever growing DIR by one entry takes. */
+size_t
+dir_journal_credits (const struct dir *dir)
+{
+  off_t length = inode_length (dir->inode);
+
+  return 2
+         + inode_journal_credits (length, length + sizeof (struct dir_entry),
+                                  true);
+}
+
 /* Reads the next directory entry in DIR and stores the name in
    NAME.  Returns true if successful, false if the directory
    contains no more entries. */
@@ -221,15 +253,19 @@ bool
 dir_readdir (struct dir *dir, char name[NAME_MAX + 1])
 {
   struct dir_entry e;
+  bool found = false;
 
+  inode_acquire_lock (dir->inode);
   while (inode_read_at (dir->inode, &e, sizeof e, dir->pos) == sizeof e)
     {
       dir->pos += sizeof e;
       if (e.in_use)
         {
           strlcpy (name, e.name, NAME_MAX + 1);
-          return true;
+          found = true;
+          break;
         }
     }
-  return false;
+  inode_release_lock (dir->inode);
+  return found;
 }
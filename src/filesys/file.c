@@ -1,6 +1,8 @@
 #include "filesys/file.h"
 #include <debug.h>
 #include "filesys/inode.h"
+#include "filesys/range-lock.h"
+#include "threads/interrupt.h"
 #include "threads/malloc.h"
 
 /* An open file. */
@@ -9,6 +11,9 @@ struct file
     struct inode *inode;        /* File's inode. */
     off_t pos;                  /* Current position. */
     bool deny_write;            /* Has file_deny_write() been called? */
+    int ref_cnt;                /* References, see file_dup(). */
+    bool flocked;               /* Is FLOCK held? */
+    struct range_lock flock;    /* Advisory lock, see file_flock(). */
   };
 
 /* Opens a file for the given INODE, of which it takes ownership,
@@ -23,6 +28,7 @@ file_open (struct inode *inode)
       file->inode = inode;
       file->pos = 0;
       file->deny_write = false;
+      file->ref_cnt = 1;
       return file;
     }
   else
@@ -41,15 +47,35 @@ file_reopen (struct file *file)
   return file_open (inode_reopen (file->inode));
 }
 
-/* Closes FILE. */
+/* Returns FILE with one more reference, so that it can be shared,
+   along with its position, by another descriptor table, as after
+   fork().  Each reference is dropped by file_close(). */
+struct file *
+file_dup (struct file *file) 
+{
+  enum intr_level old_level = intr_disable ();
+  file->ref_cnt++;
+  intr_set_level (old_level);
+  return file;
+}
+
+/* Closes FILE, once its last reference is dropped. */
 void
 file_close (struct file *file) 
 {
   if (file != NULL)
     {
-      file_allow_write (file);
-      inode_close (file->inode);
-      free (file); 
+      enum intr_level old_level = intr_disable ();
+      bool last = --file->ref_cnt == 0;
+      intr_set_level (old_level);
+
+      if (last)
+        {
+          file_funlock (file);
+          file_allow_write (file);
+          inode_close (file->inode);
+          free (file); 
+        }
     }
 }
 
@@ -113,6 +139,45 @@ file_write_at (struct file *file, const void *buffer, off_t size,
   return inode_write_at (file->inode, buffer, size, file_ofs);
 }
 
+/* Copies SIZE bytes starting at offset IN_OFS in file IN to
+   offset OUT_OFS in file OUT, inside the kernel.
+   Returns the number of bytes actually copied,
+   which may be less than SIZE if end of IN is reached,
+   or -1 if memory or disk allocation fails.
+   Neither file's current position is affected. */
+off_t
+file_copy_range (struct file *in, off_t in_ofs, struct file *out,
+                 off_t out_ofs, off_t size) 
+{
+  return inode_copy_range (in->inode, in_ofs, out->inode, out_ofs, size);
+}
+
+/* Reads from FILE into the IOVCNT buffers described by IOV,
+   starting at the file's current position.
+   Returns the number of bytes actually read,
+   which may be less than the buffers' total size if end of file
+   is reached.
+   Advances FILE's position by the number of bytes read. */
+off_t
+file_readv (struct file *file, const struct iovec *iov, int iovcnt) 
+{
+  off_t bytes_read = inode_readv (file->inode, iov, iovcnt, file->pos);
+  file->pos += bytes_read;
+  return bytes_read;
+}
+
+/* Writes the IOVCNT buffers described by IOV into FILE,
+   starting at the file's current position.
+   Returns the number of bytes actually written.
+   Advances FILE's position by the number of bytes written. */
+off_t
+file_writev (struct file *file, const struct iovec *iov, int iovcnt) 
+{
+  off_t bytes_written = inode_writev (file->inode, iov, iovcnt, file->pos);
+  file->pos += bytes_written;
+  return bytes_written;
+}
+
 /* Prevents write operations on FILE's underlying inode
    until file_allow_write() is called or FILE is closed. */
 void
@@ -166,3 +231,44 @@ file_tell (struct file *file)
   ASSERT (file != NULL);
   return file->pos;
 }
+
+/* Writes FILE's data, and unless DATA_ONLY is true its metadata,
+   to disk. */
+void
+file_sync (struct file *file, bool data_only) 
+{
+  ASSERT (file != NULL);
+  inode_sync (file->inode, data_only);
+}
+
+/* Takes an advisory lock on all of FILE, EXCLUSIVE or shared, as
+   flock() does, converting any lock FILE already holds.  The lock
+   belongs to FILE, so every descriptor sharing FILE shares it,
+   and it is released when FILE is closed.  Conflicting locks
+   held through other files are waited for, unless NONBLOCK is
+   true, in which case the call fails instead.  Returns true if
+   successful. */
+bool
+file_flock (struct file *file, bool exclusive, bool nonblock) 
+{
+  if (file->flocked)
+    {
+      if (file->flock.exclusive == exclusive)
+        return true;
+      file_funlock (file);
+    }
+  range_lock_init (&file->flock, 0, RANGE_EOF, exclusive, file);
+  file->flocked = inode_flock (file->inode, &file->flock, !nonblock);
+  return file->flocked;
+}
+
+/* Releases FILE's advisory lock, if it holds one. */
+void
+file_funlock (struct file *file) 
+{
+  if (file->flocked)
+    {
+      inode_funlock (file->inode, &file->flock);
+      file->flocked = false;
+    }
+}
@@ -2,12 +2,15 @@
 #define FILESYS_FILE_H
 
 #include "filesys/off_t.h"
+#include <stdbool.h>
+#include <uio.h>
 
 struct inode;
 
 /* Opening and closing files. */
 struct file *file_open (struct inode *);
 struct file *file_reopen (struct file *);
+struct file *file_dup (struct file *);
 void file_close (struct file *);
 struct inode *file_get_inode (struct file *);
 
@@ -16,6 +19,10 @@ off_t file_read (struct file *, void *, off_t);
 off_t file_read_at (struct file *, void *, off_t size, off_t start);
 off_t file_write (struct file *, const void *, off_t);
 off_t file_write_at (struct file *, const void *, off_t size, off_t start);
+off_t file_readv (struct file *, const struct iovec *, int iovcnt);
+off_t file_writev (struct file *, const struct iovec *, int iovcnt);
+off_t file_copy_range (struct file *in, off_t in_ofs, struct file *out,
+                       off_t out_ofs, off_t size);
 
 /* Preventing writes. */
 void file_deny_write (struct file *);
@@ -26,4 +33,11 @@ void file_seek (struct file *, off_t);
 off_t file_tell (struct file *);
 off_t file_length (struct file *);
 
+/* Durability. */
+void file_sync (struct file *, bool data_only);
+
+/* Advisory locking. */
+bool file_flock (struct file *, bool exclusive, bool nonblock);
+void file_funlock (struct file *);
+
 #endif /* filesys/file.h */
@@ -4,6 +4,10 @@
 #include "filesys/file.h"
 #include "filesys/free-map.h"
 #include "filesys/inode.h"
+#include "filesys/journal.h"
+#ifdef USERPROG
+#include "userprog/exec-cache.h"
+#endif
 #include <debug.h>
 #include <stdio.h>
 #include <string.h>
@@ -28,6 +32,9 @@ filesys_init (bool format)
   /* Initialize buffer cache system. */
   buffer_cache_init ();
 
+  /* Replay or create the metadata journal. */
+  journal_init (format);
+
   if (format)
     do_format ();
 
@@ -39,6 +46,9 @@ filesys_init (bool format)
 void
 filesys_done (void)
 {
+  /* Commit outstanding metadata and empty the journal. */
+  journal_done ();
+
   /* Close buffer cache system, flushing all entries. */
   buffer_cache_close ();
 
@@ -54,11 +64,41 @@ filesys_create (const char *name, off_t initial_size, bool is_dir)
 {
   block_sector_t inode_sector = 0;
   struct dir *dir = dir_open_root ();
-  bool success = (dir != NULL && free_map_allocate (1, &inode_sector)
-                  && inode_create (inode_sector, initial_size, is_dir)
+  size_t credits;
+  off_t size = initial_size;
+
+  if (dir == NULL)
+    return false;
+
+  /* A file too large to allocate in one journal operation is created
+     empty and then grown, which takes as many as it needs. */
+  credits = dir_journal_credits (dir) + free_map_credits (1)
+            + inode_journal_credits (0, size, is_dir);
+  if (credits > JOURNAL_TXN_MAX)
+    {
+      size = 0;
+      credits = dir_journal_credits (dir) + free_map_credits (1)
+                + inode_journal_credits (0, 0, is_dir);
+    }
+
+  journal_begin (credits, 1);
+  bool success = (free_map_allocate (1, &inode_sector)
+                  && inode_create (inode_sector, size, is_dir)
                   && dir_add (dir, name, inode_sector));
   if (!success && inode_sector != 0)
     free_map_release (inode_sector, 1);
+  journal_end ();
+
+  if (success && size < initial_size)
+    {
+      struct inode *inode = inode_open (inode_sector);
+
+      success = inode != NULL
+                && inode_write_at (inode, "", 1, initial_size - 1) == 1;
+      inode_close (inode);
+      if (!success)
+        filesys_remove (name);
+    }
   dir_close (dir);
 
   return success;
@@ -90,9 +130,27 @@ bool
 filesys_remove (const char *name)
 {
   struct dir *dir = dir_open_root ();
-  bool success = dir != NULL && dir_remove (dir, name);
+  struct inode *inode = NULL;
+  bool success = false;
+
+  if (dir != NULL)
+    {
+      journal_begin (dir_journal_credits (dir), 0);
+      success = dir_remove (dir, name, &inode);
+      journal_end ();
+    }
   dir_close (dir);
 
+#ifdef USERPROG
+  /* The executable cache must not keep the file open. */
+  if (inode != NULL)
+    exec_cache_drop (inode);
+#endif
+
+  /* Frees the file, in an operation of its own, if nobody else has it
+     open. */
+  inode_close (inode);
+
   return success;
 }
 
@@ -102,8 +160,11 @@ do_format (void)
 {
   printf ("Formatting file system...");
   free_map_create ();
+  journal_begin (JOURNAL_TXN_MAX, 0);
   if (!dir_create (ROOT_DIR_SECTOR, 16))
     PANIC ("root directory creation failed");
+  journal_end ();
   free_map_close ();
+  journal_commit ();
   printf ("done.\n");
 }
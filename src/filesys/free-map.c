@@ -2,15 +2,20 @@
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "filesys/journal.h"
 #include "threads/synch.h"
 #include <bitmap.h>
 #include <debug.h>
+#include <round.h>
 
 static struct file *free_map_file; /* Free map file. */
 static struct bitmap *free_map;    /* Free map, one bit per sector. */
 
 static struct lock free_map_lock;
 
+/* Bits of the free map in each sector of its file. */
+#define FREE_MAP_SECTOR_BITS (BLOCK_SECTOR_SIZE * 8)
+
 /* Initializes the free map. */
 void
 free_map_init (void)
@@ -22,6 +27,7 @@ free_map_init (void)
     PANIC ("bitmap creation failed--file system device is too large");
   bitmap_mark (free_map, FREE_MAP_SECTOR);
   bitmap_mark (free_map, ROOT_DIR_SECTOR);
+  bitmap_set_multiple (free_map, JOURNAL_SECTOR, JOURNAL_SECTORS, true);
 }
 
 /* Allocates CNT consecutive sectors from the free map and stores
@@ -36,7 +42,7 @@ free_map_allocate (size_t cnt, block_sector_t *sectorp)
 
   block_sector_t sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
   if (sector != BITMAP_ERROR && free_map_file != NULL
-      && !bitmap_write (free_map, free_map_file))
+      && !bitmap_write_range (free_map, free_map_file, sector, cnt))
     {
       bitmap_set_multiple (free_map, sector, cnt, false);
       sector = BITMAP_ERROR;
@@ -57,11 +63,26 @@ free_map_release (block_sector_t sector, size_t cnt)
 
   ASSERT (bitmap_all (free_map, sector, cnt));
   bitmap_set_multiple (free_map, sector, cnt, false);
-  bitmap_write (free_map, free_map_file);
+  bitmap_write_range (free_map, free_map_file, sector, cnt);
+  journal_revoke (sector, cnt);
 
   lock_release (&free_map_lock);
 }
 
+/* Returns the most sectors of the free map file that allocating or
+   releasing CNT sectors, one at a time, writes through the journal:
+   the one holding each sector's bit, but no more than the file has,
+   and none before the file exists. */
+size_t
+free_map_credits (size_t cnt)
+{
+  size_t sectors = DIV_ROUND_UP (bitmap_size (free_map), FREE_MAP_SECTOR_BITS);
+
+  if (free_map_file == NULL)
+    return 0;
+  return cnt < sectors ? cnt : sectors;
+}
+
 /* Opens the free map file and reads it from disk. */
 void
 free_map_open (void)
@@ -85,14 +106,29 @@ free_map_close (void)
 void
 free_map_create (void)
 {
+  size_t bits = bitmap_size (free_map);
+  size_t size = bitmap_file_size (free_map);
+
   /* Create inode. */
-  if (!inode_create (FREE_MAP_SECTOR, bitmap_file_size (free_map), false))
+  journal_begin (inode_journal_credits (0, size, false), 0);
+  if (!inode_create (FREE_MAP_SECTOR, size, false))
     PANIC ("free map creation failed");
+  journal_end ();
 
-  /* Write bitmap to file. */
+  /* Write bitmap to file, a sector to each journal operation, since
+     the file may be larger than a transaction. */
   free_map_file = file_open (inode_open (FREE_MAP_SECTOR));
   if (free_map_file == NULL)
     PANIC ("can't open free map");
-  if (!bitmap_write (free_map, free_map_file))
-    PANIC ("can't write free map");
+  for (size_t start = 0; start < bits; start += FREE_MAP_SECTOR_BITS)
+    {
+      size_t cnt = bits - start;
+      if (cnt > FREE_MAP_SECTOR_BITS)
+        cnt = FREE_MAP_SECTOR_BITS;
+
+      journal_begin (1, 0);
+      if (!bitmap_write_range (free_map, free_map_file, start, cnt))
+        PANIC ("can't write free map");
+      journal_end ();
+    }
 }
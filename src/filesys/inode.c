@@ -3,12 +3,16 @@
 #include "filesys/cache.h"
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
+#include "filesys/journal.h"
+#include "filesys/range-lock.h"
 #include "threads/malloc.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
 #include "userprog/syscall.h"
 #include <debug.h>
 #include <list.h>
 #include <round.h>
+#include <stdlib.h>
 #include <string.h>
 
 /* Identifies an inode. */
@@ -52,7 +56,10 @@ struct inode_disk
 
 static bool inode_alloc (struct inode_disk *disk_inode);
 static bool inode_extend (struct inode_disk *disk_inode, size_t length);
-static void inode_free (struct inode *inode);
+static size_t inode_free_begin (void);
+static void inode_free (struct inode *inode, size_t *left);
+static void inode_free_block (block_sector_t sector, size_t *left);
+static off_t inode_grow_step (off_t length, off_t new_length, bool directory);
 
 /* Returns the number of sectors to allocate for an inode SIZE
    bytes long. */
@@ -70,14 +77,21 @@ struct inode
   int open_cnt;           /* Number of openers. */
   bool removed;           /* True if deleted, false otherwise. */
   int deny_write_cnt;     /* 0: writes ok, >0: deny writes. */
+  bool meta_dirty;        /* Size or block map changed since last sync. */
+  unsigned write_cnt;     /* Writes since the inode was opened. */
   struct inode_disk data; /* Inode content. */
 
-  struct lock lock; /* Protects inode content. */
+  struct lock lock; /* Serializes extension and the inode's other mutable
+                       fields.  Directory code also holds it across
+                       lookup/add/remove. */
+
+  struct range_tree io_ranges;    /* Byte ranges being read or written. */
+  struct range_tree flock_ranges; /* Advisory locks, see inode_flock. */
 };
 
-/* Used to lock this inode on occasion. Helps with byte_to_sector and updating
- * length of disk_inode, but causes more tests to fail when used for updating
- * other disk_inode fields. */
+/* Locks INODE unless the current thread already holds its lock, which
+ * happens when a directory operation extends the directory.  Returns
+ * whether the lock was already held, to be passed to inode_unlock. */
 static bool
 inode_lock (struct inode *inode)
 {
@@ -87,9 +101,7 @@ inode_lock (struct inode *inode)
   return lock_held;
 }
 
-/* Used to unlock this inode on occasion. Helps with byte_to_sector and
- * updating length of disk_inode, but causes more tests to fail when used for
- * updating other disk_inode fields. */
+/* Undoes inode_lock, releasing the lock only if inode_lock acquired it. */
 static void
 inode_unlock (struct inode *inode, bool held)
 {
@@ -97,82 +109,82 @@ inode_unlock (struct inode *inode, bool held)
     lock_release (&inode->lock);
 }
 
-/* Returns the block device sector that contains byte offset POS
-   within INODE.
-   Returns -1 if INODE does not contain data for a byte at offset
-   POS. */
+/* Returns the block device sector holding the INDEX'th data sector of
+   the inode described by DISK_INODE.  The sector must be allocated.
+
+   Readers need no lock: block pointers below the published length never
+   change while the inode is open, and the length is only raised after
+   the sectors it covers are allocated and written. */
 static block_sector_t
-byte_to_sector (const struct inode *inode, off_t pos)
+index_to_sector (const struct inode_disk *disk_inode, off_t index)
 {
-  ASSERT (inode != NULL);
-
   block_sector_t result;
 
-  bool lock_held = inode_lock (inode);
+  /* direct blocks*/
+  if (index < INODE_DIRECT_BLOCKS)
+    return disk_inode->blocks[index];
 
-  if (pos < inode->data.length)
+  /* an indirect block */
+  index -= INODE_DIRECT_BLOCKS;
+  if (index < INODE_INDIRECT_BLOCKS_PER_SECTOR)
     {
-      /* sector index */
-      off_t index = pos / BLOCK_SECTOR_SIZE;
-
-      /* direct blocks*/
-      if (index < INODE_DIRECT_BLOCKS)
-        {
-          result = inode->data.blocks[index];
-          goto finish;
-        }
-
-      /* an indirect block */
-      index -= INODE_DIRECT_BLOCKS;
-      if (index < INODE_INDIRECT_BLOCKS_PER_SECTOR)
-        {
-          block_sector_t indirect_blocks[INODE_INDIRECT_BLOCKS_PER_SECTOR];
+      buffer_cache_read_at (disk_inode->blocks[INODE_INDIRECT_INDEX], &result,
+                            index * sizeof result, sizeof result);
+      return result;
+    }
 
-          buffer_cache_read (inode->data.blocks[INODE_INDIRECT_INDEX],
-                             indirect_blocks);
+  /* a doubly indirect block */
+  index -= INODE_INDIRECT_BLOCKS_PER_SECTOR;
+  if (index < INODE_INDIRECT_BLOCKS_PER_SECTOR
+                  * INODE_INDIRECT_BLOCKS_PER_SECTOR)
+    {
+      off_t outer = index / INODE_INDIRECT_BLOCKS_PER_SECTOR;
+      off_t inner = index % INODE_INDIRECT_BLOCKS_PER_SECTOR;
+
+      buffer_cache_read_at (disk_inode->blocks[INODE_DOUBLY_INDIRECT_INDEX],
+                            &result, outer * sizeof result, sizeof result);
+      buffer_cache_read_at (result, &result, inner * sizeof result,
+                            sizeof result);
+      return result;
+    }
 
-          result = indirect_blocks[index];
-          goto finish;
-        }
+  /* something went wrong */
+  return EXIT_FAILURE;
+}
 
-      /* a doubly indirect block */
-      index -= INODE_INDIRECT_BLOCKS_PER_SECTOR;
-      if (index < INODE_INDIRECT_BLOCKS_PER_SECTOR
-                      * INODE_INDIRECT_BLOCKS_PER_SECTOR)
-        {
-          block_sector_t
-              doubly_indirect_blocks[INODE_INDIRECT_BLOCKS_PER_SECTOR];
-
-          buffer_cache_read (inode->data.blocks[INODE_DOUBLY_INDIRECT_INDEX],
-                             doubly_indirect_blocks);
-          buffer_cache_read (
-              doubly_indirect_blocks[index / INODE_INDIRECT_BLOCKS_PER_SECTOR],
-              doubly_indirect_blocks);
-          result = doubly_indirect_blocks[index
-                                          % INODE_INDIRECT_BLOCKS_PER_SECTOR];
-          goto finish;
-        }
+/* Returns whether INODE's data is file system metadata, which is
+   written through the journal: directory contents and the free map. */
+static bool
+inode_is_metadata (const struct inode *inode)
+{
+  return inode->data.directory || inode->sector == FREE_MAP_SECTOR;
+}
 
-      /* something went wrong */
-      result = EXIT_FAILURE;
-    }
+/* Copies SIZE bytes from BUFFER into SECTOR starting at byte OFS,
+   through the journal if META is true. */
+static void
+inode_write_sector (block_sector_t sector, const void *buffer, int ofs,
+                    int size, bool meta)
+{
+  if (meta)
+    journal_write_at (sector, buffer, ofs, size);
   else
-    result = EXIT_FAILURE;
-
-finish:
-  inode_unlock (inode, lock_held);
-  return result;
+    buffer_cache_write_at (sector, buffer, ofs, size);
 }
 
 /* List of open inodes, so that opening a single inode twice
    returns the same `struct inode'. */
 static struct list open_inodes;
 
+/* Protects open_inodes and the open_cnt of every inode on it. */
+static struct lock open_inodes_lock;
+
 /* Initializes the inode module. */
 void
 inode_init (void)
 {
   list_init (&open_inodes);
+  lock_init (&open_inodes_lock);
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -202,47 +214,78 @@ inode_create (block_sector_t sector, off_t length, bool directory)
 
       success = inode_alloc (disk_inode);
       if (success)
-        buffer_cache_write (sector, disk_inode);
+        journal_write (sector, disk_inode);
       free (disk_inode);
     }
   return success;
 }
 
-/* Reads an inode from SECTOR
-   and returns a `struct inode' that contains it.
-   Returns a null pointer if memory allocation fails. */
-struct inode *
-inode_open (block_sector_t sector)
+/* Returns the open inode for SECTOR with its open count raised, or a
+   null pointer if SECTOR is not open.  The caller must hold
+   open_inodes_lock. */
+static struct inode *
+inode_find_open (block_sector_t sector)
 {
   struct list_elem *e;
-  struct inode *inode;
 
-  /* Check whether this inode is already open. */
   for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
        e = list_next (e))
     {
-      inode = list_entry (e, struct inode, elem);
+      struct inode *inode = list_entry (e, struct inode, elem);
       if (inode->sector == sector)
         {
-          inode_reopen (inode);
+          inode->open_cnt++;
           return inode;
         }
     }
+  return NULL;
+}
+
+/* Reads an inode from SECTOR
+   and returns a `struct inode' that contains it.
+   Returns a null pointer if memory allocation fails. */
+struct inode *
+inode_open (block_sector_t sector)
+{
+  struct inode *inode;
+
+  /* Check whether this inode is already open. */
+  lock_acquire (&open_inodes_lock);
+  inode = inode_find_open (sector);
+  lock_release (&open_inodes_lock);
+  if (inode != NULL)
+    return inode;
 
   /* Allocate memory. */
   inode = malloc (sizeof *inode);
   if (inode == NULL)
     return NULL;
 
-  /* Initialize. */
-  list_push_front (&open_inodes, &inode->elem);
+  /* Initialize.  The disk inode is read before the inode is published
+     so that nobody sees it half filled in. */
   inode->sector = sector;
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
   inode->removed = false;
+  inode->meta_dirty = false;
+  inode->write_cnt = 0;
   lock_init (&inode->lock);
-
+  range_tree_init (&inode->io_ranges);
+  range_tree_init (&inode->flock_ranges);
   buffer_cache_read (inode->sector, &inode->data);
+
+  /* Somebody may have opened the same inode while we were reading. */
+  lock_acquire (&open_inodes_lock);
+  struct inode *other = inode_find_open (sector);
+  if (other == NULL)
+    list_push_front (&open_inodes, &inode->elem);
+  lock_release (&open_inodes_lock);
+
+  if (other != NULL)
+    {
+      free (inode);
+      return other;
+    }
   return inode;
 }
 
@@ -250,10 +293,12 @@ inode_open (block_sector_t sector)
 struct inode *
 inode_reopen (struct inode *inode)
 {
-  lock_acquire (&inode->lock);
   if (inode != NULL)
-    inode->open_cnt++;
-  lock_release (&inode->lock);
+    {
+      lock_acquire (&open_inodes_lock);
+      inode->open_cnt++;
+      lock_release (&open_inodes_lock);
+    }
   return inode;
 }
 
@@ -270,24 +315,30 @@ inode_get_inumber (const struct inode *inode)
 void
 inode_close (struct inode *inode)
 {
+  bool last;
+
   /* Ignore null pointer. */
   if (inode == NULL)
     return;
-  bool lock_held = inode_lock (inode);
-  inode->open_cnt--;
-  inode_unlock (inode, lock_held);
+
+  lock_acquire (&open_inodes_lock);
+  last = --inode->open_cnt == 0;
+  if (last)
+    /* Remove from inode list so nobody can reopen it. */
+    list_remove (&inode->elem);
+  lock_release (&open_inodes_lock);
 
   /* Release resources if this was the last opener. */
-  if (inode->open_cnt == 0)
+  if (last)
     {
-      /* Remove from inode list and release lock. */
-      list_remove (&inode->elem);
-
       /* Deallocate blocks if removed. */
       if (inode->removed)
         {
-          free_map_release (inode->sector, 1);
-          inode_free (inode);
+          size_t left = inode_free_begin ();
+
+          inode_free_block (inode->sector, &left);
+          inode_free (inode, &left);
+          journal_end ();
         }
 
       free (inode);
@@ -300,111 +351,226 @@ void
 inode_remove (struct inode *inode)
 {
   ASSERT (inode != NULL);
+
+  bool lock_held = inode_lock (inode);
   inode->removed = true;
+  inode_unlock (inode, lock_held);
+}
+
+/* Locks the SIZE bytes of INODE at OFFSET for the current thread with
+   RANGE, which it initializes, shared to read them or exclusively to
+   write them, so each read or write is atomic with respect to the
+   others while those on disjoint ranges proceed concurrently.  A
+   write past end of file locks everything from OFFSET on instead,
+   which serializes the writes that extend INODE against each other
+   and against reads of the bytes they add. */
+static void
+inode_lock_range (struct inode *inode, struct range_lock *range,
+                  off_t offset, off_t size, bool write)
+{
+  off_t end = size < RANGE_EOF - offset ? offset + size : RANGE_EOF;
+
+  if (write && end > inode_length (inode))
+    end = RANGE_EOF;
+  range_lock_init (range, offset, end, write, thread_current ());
+  range_lock_acquire (&inode->io_ranges, range);
 }
 
 /* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
    Returns the number of bytes actually read, which may be less
-   than SIZE if an error occurs or end of file is reached.
+   than SIZE if an error occurs or end of file is reached. */
+off_t
+inode_read_at (struct inode *inode, void *buffer, off_t size, off_t offset)
+{
+  struct iovec iov = { buffer, size };
 
-   Only change here is that block_read becomes buffer_cache_read.
-   */
+  return inode_readv (inode, &iov, 1, offset);
+}
+
+/* Reads from INODE into the IOVCNT buffers described by IOV, filling
+   each in turn, starting at position OFFSET.  Returns the number of
+   bytes actually read, which may be less than the total size of the
+   buffers if an error occurs or end of file is reached.
+
+   Partial sectors are copied straight out of the buffer cache, so no
+   bounce buffer is needed. */
 off_t
-inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
+inode_readv (struct inode *inode, const struct iovec *iov, int iovcnt,
+             off_t offset)
 {
-  uint8_t *buffer = buffer_;
   off_t bytes_read = 0;
-  uint8_t *bounce = NULL;
-
-  while (size > 0)
-    {
-      /* Disk sector to read, starting byte offset within sector. */
-      block_sector_t sector_idx = byte_to_sector (inode, offset);
-      int sector_ofs = offset % BLOCK_SECTOR_SIZE;
+  off_t total = 0;
+  struct range_lock range;
 
-      /* Bytes left in inode, bytes left in sector, lesser of the two. */
-      off_t inode_left = inode_length (inode) - offset;
-      int sector_left = BLOCK_SECTOR_SIZE - sector_ofs;
-      int min_left = inode_left < sector_left ? inode_left : sector_left;
+  for (int i = 0; i < iovcnt; i++)
+    total += iov[i].iov_len;
+  if (total <= 0)
+    return 0;
+  inode_lock_range (inode, &range, offset, total, false);
+  off_t length = inode_length (inode);
 
-      /* Number of bytes to actually copy out of this sector. */
-      int chunk_size = size < min_left ? size : min_left;
-      if (chunk_size <= 0)
-        break;
+  for (int i = 0; i < iovcnt; i++)
+    {
+      uint8_t *buffer = iov[i].iov_base;
+      off_t size = iov[i].iov_len;
+      off_t seg_read = 0;
 
-      if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
-        {
-          /* Read full sector directly into caller's buffer. */
-          buffer_cache_read (sector_idx, buffer + bytes_read);
-        }
-      else
+      while (size > 0)
         {
-          /* Read sector into bounce buffer, then partially copy
-             into caller's buffer. */
-          if (bounce == NULL)
-            {
-              bounce = malloc (BLOCK_SECTOR_SIZE);
-              if (bounce == NULL)
-                break;
-            }
-          buffer_cache_read (sector_idx, bounce);
-          memcpy (buffer + bytes_read, bounce + sector_ofs, chunk_size);
+          /* Disk sector to read, starting byte offset within sector. */
+          int sector_ofs = offset % BLOCK_SECTOR_SIZE;
+
+          /* Bytes left in inode, bytes left in sector, lesser of the
+             two. */
+          off_t inode_left = length - offset;
+          int sector_left = BLOCK_SECTOR_SIZE - sector_ofs;
+          int min_left = inode_left < sector_left ? inode_left : sector_left;
+
+          /* Number of bytes to actually copy out of this sector. */
+          int chunk_size = size < min_left ? size : min_left;
+          if (chunk_size <= 0)
+            goto done;
+
+          block_sector_t sector_idx
+              = index_to_sector (&inode->data, offset / BLOCK_SECTOR_SIZE);
+          buffer_cache_read_at (sector_idx, buffer + seg_read, sector_ofs,
+                                chunk_size);
+
+          /* Advance. */
+          size -= chunk_size;
+          offset += chunk_size;
+          seg_read += chunk_size;
+          bytes_read += chunk_size;
         }
-
-      /* Advance. */
-      size -= chunk_size;
-      offset += chunk_size;
-      bytes_read += chunk_size;
     }
-  free (bounce);
 
+done:
+  range_lock_release (&inode->io_ranges, &range);
   return bytes_read;
 }
 
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
    Returns the number of bytes actually written, which may be
    less than SIZE if end of file is reached or an error occurs.
-   (Normally a write at end of file would extend the inode).
-
-   Only change here is that block_read becomes buffer_cache_write.
-   */
+   A write past end of file extends the inode. */
 off_t
-inode_write_at (struct inode *inode, const void *buffer_, off_t size,
+inode_write_at (struct inode *inode, const void *buffer, off_t size,
                 off_t offset)
 {
-  const uint8_t *buffer = buffer_;
-  off_t bytes_written = 0;
-  uint8_t *bounce = NULL;
+  struct iovec iov = { (void *)buffer, size };
+
+  return inode_writev (inode, &iov, 1, offset);
+}
+
+/* Prepares INODE for a write of the bytes before *END.  If the write
+   goes past end of file, the inode is extended to *END and left locked,
+   *EXTENDING is set, and the new length is published by
+   inode_write_finish once the data is in place.  Otherwise *END is
+   clamped to the current length.  Returns false if writes are denied or
+   the file cannot be extended.
+
+   Writes inside the file only touch the sectors they cover, each of
+   which is updated atomically in the buffer cache.  An extending write
+   holds the inode lock from allocation until the new length is
+   published, so concurrent readers never see the newly allocated (and
+   still zeroed) sectors before the data is in them.
+
+   An extension too large for one journal operation first allocates
+   all but its last part in operations of their own, each recording
+   the new blocks past end of file in the inode, where nobody reads
+   them, so that each leaves the file system consistent. */
+static bool
+inode_write_prepare (struct inode *inode, off_t *end, bool *extending,
+                     bool *lock_held)
+{
+  *extending = false;
+  *lock_held = false;
 
   if (inode->deny_write_cnt)
-    return 0;
+    return false;
+  inode->write_cnt++;
 
   /* if beyond the EOF, extend the file */
-  if (byte_to_sector (inode, offset + size - 1) == -1u)
+  if (*end > inode_length (inode))
     {
-      /* extend the file offset + size bytes */
-      if (!inode_extend (&inode->data, offset + size))
-        /* unable to extend the file */
-        return 0;
-
-      /* write back the new file size */
-      bool lock_held = inode_lock (inode);
-      inode->data.length = offset + size > inode->data.length
-                               ? offset + size
-                               : inode->data.length;
-      inode_unlock (inode, lock_held);
+      bool directory = inode->data.directory;
+      off_t from = inode_length (inode);
+      off_t step;
 
-      buffer_cache_write (inode->sector, &inode->data);
+      while ((step = inode_grow_step (from, *end, directory)) < *end)
+        {
+          bool success;
+
+          journal_begin (inode_journal_credits (from, step, directory), 0);
+          *lock_held = inode_lock (inode);
+          success = inode_extend (&inode->data, step);
+          inode->meta_dirty = true;
+          journal_write (inode->sector, &inode->data);
+          inode_unlock (inode, *lock_held);
+          journal_end ();
+          if (!success)
+            return false;
+          from = step;
+        }
+
+      journal_begin (inode_journal_credits (from, *end, directory), 0);
+      *lock_held = inode_lock (inode);
+      *extending = *end > inode->data.length;
+
+      /* allocate the sectors for the new end of file */
+      if (*extending && !inode_extend (&inode->data, *end))
+        {
+          /* unable to extend the file */
+          inode_unlock (inode, *lock_held);
+          journal_end ();
+          return false;
+        }
+      if (!*extending)
+        {
+          inode_unlock (inode, *lock_held);
+          journal_end ();
+        }
     }
+  if (!*extending)
+    *end = inode_length (inode);
+  return true;
+}
+
+/* Finishes a write started by inode_write_prepare, publishing the new
+   length END if the write extended INODE. */
+static void
+inode_write_finish (struct inode *inode, off_t end, bool extending,
+                    bool lock_held)
+{
+  if (extending)
+    {
+      /* publish and write back the new file size */
+      barrier ();
+      inode->data.length = end;
+      inode->meta_dirty = true;
+      journal_write (inode->sector, &inode->data);
+      inode_unlock (inode, lock_held);
+      journal_end ();
+    }
+}
+
+/* Copies SIZE bytes from BUFFER into INODE at OFFSET, stopping at END,
+   within a write prepared by inode_write_prepare.  Returns the number
+   of bytes written. */
+static off_t
+inode_write_bytes (struct inode *inode, const uint8_t *buffer, off_t size,
+                   off_t offset, off_t end)
+{
+  bool meta = inode_is_metadata (inode);
+  off_t bytes_written = 0;
 
   while (size > 0)
     {
       /* Sector to write, starting byte offset within sector. */
-      block_sector_t sector_idx = byte_to_sector (inode, offset);
       int sector_ofs = offset % BLOCK_SECTOR_SIZE;
 
       /* Bytes left in inode, bytes left in sector, lesser of the two. */
-      off_t inode_left = inode_length (inode) - offset;
+      off_t inode_left = end - offset;
       int sector_left = BLOCK_SECTOR_SIZE - sector_ofs;
       int min_left = inode_left < sector_left ? inode_left : sector_left;
 
@@ -413,42 +579,189 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
       if (chunk_size <= 0)
         break;
 
-      if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
-        {
-          /* Write full sector directly to disk. */
-          buffer_cache_write (sector_idx, buffer + bytes_written);
-        }
-      else
-        {
-          /* We need a bounce buffer. */
-          if (bounce == NULL)
-            {
-              bounce = malloc (BLOCK_SECTOR_SIZE);
-              if (bounce == NULL)
-                break;
-            }
-
-          /* If the sector contains data before or after the chunk
-             we're writing, then we need to read in the sector
-             first.  Otherwise we start with a sector of all zeros. */
-          if (sector_ofs > 0 || chunk_size < sector_left)
-            buffer_cache_read (sector_idx, bounce);
-          else
-            memset (bounce, 0, BLOCK_SECTOR_SIZE);
-          memcpy (bounce + sector_ofs, buffer + bytes_written, chunk_size);
-          buffer_cache_write (sector_idx, bounce);
-        }
+      block_sector_t sector_idx
+          = index_to_sector (&inode->data, offset / BLOCK_SECTOR_SIZE);
+      inode_write_sector (sector_idx, buffer + bytes_written, sector_ofs,
+                          chunk_size, meta);
 
       /* Advance. */
       size -= chunk_size;
       offset += chunk_size;
       bytes_written += chunk_size;
     }
-  free (bounce);
 
   return bytes_written;
 }
 
+/* Writes the IOVCNT buffers described by IOV into INODE, one after
+   another, starting at OFFSET.  Returns the number of bytes actually
+   written, which may be less than the total size of the buffers if an
+   error occurs.  A write past end of file extends the inode once, for
+   all of the buffers. */
+off_t
+inode_writev (struct inode *inode, const struct iovec *iov, int iovcnt,
+              off_t offset)
+{
+  off_t bytes_written = 0;
+  off_t size = 0;
+  bool extending, lock_held;
+  struct range_lock range;
+
+  for (int i = 0; i < iovcnt; i++)
+    size += iov[i].iov_len;
+  off_t end = offset + size;
+
+  if (size <= 0)
+    return 0;
+  inode_lock_range (inode, &range, offset, size, true);
+  if (!inode_write_prepare (inode, &end, &extending, &lock_held))
+    {
+      range_lock_release (&inode->io_ranges, &range);
+      return 0;
+    }
+
+  for (int i = 0; i < iovcnt && offset < end; i++)
+    {
+      off_t seg_written
+          = inode_write_bytes (inode, iov[i].iov_base, iov[i].iov_len,
+                               offset, end);
+      offset += seg_written;
+      bytes_written += seg_written;
+    }
+
+  inode_write_finish (inode, end, extending, lock_held);
+  range_lock_release (&inode->io_ranges, &range);
+  return bytes_written;
+}
+
+/* Copies SIZE bytes starting at IN_OFS in inode IN to OUT_OFS in inode
+   OUT without going through user memory.  The source is read one sector
+   at a time straight from the buffer cache into a single sector-sized
+   bounce buffer and written into OUT's cached sectors; if the copy
+   extends OUT, it is extended once up front.  Returns the number of
+   bytes copied, which is less than SIZE if IN ends first and 0 if
+   IN_OFS is at or past its end, or -1 if memory or disk allocation
+   fails.  The ranges must not overlap if IN and OUT are the same. */
+off_t
+inode_copy_range (struct inode *in, off_t in_ofs, struct inode *out,
+                  off_t out_ofs, off_t size)
+{
+  off_t in_length = inode_length (in);
+  off_t copied = 0;
+  bool extending, lock_held;
+  struct range_lock in_range, out_range;
+  uint8_t *bounce;
+
+  if (in_ofs >= in_length || size <= 0)
+    return 0;
+  if (size > in_length - in_ofs)
+    size = in_length - in_ofs;
+
+  bounce = malloc (BLOCK_SECTOR_SIZE);
+  if (bounce == NULL)
+    return -1;
+
+  /* lock the two inodes in a fixed order, so that copies in opposite
+     directions cannot deadlock */
+  if (in->sector <= out->sector)
+    {
+      inode_lock_range (in, &in_range, in_ofs, size, false);
+      inode_lock_range (out, &out_range, out_ofs, size, true);
+    }
+  else
+    {
+      inode_lock_range (out, &out_range, out_ofs, size, true);
+      inode_lock_range (in, &in_range, in_ofs, size, false);
+    }
+
+  off_t end = out_ofs + size;
+  if (!inode_write_prepare (out, &end, &extending, &lock_held))
+    {
+      range_lock_release (&out->io_ranges, &out_range);
+      range_lock_release (&in->io_ranges, &in_range);
+      free (bounce);
+      return -1;
+    }
+
+  while (copied < size && out_ofs < end)
+    {
+      /* copy what is left of the current source sector */
+      int sector_ofs = in_ofs % BLOCK_SECTOR_SIZE;
+      off_t chunk_size = BLOCK_SECTOR_SIZE - sector_ofs;
+      if (chunk_size > size - copied)
+        chunk_size = size - copied;
+      if (chunk_size > end - out_ofs)
+        chunk_size = end - out_ofs;
+
+      block_sector_t sector_idx
+          = index_to_sector (&in->data, in_ofs / BLOCK_SECTOR_SIZE);
+      buffer_cache_read_at (sector_idx, bounce, sector_ofs, chunk_size);
+      inode_write_bytes (out, bounce, chunk_size, out_ofs, end);
+
+      /* Advance. */
+      in_ofs += chunk_size;
+      out_ofs += chunk_size;
+      copied += chunk_size;
+    }
+
+  inode_write_finish (out, end, extending, lock_held);
+  range_lock_release (&out->io_ranges, &out_range);
+  range_lock_release (&in->io_ranges, &in_range);
+  free (bounce);
+  return copied;
+}
+
+/* Takes advisory lock RL on INODE, waiting for locks of other owners
+   that conflict with it to be released if WAIT is true.  Returns true
+   if successful, false if WAIT is false and RL conflicts.  Advisory
+   locks only exclude each other, not reads and writes. */
+bool
+inode_flock (struct inode *inode, struct range_lock *rl, bool wait)
+{
+  if (!wait)
+    return range_lock_try_acquire (&inode->flock_ranges, rl);
+  range_lock_acquire (&inode->flock_ranges, rl);
+  return true;
+}
+
+/* Releases advisory lock RL, taken on INODE with inode_flock. */
+void
+inode_funlock (struct inode *inode, struct range_lock *rl)
+{
+  range_lock_release (&inode->flock_ranges, rl);
+}
+
+/* Writes INODE's dirty data sectors back to disk in ascending sector
+   order, then commits the journal so its metadata is durable too.  If
+   DATA_ONLY is true (fdatasync), the commit is skipped unless the size
+   or block map changed, since the data can be read back without it.
+   Other files' sectors stay in the cache. */
+void
+inode_sync (struct inode *inode, bool data_only)
+{
+  size_t cnt = bytes_to_sectors (inode_length (inode));
+  block_sector_t *sectors = cnt > 0 ? malloc (cnt * sizeof *sectors) : NULL;
+
+  if (sectors != NULL)
+    {
+      for (size_t i = 0; i < cnt; i++)
+        sectors[i] = index_to_sector (&inode->data, i);
+      sort (sectors, cnt, sizeof *sectors, compare_sectors, NULL);
+      buffer_cache_flush_sectors (sectors, cnt);
+      free (sectors);
+    }
+  else if (cnt > 0)
+    /* out of memory, fall back to writing everything */
+    buffer_cache_flush ();
+
+  /* data goes out before the metadata that points to it commits */
+  if (!data_only || inode->meta_dirty || inode_is_metadata (inode))
+    {
+      inode->meta_dirty = false;
+      journal_commit ();
+    }
+}
+
 /* Disables writes to INODE.
    May be called at most once per inode opener. */
 void
@@ -475,6 +788,92 @@ inode_allow_write (struct inode *inode)
   lock_release (&inode->lock);
 }
 
+/* Acquires INODE's lock, for callers that need a group of operations on
+   the inode to be atomic, such as directory updates. */
+void
+inode_acquire_lock (struct inode *inode)
+{
+  lock_acquire (&inode->lock);
+}
+
+/* Releases INODE's lock. */
+void
+inode_release_lock (struct inode *inode)
+{
+  lock_release (&inode->lock);
+}
+
+/* Returns the number of writes to INODE since it was opened.  Anyone
+   keeping INODE open can compare two counts to tell whether its
+   contents may have changed in between. */
+unsigned
+inode_write_count (const struct inode *inode)
+{
+  return inode->write_cnt;
+}
+
+/* Returns the most sectors a journal operation logs to grow a file, or
+   a directory if DIRECTORY, from LENGTH to NEW_LENGTH bytes: its
+   inode, the indirect blocks over the new sectors, a free map sector
+   for each block allocated, and a directory's new data sectors, which
+   are metadata too. */
+size_t
+inode_journal_credits (off_t length, off_t new_length, bool directory)
+{
+  size_t first = bytes_to_sectors (length);
+  size_t last = bytes_to_sectors (new_length);
+  size_t cnt = last > first ? last - first : 0;
+  size_t credits = 1;
+
+  if (cnt > 0)
+    {
+      /* the indirect and doubly indirect blocks, and the singly
+         indirect blocks below the latter that the new sectors span */
+      size_t indirect
+          = 2 + DIV_ROUND_UP (cnt, INODE_INDIRECT_BLOCKS_PER_SECTOR) + 1;
+
+      credits += indirect + free_map_credits (indirect + cnt);
+      if (directory)
+        credits += cnt;
+    }
+  return credits;
+}
+
+/* Returns how far one journal operation may grow a file, or a
+   directory if DIRECTORY, from LENGTH toward NEW_LENGTH bytes, keeping
+   to half of a transaction so other operations fit beside it. */
+static off_t
+inode_grow_step (off_t length, off_t new_length, bool directory)
+{
+  size_t first = bytes_to_sectors (length);
+  size_t cnt = bytes_to_sectors (new_length) - first;
+  off_t step;
+
+  while (cnt > 1
+         && inode_journal_credits (length, (first + cnt) * BLOCK_SECTOR_SIZE,
+                                   directory)
+                > JOURNAL_TXN_MAX / 2)
+    cnt /= 2;
+  step = (first + cnt) * BLOCK_SECTOR_SIZE;
+  return step < new_length ? step : new_length;
+}
+
+/* Starts a journal operation to free blocks of a removed inode and
+   returns how many it has room for: each may rewrite a free map
+   sector and revoke a logged sector, and the operation keeps to half
+   of a transaction, so that other operations fit beside it however
+   large the file and the disk are. */
+static size_t
+inode_free_begin (void)
+{
+  size_t batch = JOURNAL_REVOKE_MAX / 2;
+
+  while (batch > 1 && free_map_credits (batch) > JOURNAL_TXN_MAX / 2)
+    batch /= 2;
+  journal_begin (free_map_credits (batch), batch);
+  return batch;
+}
+
 /* Returns the length, in bytes, of INODE's data. */
 off_t
 inode_length (const struct inode *inode)
@@ -503,13 +902,14 @@ inode_alloc (struct inode_disk *disk_inode)
   return inode_extend (disk_inode, disk_inode->length);
 }
 
-/* Extend the block provided by allocating one sector in the free map. */
+/* Extend the block provided by allocating one sector in the free map.
+   The new sector is zeroed through the journal if META is true. */
 static bool
-inode_extend_block (block_sector_t *block)
+inode_extend_block (block_sector_t *block, bool meta)
 {
   if (!free_map_allocate (1, block))
     return false;
-  buffer_cache_write (*block, zeros);
+  inode_write_sector (*block, zeros, 0, BLOCK_SECTOR_SIZE, meta);
   return true;
 }
 
@@ -522,7 +922,7 @@ inode_extend_direct (struct inode_disk *id, size_t remaining_sectors)
       /* make sure the block isn't already allocated */
       if (id->blocks[i] == 0)
         {
-          if (!inode_extend_block (&id->blocks[i]))
+          if (!inode_extend_block (&id->blocks[i], id->directory))
             return false;
         }
     }
@@ -532,49 +932,56 @@ inode_extend_direct (struct inode_disk *id, size_t remaining_sectors)
 /* Tracks what type of indirect block is being dealt with. */
 static enum indirect_state { BASE, SINGLE, DOUBLE };
 
-/* Extend an indirect block by remaining_sectors recursively. */
+/* Extend an indirect block by remaining_sectors recursively.
+   REMAINING_SECTORS counts the data sectors reachable from *SECTOR that
+   must be allocated.  META tells whether the data sectors are
+   metadata; the indirect blocks themselves always are. */
 static bool
 inode_extend_indirect (block_sector_t *sector, size_t remaining_sectors,
-                       enum indirect_state state)
+                       enum indirect_state state, bool meta)
 {
   block_sector_t indirect_blocks[INODE_INDIRECT_BLOCKS_PER_SECTOR];
-  size_t i, sectors_to_extend = remaining_sectors;
+  size_t i, per_entry;
+  bool success = true, changed = false;
 
-  /* true unless extension of 0 sector fails */
-  bool base_result = true;
-
-  if (*sector == 0)
-    base_result = inode_extend_block (sector);
+  if (*sector == 0 && !inode_extend_block (sector, meta || state != BASE))
+    return false;
 
   switch (state)
     {
-    case BASE: /* base case, return base result */
-      return base_result;
-    case SINGLE: /* singly indirect, initiate recursion */
-      buffer_cache_read (*sector, &indirect_blocks);
-      for (i = 0; i < sectors_to_extend; ++i)
-        {
-          if (!inode_extend_indirect (&indirect_blocks[i], 1, BASE))
-            return false;
-          remaining_sectors--;
-        }
-      goto finish;
-    case DOUBLE: /* doubly indirect, initiate recursion */
-      buffer_cache_read (*sector, &indirect_blocks);
-      for (i = 0; i < sectors_to_extend; ++i)
-        {
-          if (!inode_extend_indirect (&indirect_blocks[i],
-                                      INODE_INDIRECT_BLOCKS_PER_SECTOR,
-                                      SINGLE))
-            return false;
-          remaining_sectors -= INODE_INDIRECT_BLOCKS_PER_SECTOR;
-        }
-      goto finish;
+    case BASE: /* base case, the data sector itself */
+      return true;
+    case SINGLE: /* singly indirect, each entry is one data sector */
+      per_entry = 1;
+      break;
+    case DOUBLE: /* doubly indirect, each entry is a singly indirect block */
+    default:
+      per_entry = INODE_INDIRECT_BLOCKS_PER_SECTOR;
+      break;
     }
 
-finish:
-  buffer_cache_write (*sector, &indirect_blocks);
-  return true;
+  buffer_cache_read (*sector, &indirect_blocks);
+  for (i = 0; remaining_sectors > 0 && i < INODE_INDIRECT_BLOCKS_PER_SECTOR;
+       i++)
+    {
+      size_t cnt
+          = remaining_sectors < per_entry ? remaining_sectors : per_entry;
+      block_sector_t old = indirect_blocks[i];
+
+      success = inode_extend_indirect (&indirect_blocks[i], cnt,
+                                       state == DOUBLE ? SINGLE : BASE, meta);
+      if (indirect_blocks[i] != old)
+        changed = true;
+      if (!success)
+        break;
+      remaining_sectors -= cnt;
+    }
+
+  /* only blocks that gained entries go into the journal, so growing a
+     large file logs the indirect blocks over its new end only */
+  if (changed)
+    journal_write (*sector, &indirect_blocks);
+  return success;
 }
 
 /* Extend inode by length bytes. */
@@ -591,7 +998,7 @@ inode_extend (struct inode_disk *disk_inode, size_t length)
   sectors_to_extend = remaining_sectors < INODE_DIRECT_BLOCKS
                           ? remaining_sectors
                           : INODE_DIRECT_BLOCKS;
-  if (!inode_extend_direct (disk_inode, remaining_sectors))
+  if (!inode_extend_direct (disk_inode, sectors_to_extend))
     /* unsuccessful extension */
     return false;
   remaining_sectors -= sectors_to_extend;
@@ -604,7 +1011,8 @@ inode_extend (struct inode_disk *disk_inode, size_t length)
                           ? remaining_sectors
                           : INODE_INDIRECT_BLOCKS_PER_SECTOR;
   if (!inode_extend_indirect (&disk_inode->blocks[INODE_INDIRECT_INDEX],
-                              sectors_to_extend, SINGLE))
+                              sectors_to_extend, SINGLE,
+                              disk_inode->directory))
     /* unsuccessful extension */
     return false;
   remaining_sectors -= sectors_to_extend;
@@ -620,7 +1028,8 @@ inode_extend (struct inode_disk *disk_inode, size_t length)
             : INODE_INDIRECT_BLOCKS_PER_SECTOR
                   * INODE_INDIRECT_BLOCKS_PER_SECTOR;
   if (!inode_extend_indirect (&disk_inode->blocks[INODE_DOUBLY_INDIRECT_INDEX],
-                              sectors_to_extend, DOUBLE))
+                              sectors_to_extend, DOUBLE,
+                              disk_inode->directory))
     /* unsuccessful extension */
     return false;
   remaining_sectors -= sectors_to_extend;
@@ -631,81 +1040,64 @@ inode_extend (struct inode_disk *disk_inode, size_t length)
   return false;
 }
 
-/* Deallocate the provided indirect block sector recursively. */
-static size_t
-inode_free_indirect (block_sector_t sector, size_t remaining_sectors,
-                     enum indirect_state state)
+/* Frees SECTOR, one of the blocks of a removed inode, in the journal
+   operation inode_free_begin() started, which has room for *LEFT more,
+   or in a new one once that is full.  A crash between two operations
+   only leaks the blocks not yet freed, since no directory names the
+   inode any more. */
+static void
+inode_free_block (block_sector_t sector, size_t *left)
 {
-  block_sector_t indirect_blocks[INODE_INDIRECT_BLOCKS_PER_SECTOR];
-  size_t i, sectors_freed;
-
-  switch (state)
+  if (*left == 0)
     {
-    case BASE: /* base case, just free the sector */
-      free_map_release (sector, 1);
-      sectors_freed += 1;
-      return sectors_freed;
-    case SINGLE: /* singly indirect block, initiate recursion */
-      buffer_cache_read (sector, &indirect_blocks);
-      while (i < INODE_INDIRECT_BLOCKS_PER_SECTOR && remaining_sectors > 0)
-        {
-          sectors_freed += inode_free_indirect (indirect_blocks[i],
-                                                remaining_sectors, BASE);
-          remaining_sectors -= sectors_freed;
-          i++;
-        }
-    case DOUBLE: /* doubly indirect block, initiate recursion */
-      buffer_cache_read (sector, &indirect_blocks);
-      while (i < INODE_INDIRECT_BLOCKS_PER_SECTOR && remaining_sectors > 0)
-        {
-          sectors_freed += inode_free_indirect (indirect_blocks[i],
-                                                remaining_sectors, SINGLE);
-          remaining_sectors -= sectors_freed;
-          i++;
-        }
+      journal_end ();
+      *left = inode_free_begin ();
     }
-
   free_map_release (sector, 1);
-  return sectors_freed;
+  --*left;
 }
 
-/* Deallocate a direct block sector. */
-static size_t
-inode_free_direct (struct inode_disk *id, size_t remaining_sectors)
+/* Deallocate the provided indirect block sector and, recursively,
+   every block it points to. */
+static void
+inode_free_indirect (block_sector_t sector, enum indirect_state state,
+                     size_t *left)
 {
-  size_t i = 0;
-  while (i < INODE_DIRECT_BLOCKS && remaining_sectors > 0)
+  block_sector_t indirect_blocks[INODE_INDIRECT_BLOCKS_PER_SECTOR];
+  size_t i;
+
+  if (state != BASE)
     {
-      free_map_release (id->blocks[i], 1);
-      remaining_sectors--;
-      i++;
+      buffer_cache_read (sector, &indirect_blocks);
+      for (i = 0; i < INODE_INDIRECT_BLOCKS_PER_SECTOR; i++)
+        if (indirect_blocks[i] != 0)
+          inode_free_indirect (indirect_blocks[i],
+                               state == DOUBLE ? SINGLE : BASE, left);
     }
-  return i;
+  inode_free_block (sector, left);
 }
 
-/* Deallocate the provided INODE. */
+/* Deallocate the provided INODE's blocks, as inode_free_block()
+   describes.  Every allocated block is freed, not just those below
+   its length, since a crash in the middle of a large extension leaves
+   blocks past end of file. */
 static void
-inode_free (struct inode *inode)
+inode_free (struct inode *inode, size_t *left)
 {
-  size_t remaining_sectors = bytes_to_sectors (inode->data.length);
+  struct inode_disk *id = &inode->data;
+  size_t i;
 
-  if (remaining_sectors)
-    {
-      size_t i, sectors_to_free;
-
-      /* direct blocks */
-      remaining_sectors -= inode_free_direct (&inode->data, remaining_sectors);
-
-      /* indirect block */
-      if (remaining_sectors)
-        remaining_sectors
-            -= inode_free_indirect (inode->data.blocks[INODE_INDIRECT_INDEX],
-                                    remaining_sectors, SINGLE);
-
-      /* doubly indirect block */
-      if (remaining_sectors)
-        remaining_sectors -= inode_free_indirect (
-            inode->data.blocks[INODE_DOUBLY_INDIRECT_INDEX], remaining_sectors,
-            DOUBLE);
-    }
+  /* direct blocks */
+  for (i = 0; i < INODE_DIRECT_BLOCKS; i++)
+    if (id->blocks[i] != 0)
+      inode_free_block (id->blocks[i], left);
+
+  /* indirect block */
+  if (id->blocks[INODE_INDIRECT_INDEX] != 0)
+    inode_free_indirect (id->blocks[INODE_INDIRECT_INDEX], SINGLE, left);
+
+  /* doubly indirect block */
+  if (id->blocks[INODE_DOUBLY_INDIRECT_INDEX] != 0)
+    inode_free_indirect (id->blocks[INODE_DOUBLY_INDIRECT_INDEX], DOUBLE,
+                         left);
 }
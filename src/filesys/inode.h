@@ -4,8 +4,10 @@
 #include "devices/block.h"
 #include "filesys/off_t.h"
 #include <stdbool.h>
+#include <uio.h>
 
 struct bitmap;
+struct range_lock;
 
 void inode_init (void);
 bool inode_create (block_sector_t, off_t, bool is_dir);
@@ -16,9 +18,22 @@ void inode_close (struct inode *);
 void inode_remove (struct inode *);
 off_t inode_read_at (struct inode *, void *, off_t size, off_t offset);
 off_t inode_write_at (struct inode *, const void *, off_t size, off_t offset);
+off_t inode_readv (struct inode *, const struct iovec *, int iovcnt,
+                   off_t offset);
+off_t inode_writev (struct inode *, const struct iovec *, int iovcnt,
+                    off_t offset);
+off_t inode_copy_range (struct inode *in, off_t in_ofs, struct inode *out,
+                        off_t out_ofs, off_t size);
+void inode_sync (struct inode *, bool data_only);
+bool inode_flock (struct inode *, struct range_lock *, bool wait);
+void inode_funlock (struct inode *, struct range_lock *);
 void inode_deny_write (struct inode *);
 void inode_allow_write (struct inode *);
 off_t inode_length (const struct inode *);
+size_t inode_journal_credits (off_t length, off_t new_length, bool is_dir);
+unsigned inode_write_count (const struct inode *);
+void inode_acquire_lock (struct inode *);
+void inode_release_lock (struct inode *);
 
 bool inode_is_directory (const struct inode *);
 bool inode_is_removed (const struct inode *);
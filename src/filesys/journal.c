@@ -0,0 +1,670 @@
+#include "filesys/journal.h"
+#include "devices/timer.h"
+#include "filesys/cache.h"
+#include "filesys/filesys.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <round.h>
+#include <string.h>
+
+/* Write-ahead journal for file system metadata.
+
+   Every metadata sector (inodes, indirect blocks, directory contents and
+   the free map file) is updated through journal_write_at, which changes
+   the buffer cache as usual but pins the cache entry and keeps a copy of
+   the new sector contents.  When the last open transaction ends, and
+   enough updates or time have piled up, all pending images are written
+   to the log as one transaction: a header listing the home sectors, the
+   images, and a commit record carrying a checksum.  Only then are the
+   cache entries unpinned, so no metadata reaches its home sector before
+   the log describes it.  Batching many operations into one transaction
+   (group commit) turns many scattered metadata writes into a single
+   sequential log write.  A "journal" thread commits whatever is left
+   once it is old enough, so a trickle of updates does not stay
+   uncommitted.
+
+   A transaction only ever commits between operations, so it never
+   holds half of one.  Each operation reserves, in journal_begin, room
+   for as many sector images and revoked sectors as it may add; if the
+   running transaction cannot take that much more, the new operation
+   waits for the open ones to end and commits it first.  An operation
+   that may grow past the limits, such as extending a file by a lot,
+   must be split into several, each leaving the file system
+   consistent.
+
+   When the log fills up, the cache is flushed so every committed
+   transaction is on its home sectors, and the log starts over.  Sectors
+   the running transaction has changed again stay pinned in the cache,
+   so their last committed images are copied home from the log first.
+   At mount time, journal_init replays every complete transaction left
+   in the log, so the file system is consistent after a crash without a
+   full scan.
+
+   A freed sector that was logged since the last checkpoint is recorded
+   as revoked, so replay does not copy stale metadata over a sector that
+   was reused for file data. */
+
+/* Magic numbers. */
+#define JOURNAL_SUPER_MAGIC 0x4a524e4c  /* "JRNL" */
+#define JOURNAL_HEADER_MAGIC 0x4a484452 /* "JHDR" */
+#define JOURNAL_COMMIT_MAGIC 0x4a434d54 /* "JCMT" */
+
+/* Log sectors following the superblock. */
+#define JOURNAL_LOG_SECTORS (JOURNAL_SECTORS - 1)
+
+/* Sector numbers the first header sector of a transaction has room
+   for, shared between logged images and revoked sectors, and the
+   number each further header sector holds. */
+#define JOURNAL_HEADER_SLOTS 124
+#define JOURNAL_EXTRA_SLOTS (BLOCK_SECTOR_SIZE / sizeof (block_sector_t))
+
+/* Most header sectors in one transaction. */
+#define JOURNAL_HEADER_MAX 4
+
+/* Sector numbers in the headers of the largest transaction. */
+#define JOURNAL_LIST_MAX                                                      \
+  (JOURNAL_HEADER_SLOTS + (JOURNAL_HEADER_MAX - 1) * JOURNAL_EXTRA_SLOTS)
+
+/* Group commit thresholds: commit once this many sectors are pending,
+   or once the oldest pending update is this many ticks old. */
+#define JOURNAL_GROUP_CNT 16
+#define JOURNAL_COMMIT_TICKS (TIMER_FREQ / 20)
+
+/* On-disk journal superblock, at JOURNAL_SECTOR.
+   Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+struct journal_super
+{
+  uint32_t magic;       /* JOURNAL_SUPER_MAGIC. */
+  uint32_t seq;         /* Sequence number of the first transaction. */
+  uint32_t unused[126]; /* Not used. */
+};
+
+/* On-disk transaction header, followed by as many further header
+   sectors as the sector numbers need (each an array of
+   JOURNAL_EXTRA_SLOTS of them), then CNT sector images.
+   Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+struct journal_header
+{
+  uint32_t magic;      /* JOURNAL_HEADER_MAGIC. */
+  uint32_t seq;        /* Transaction sequence number. */
+  uint32_t cnt;        /* Number of sector images. */
+  uint32_t revoke_cnt; /* Number of revoked sectors. */
+  block_sector_t sectors[JOURNAL_HEADER_SLOTS]; /* CNT home sectors, then
+                                                   REVOKE_CNT revoked
+                                                   sectors, continued in
+                                                   the further header
+                                                   sectors. */
+};
+
+/* On-disk commit record, following the images of a transaction.
+   Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+struct journal_commit
+{
+  uint32_t magic;       /* JOURNAL_COMMIT_MAGIC. */
+  uint32_t seq;         /* Transaction sequence number. */
+  uint32_t checksum;    /* Checksum of header and images. */
+  uint32_t unused[125]; /* Not used. */
+};
+
+/* A metadata sector updated by the running transaction. */
+struct journal_record
+{
+  block_sector_t sector;            /* Home sector. */
+  uint8_t data[BLOCK_SECTOR_SIZE]; /* Sector contents to log. */
+};
+
+/* Running transaction. */
+static struct journal_record pending[JOURNAL_TXN_MAX];
+static size_t pending_cnt;
+static block_sector_t revoked[JOURNAL_REVOKE_MAX];
+static size_t revoked_cnt;
+static int64_t pending_since; /* Tick of the oldest pending update. */
+
+static int handles;     /* Operations between journal_begin and _end. */
+static size_t reserved_cnt;        /* Images reserved by open operations. */
+static size_t reserved_revoke_cnt; /* Revokes reserved by open operations. */
+static int draining;    /* Threads waiting for all operations to end. */
+static struct condition quiet; /* Signaled when no operation is open. */
+static uint32_t seq;    /* Sequence number of the next transaction. */
+static uint32_t first_seq; /* Sequence number of the first in the log. */
+static size_t head;     /* Next free log sector, relative to the log. */
+static struct bitmap *logged; /* Sectors logged since the last checkpoint. */
+static struct bitmap *applied; /* Scratch for journal_apply. */
+static block_sector_t txn_list[JOURNAL_LIST_MAX]; /* Scratch, header
+                                                     sector numbers. */
+
+/* Protects everything above. */
+static struct lock journal_lock;
+
+static void journal_commit_locked (void);
+static thread_func journal_committer NO_RETURN;
+
+/* Returns the device sector of log sector OFS. */
+static block_sector_t
+log_sector (size_t ofs)
+{
+  return JOURNAL_SECTOR + 1 + ofs;
+}
+
+/* Returns the number of header sectors of a transaction with CNT
+   sector images and revoked sectors. */
+static size_t
+header_sectors (size_t cnt)
+{
+  if (cnt <= JOURNAL_HEADER_SLOTS)
+    return 1;
+  return 1 + DIV_ROUND_UP (cnt - JOURNAL_HEADER_SLOTS, JOURNAL_EXTRA_SLOTS);
+}
+
+/* Folds SIZE bytes at DATA into CHECKSUM (FNV-1a). */
+static uint32_t
+journal_checksum (uint32_t checksum, const void *data, size_t size)
+{
+  const uint8_t *p = data;
+
+  while (size-- > 0)
+    checksum = (checksum ^ *p++) * 16777619;
+  return checksum;
+}
+
+/* Writes the superblock, starting an empty log whose first transaction
+   will be numbered SEQ. */
+static void
+journal_reset (void)
+{
+  static struct journal_super super;
+
+  super.magic = JOURNAL_SUPER_MAGIC;
+  super.seq = seq;
+  block_write (fs_device, JOURNAL_SECTOR, &super);
+  first_seq = seq;
+  head = 0;
+  bitmap_set_all (logged, false);
+}
+
+/* Reads the headers of the transaction at log sector POS, expecting
+   sequence number EXPECT, into HEADER and all of its sector numbers
+   into txn_list.  Returns the number of header sectors, or 0 if there
+   is no such transaction there.  If CHECKSUM is nonnull, the header
+   sectors are folded into it. */
+static size_t
+journal_read_header (size_t pos, uint32_t expect,
+                     struct journal_header *header, uint32_t *checksum)
+{
+  size_t hdr_cnt, i;
+
+  if (pos + 2 > JOURNAL_LOG_SECTORS)
+    return 0;
+  block_read (fs_device, log_sector (pos), header);
+  if (header->magic != JOURNAL_HEADER_MAGIC || header->seq != expect
+      || header->cnt > JOURNAL_TXN_MAX
+      || header->revoke_cnt > JOURNAL_REVOKE_MAX)
+    return 0;
+  hdr_cnt = header_sectors (header->cnt + header->revoke_cnt);
+  if (pos + hdr_cnt + header->cnt + 1 > JOURNAL_LOG_SECTORS)
+    return 0;
+
+  if (checksum != NULL)
+    *checksum = journal_checksum (*checksum, header, BLOCK_SECTOR_SIZE);
+  memcpy (txn_list, header->sectors, sizeof header->sectors);
+  for (i = 1; i < hdr_cnt; i++)
+    {
+      block_sector_t *extra
+          = txn_list + JOURNAL_HEADER_SLOTS + (i - 1) * JOURNAL_EXTRA_SLOTS;
+      block_read (fs_device, log_sector (pos + i), extra);
+      if (checksum != NULL)
+        *checksum = journal_checksum (*checksum, extra, BLOCK_SECTOR_SIZE);
+    }
+  return hdr_cnt;
+}
+
+/* Reads the headers of the transaction at log sector POS, expecting
+   sequence number EXPECT, as journal_read_header does, and checks the
+   images and the commit record against them.  Returns the number of
+   log sectors the transaction takes if it is complete and intact, or
+   0 if the log ends here. */
+static size_t
+journal_read_txn (size_t pos, uint32_t expect, struct journal_header *header)
+{
+  static uint8_t image[BLOCK_SECTOR_SIZE];
+  struct journal_commit commit;
+  uint32_t checksum = 2166136261u;
+  size_t hdr_cnt, i;
+
+  hdr_cnt = journal_read_header (pos, expect, header, &checksum);
+  if (hdr_cnt == 0)
+    return 0;
+  for (i = 0; i < header->cnt; i++)
+    {
+      block_read (fs_device, log_sector (pos + hdr_cnt + i), image);
+      checksum = journal_checksum (checksum, image, BLOCK_SECTOR_SIZE);
+    }
+
+  block_read (fs_device, log_sector (pos + hdr_cnt + header->cnt), &commit);
+  if (commit.magic != JOURNAL_COMMIT_MAGIC || commit.seq != expect
+      || commit.checksum != checksum)
+    return 0;
+  return hdr_cnt + header->cnt + 1;
+}
+
+static bool journal_running (block_sector_t sector);
+
+/* Copies complete transactions in the log, which start with number
+   first_seq, to their home sectors.  Transactions are applied newest
+   first: a sector is written from the most recent image of it, unless
+   a transaction at or after that image revoked it.  If RUNNING_ONLY,
+   only sectors that the running transaction holds are written.
+   Returns the sequence number following the last complete
+   transaction. */
+static uint32_t
+journal_apply (bool running_only)
+{
+  static struct journal_header header;
+  static uint8_t image[BLOCK_SECTOR_SIZE];
+  size_t txn_pos[JOURNAL_LOG_SECTORS / 2];
+  size_t txn_cnt = 0, pos = 0, len, hdr_cnt, i;
+  uint32_t next = first_seq;
+  int t;
+
+  /* Find the complete transactions. */
+  while ((len = journal_read_txn (pos, next, &header)) != 0)
+    {
+      txn_pos[txn_cnt++] = pos;
+      pos += len;
+      next++;
+    }
+
+  /* Apply them newest first.  APPLIED holds the sectors that are
+     either already written from a newer image or revoked. */
+  bitmap_set_all (applied, false);
+  for (t = (int) txn_cnt - 1; t >= 0; t--)
+    {
+      hdr_cnt = journal_read_header (txn_pos[t], first_seq + t, &header,
+                                     NULL);
+      for (i = 0; i < header.revoke_cnt; i++)
+        bitmap_mark (applied, txn_list[header.cnt + i]);
+      for (i = 0; i < header.cnt; i++)
+        {
+          block_sector_t sector = txn_list[i];
+          if (bitmap_test (applied, sector))
+            continue;
+          bitmap_mark (applied, sector);
+          if (running_only && !journal_running (sector))
+            continue;
+          block_read (fs_device, log_sector (txn_pos[t] + hdr_cnt + i),
+                      image);
+          block_write (fs_device, sector, image);
+        }
+    }
+  return next;
+}
+
+/* Copies every complete transaction in the log to its home sectors. */
+static void
+journal_replay (void)
+{
+  struct journal_super super;
+
+  block_read (fs_device, JOURNAL_SECTOR, &super);
+  if (super.magic != JOURNAL_SUPER_MAGIC)
+    PANIC ("file system has no journal, reformat it");
+  first_seq = super.seq;
+  seq = journal_apply (false);
+}
+
+/* Initializes the journal.  If FORMAT is true, creates an empty log,
+   otherwise replays whatever the log holds and then empties it.  Must
+   be called before anything is read through the buffer cache. */
+void
+journal_init (bool format)
+{
+  ASSERT (header_sectors (JOURNAL_TXN_MAX + JOURNAL_REVOKE_MAX)
+          <= JOURNAL_HEADER_MAX);
+  ASSERT (JOURNAL_HEADER_MAX + JOURNAL_TXN_MAX + 1 <= JOURNAL_LOG_SECTORS);
+
+  lock_init (&journal_lock);
+  cond_init (&quiet);
+  logged = bitmap_create (block_size (fs_device));
+  applied = bitmap_create (block_size (fs_device));
+  if (logged == NULL || applied == NULL)
+    PANIC ("bitmap creation failed--file system device is too large");
+
+  if (format)
+    {
+      /* Clear the log so nothing left from an earlier file system can
+         pass for a transaction of this one. */
+      static uint8_t zeros[BLOCK_SECTOR_SIZE];
+      size_t i;
+
+      for (i = 0; i < JOURNAL_LOG_SECTORS; i++)
+        block_write (fs_device, log_sector (i), zeros);
+      seq = 1;
+    }
+  else
+    journal_replay ();
+  journal_reset ();
+
+  if (thread_create ("journal", PRI_DEFAULT, journal_committer, NULL)
+      == TID_ERROR)
+    PANIC ("journal_init: cannot start the committer");
+}
+
+/* Commits the running transaction and checkpoints the log, leaving
+   every metadata update on its home sector and the log empty.  Called
+   from filesys_done, before the buffer cache is closed. */
+void
+journal_done (void)
+{
+  lock_acquire (&journal_lock);
+  journal_commit_locked ();
+  buffer_cache_flush ();
+  journal_reset ();
+  lock_release (&journal_lock);
+}
+
+/* Waits until no operation is open, keeping new ones from starting
+   meanwhile, and commits the running transaction.  The caller must
+   hold journal_lock and have no operation open. */
+static void
+journal_quiesce (void)
+{
+  ASSERT (thread_current ()->journal_depth == 0);
+
+  draining++;
+  while (handles > 0)
+    cond_wait (&quiet, &journal_lock);
+  draining--;
+  journal_commit_locked ();
+  cond_broadcast (&quiet, &journal_lock);
+}
+
+/* Starts an operation whose metadata updates must commit together,
+   which logs at most CREDITS sectors and revokes at most REVOKES.
+   Operations may nest; a nested operation's updates commit with the
+   outermost one, which must have reserved room for them, so it never
+   waits. */
+void
+journal_begin (size_t credits, size_t revokes)
+{
+  struct thread *t = thread_current ();
+
+  ASSERT (credits <= JOURNAL_TXN_MAX);
+  ASSERT (revokes <= JOURNAL_REVOKE_MAX);
+
+  lock_acquire (&journal_lock);
+  while (t->journal_depth == 0)
+    {
+      if (draining > 0)
+        cond_wait (&quiet, &journal_lock);
+      else if (pending_cnt + reserved_cnt + credits > JOURNAL_TXN_MAX
+               || (revoked_cnt + reserved_revoke_cnt + revokes
+                   > JOURNAL_REVOKE_MAX))
+        journal_quiesce ();
+      else
+        {
+          reserved_cnt += credits;
+          reserved_revoke_cnt += revokes;
+          t->journal_credits = credits;
+          t->journal_revokes = revokes;
+          break;
+        }
+    }
+  t->journal_depth++;
+  handles++;
+  lock_release (&journal_lock);
+}
+
+/* Ends an operation started with journal_begin.  When no operation is
+   left open, the running transaction is committed if it has grown large
+   or old enough, so operations that finish close together share one
+   log write. */
+void
+journal_end (void)
+{
+  struct thread *t = thread_current ();
+
+  lock_acquire (&journal_lock);
+  ASSERT (handles > 0 && t->journal_depth > 0);
+  handles--;
+  if (--t->journal_depth == 0)
+    {
+      reserved_cnt -= t->journal_credits;
+      reserved_revoke_cnt -= t->journal_revokes;
+    }
+  if (handles == 0)
+    {
+      if (draining == 0 && pending_cnt + revoked_cnt > 0
+          && (pending_cnt >= JOURNAL_GROUP_CNT
+              || timer_elapsed (pending_since) >= JOURNAL_COMMIT_TICKS))
+        journal_commit_locked ();
+      cond_broadcast (&quiet, &journal_lock);
+    }
+  lock_release (&journal_lock);
+}
+
+/* Commits the running transaction now, once the operations open in
+   other threads have ended.  Must not be called within an
+   operation. */
+void
+journal_commit (void)
+{
+  lock_acquire (&journal_lock);
+  journal_quiesce ();
+  lock_release (&journal_lock);
+}
+
+/* Commits the running transaction once its oldest update is
+   JOURNAL_COMMIT_TICKS old, for updates that no later journal_end
+   gets around to committing. */
+static void
+journal_committer (void *aux UNUSED)
+{
+  for (;;)
+    {
+      timer_sleep (JOURNAL_COMMIT_TICKS);
+      lock_acquire (&journal_lock);
+      if (pending_cnt + revoked_cnt > 0
+          && timer_elapsed (pending_since) >= JOURNAL_COMMIT_TICKS)
+        journal_quiesce ();
+      lock_release (&journal_lock);
+    }
+}
+
+/* Returns the pending record for SECTOR, or a null pointer. */
+static struct journal_record *
+journal_find (block_sector_t sector)
+{
+  size_t i;
+
+  for (i = 0; i < pending_cnt; i++)
+    if (pending[i].sector == sector)
+      return &pending[i];
+  return NULL;
+}
+
+/* Returns true if the running transaction logs or revokes SECTOR, so
+   that its cache entry may be pinned. */
+static bool
+journal_running (block_sector_t sector)
+{
+  size_t i;
+
+  if (journal_find (sector) != NULL)
+    return true;
+  for (i = 0; i < revoked_cnt; i++)
+    if (revoked[i] == sector)
+      return true;
+  return false;
+}
+
+/* Makes room in the running transaction for one more image or revoked
+   sector, given CNT of the MAX it may hold, by committing it if it is
+   full.  That is only possible with no operation open; an operation
+   that adds more than it reserved is a bug.  The caller must hold
+   journal_lock. */
+static void
+journal_make_room (size_t cnt, size_t max)
+{
+  if (cnt < max)
+    return;
+  if (handles > 0)
+    PANIC ("journal: operation logged more than it reserved");
+  journal_commit_locked ();
+}
+
+/* Removes SECTOR from the running transaction's revoke list. */
+static void
+journal_unrevoke (block_sector_t sector)
+{
+  size_t i;
+
+  for (i = 0; i < revoked_cnt; i++)
+    if (revoked[i] == sector)
+      {
+        revoked[i] = revoked[--revoked_cnt];
+        return;
+      }
+}
+
+/* Writes SECTOR from BUFFER as part of the running transaction. */
+void
+journal_write (block_sector_t sector, const void *buffer)
+{
+  journal_write_at (sector, buffer, 0, BLOCK_SECTOR_SIZE);
+}
+
+/* Copies SIZE bytes from BUFFER into metadata sector SECTOR starting at
+   byte OFS, as part of the running transaction. */
+void
+journal_write_at (block_sector_t sector, const void *buffer, int ofs,
+                  int size)
+{
+  struct journal_record *rec;
+
+  lock_acquire (&journal_lock);
+
+  rec = journal_find (sector);
+  if (rec == NULL)
+    {
+      journal_make_room (pending_cnt, JOURNAL_TXN_MAX);
+      if (pending_cnt + revoked_cnt == 0)
+        pending_since = timer_ticks ();
+      rec = &pending[pending_cnt++];
+      rec->sector = sector;
+    }
+
+  /* The new image supersedes an earlier revoke of the sector. */
+  journal_unrevoke (sector);
+  bitmap_mark (logged, sector);
+
+  buffer_cache_log_at (sector, buffer, ofs, size, rec->data);
+
+  lock_release (&journal_lock);
+}
+
+/* Notes that the CNT sectors starting at SECTOR were freed, so that
+   replay does not write old metadata images over them after they are
+   reused. */
+void
+journal_revoke (block_sector_t sector, size_t cnt)
+{
+  struct journal_record *rec;
+  size_t i;
+
+  lock_acquire (&journal_lock);
+  for (i = 0; i < cnt; i++, sector++)
+    {
+      if (!bitmap_test (logged, sector))
+        continue;
+
+      /* Don't log an image of a sector that is no longer metadata. */
+      rec = journal_find (sector);
+      if (rec != NULL)
+        *rec = pending[--pending_cnt];
+
+      journal_make_room (revoked_cnt, JOURNAL_REVOKE_MAX);
+      if (pending_cnt + revoked_cnt == 0)
+        pending_since = timer_ticks ();
+      revoked[revoked_cnt++] = sector;
+    }
+  lock_release (&journal_lock);
+}
+
+/* Writes the running transaction to the log, then lets the cache write
+   its sectors home.  The caller must hold journal_lock. */
+static void
+journal_commit_locked (void)
+{
+  static struct journal_header header;
+  static struct journal_commit commit;
+  uint32_t checksum = 2166136261u;
+  size_t hdr_cnt, i;
+
+  ASSERT (lock_held_by_current_thread (&journal_lock));
+
+  if (pending_cnt + revoked_cnt == 0)
+    return;
+
+  /* Checkpoint when the log is full: once every committed update is on
+     its home sector the log can start over.  Entries pinned by the
+     running transaction are not flushed, so the committed images of
+     those sectors are copied home from the log instead, or a crash
+     before this transaction commits would lose them. */
+  hdr_cnt = header_sectors (pending_cnt + revoked_cnt);
+  if (head + hdr_cnt + pending_cnt + 1 > JOURNAL_LOG_SECTORS)
+    {
+      buffer_cache_flush ();
+      journal_apply (true);
+      journal_reset ();
+      for (i = 0; i < pending_cnt; i++)
+        bitmap_mark (logged, pending[i].sector);
+      for (i = 0; i < revoked_cnt; i++)
+        bitmap_mark (logged, revoked[i]);
+    }
+
+  memset (&header, 0, sizeof header);
+  memset (txn_list, 0, sizeof txn_list);
+  header.magic = JOURNAL_HEADER_MAGIC;
+  header.seq = seq;
+  header.cnt = pending_cnt;
+  header.revoke_cnt = revoked_cnt;
+  for (i = 0; i < pending_cnt; i++)
+    txn_list[i] = pending[i].sector;
+  for (i = 0; i < revoked_cnt; i++)
+    txn_list[pending_cnt + i] = revoked[i];
+  memcpy (header.sectors, txn_list, sizeof header.sectors);
+
+  /* Headers and images, one sequential run of sectors. */
+  block_write (fs_device, log_sector (head), &header);
+  checksum = journal_checksum (checksum, &header, BLOCK_SECTOR_SIZE);
+  for (i = 1; i < hdr_cnt; i++)
+    {
+      block_sector_t *extra
+          = txn_list + JOURNAL_HEADER_SLOTS + (i - 1) * JOURNAL_EXTRA_SLOTS;
+      block_write (fs_device, log_sector (head + i), extra);
+      checksum = journal_checksum (checksum, extra, BLOCK_SECTOR_SIZE);
+    }
+  for (i = 0; i < pending_cnt; i++)
+    {
+      block_write (fs_device, log_sector (head + hdr_cnt + i),
+                   pending[i].data);
+      checksum
+          = journal_checksum (checksum, pending[i].data, BLOCK_SECTOR_SIZE);
+    }
+
+  /* The transaction is durable once the commit record is written. */
+  memset (&commit, 0, sizeof commit);
+  commit.magic = JOURNAL_COMMIT_MAGIC;
+  commit.seq = seq;
+  commit.checksum = checksum;
+  block_write (fs_device, log_sector (head + hdr_cnt + pending_cnt),
+               &commit);
+
+  head += hdr_cnt + pending_cnt + 1;
+  seq++;
+  pending_cnt = revoked_cnt = 0;
+  buffer_cache_unpin_all ();
+}
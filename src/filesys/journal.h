@@ -0,0 +1,33 @@
+#ifndef FILESYS_JOURNAL_H
+#define FILESYS_JOURNAL_H
+
+#include "devices/block.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+/* The journal occupies JOURNAL_SECTORS sectors starting at
+   JOURNAL_SECTOR: one superblock followed by the circular log. */
+#define JOURNAL_SECTOR 2
+#define JOURNAL_SECTORS 256
+
+/* Most sector images, and most revoked sectors, in one transaction,
+   and so most an operation may reserve with journal_begin.  Images are
+   bounded by the buffer cache, which keeps their sectors pinned until
+   the transaction commits; revoked sectors by the room in four header
+   sectors. */
+#define JOURNAL_TXN_MAX 32
+#define JOURNAL_REVOKE_MAX 476
+
+void journal_init (bool format);
+void journal_done (void);
+
+void journal_begin (size_t credits, size_t revokes);
+void journal_end (void);
+void journal_commit (void);
+
+void journal_write (block_sector_t sector, const void *buffer);
+void journal_write_at (block_sector_t sector, const void *buffer, int ofs,
+                       int size);
+void journal_revoke (block_sector_t sector, size_t cnt);
+
+#endif /* filesys/journal.h */
@@ -0,0 +1,208 @@
+#include "filesys/range-lock.h"
+#include <debug.h>
+#include <random.h>
+
+/* Initializes TREE as holding no locks. */
+void
+range_tree_init (struct range_tree *tree)
+{
+  tree->root = NULL;
+  lock_init (&tree->lock);
+  cond_init (&tree->released);
+}
+
+/* Initializes RL as a lock on the bytes from START up to END, held
+   by OWNER once acquired. */
+void
+range_lock_init (struct range_lock *rl, off_t start, off_t end,
+                 bool exclusive, const void *owner)
+{
+  ASSERT (start >= 0 && start <= end);
+
+  rl->start = start;
+  rl->end = end;
+  rl->exclusive = exclusive;
+  rl->owner = owner;
+  rl->left = rl->right = NULL;
+}
+
+/* Recomputes the greatest end in the subtree rooted at NODE from its
+   children. */
+static void
+update_max_end (struct range_lock *node)
+{
+  node->max_end = node->end;
+  if (node->left != NULL && node->left->max_end > node->max_end)
+    node->max_end = node->left->max_end;
+  if (node->right != NULL && node->right->max_end > node->max_end)
+    node->max_end = node->right->max_end;
+}
+
+/* Returns true if A sorts before B. */
+static bool
+range_less (const struct range_lock *a, const struct range_lock *b)
+{
+  return a->start < b->start || (a->start == b->start && a < b);
+}
+
+/* Returns true if lock RL, held by another owner than NODE's, cannot
+   be held at the same time as NODE. */
+static bool
+conflicts (const struct range_lock *node, const struct range_lock *rl)
+{
+  return (node->owner != rl->owner && (node->exclusive || rl->exclusive)
+          && node->start < rl->end && rl->start < node->end);
+}
+
+/* Returns true if some lock in the subtree rooted at NODE conflicts
+   with RL. */
+static bool
+any_conflict (const struct range_lock *node, const struct range_lock *rl)
+{
+  while (node != NULL && node->max_end > rl->start)
+    {
+      if (any_conflict (node->left, rl) || conflicts (node, rl))
+        return true;
+
+      /* everything further right starts too late to overlap */
+      if (node->start >= rl->end)
+        return false;
+      node = node->right;
+    }
+  return false;
+}
+
+/* Rotates the subtree rooted at *NODE so that its left child becomes
+   its root. */
+static void
+rotate_right (struct range_lock **node)
+{
+  struct range_lock *l = (*node)->left;
+
+  (*node)->left = l->right;
+  l->right = *node;
+  update_max_end (*node);
+  update_max_end (l);
+  *node = l;
+}
+
+/* Rotates the subtree rooted at *NODE so that its right child becomes
+   its root. */
+static void
+rotate_left (struct range_lock **node)
+{
+  struct range_lock *r = (*node)->right;
+
+  (*node)->right = r->left;
+  r->left = *node;
+  update_max_end (*node);
+  update_max_end (r);
+  *node = r;
+}
+
+/* Inserts RL into the subtree rooted at *NODE. */
+static void
+insert (struct range_lock **node, struct range_lock *rl)
+{
+  if (*node == NULL)
+    {
+      *node = rl;
+      return;
+    }
+
+  if (range_less (rl, *node))
+    {
+      insert (&(*node)->left, rl);
+      if ((*node)->left->priority > (*node)->priority)
+        rotate_right (node);
+    }
+  else
+    {
+      insert (&(*node)->right, rl);
+      if ((*node)->right->priority > (*node)->priority)
+        rotate_left (node);
+    }
+  update_max_end (*node);
+}
+
+/* Removes RL from the subtree rooted at *NODE, which contains it. */
+static void
+delete (struct range_lock **node, struct range_lock *rl)
+{
+  ASSERT (*node != NULL);
+
+  if (*node == rl)
+    {
+      /* rotate RL down until it is a leaf */
+      if (rl->left == NULL && rl->right == NULL)
+        {
+          *node = NULL;
+          return;
+        }
+      if (rl->right == NULL
+          || (rl->left != NULL && rl->left->priority > rl->right->priority))
+        {
+          rotate_right (node);
+          delete (&(*node)->right, rl);
+        }
+      else
+        {
+          rotate_left (node);
+          delete (&(*node)->left, rl);
+        }
+    }
+  else if (range_less (rl, *node))
+    delete (&(*node)->left, rl);
+  else
+    delete (&(*node)->right, rl);
+  update_max_end (*node);
+}
+
+/* Adds RL to TREE, which must have no lock conflicting with it.  The
+   caller must hold TREE's lock. */
+static void
+range_insert (struct range_tree *tree, struct range_lock *rl)
+{
+  rl->left = rl->right = NULL;
+  rl->priority = random_ulong ();
+  rl->max_end = rl->end;
+  insert (&tree->root, rl);
+}
+
+/* Acquires RL in TREE, waiting until no lock of another owner
+   conflicts with it. */
+void
+range_lock_acquire (struct range_tree *tree, struct range_lock *rl)
+{
+  lock_acquire (&tree->lock);
+  while (any_conflict (tree->root, rl))
+    cond_wait (&tree->released, &tree->lock);
+  range_insert (tree, rl);
+  lock_release (&tree->lock);
+}
+
+/* Acquires RL in TREE if no lock of another owner conflicts with it.
+   Returns true if successful, false without waiting otherwise. */
+bool
+range_lock_try_acquire (struct range_tree *tree, struct range_lock *rl)
+{
+  bool success;
+
+  lock_acquire (&tree->lock);
+  success = !any_conflict (tree->root, rl);
+  if (success)
+    range_insert (tree, rl);
+  lock_release (&tree->lock);
+  return success;
+}
+
+/* Releases RL, held in TREE, and wakes up whoever waits for a lock
+   in TREE to see if it can have it now. */
+void
+range_lock_release (struct range_tree *tree, struct range_lock *rl)
+{
+  lock_acquire (&tree->lock);
+  delete (&tree->root, rl);
+  cond_broadcast (&tree->released, &tree->lock);
+  lock_release (&tree->lock);
+}
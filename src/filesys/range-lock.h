@@ -0,0 +1,49 @@
+#ifndef FILESYS_RANGE_LOCK_H
+#define FILESYS_RANGE_LOCK_H
+
+#include "filesys/off_t.h"
+#include "threads/synch.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/* End of a range that runs to the end of the file, however far the
+   file grows. */
+#define RANGE_EOF ((off_t)INT32_MAX)
+
+/* A lock on the bytes from START up to END of a file.  Shared locks
+   of different owners may overlap; an exclusive lock overlaps no
+   lock of another owner.  Locks of the same owner never conflict,
+   so a thread that already holds a range can take it again. */
+struct range_lock
+{
+  off_t start;       /* First byte. */
+  off_t end;         /* One past the last byte. */
+  bool exclusive;    /* Exclusive or shared? */
+  const void *owner; /* Who holds the lock. */
+
+  /* Node of the interval tree, for range-lock.c. */
+  struct range_lock *left, *right; /* Children, by START. */
+  unsigned long priority;          /* Random, greater than children's. */
+  off_t max_end;                   /* Greatest END in the subtree. */
+};
+
+/* The range locks held on one file: an interval tree kept as a
+   treap ordered by START, each node knowing the greatest END below
+   it, so finding the locks that overlap a range takes time
+   logarithmic in the number of locks held, plus one step per lock
+   found. */
+struct range_tree
+{
+  struct range_lock *root;     /* Locks held. */
+  struct lock lock;            /* Protects ROOT and the nodes. */
+  struct condition released;   /* Signaled when a lock is released. */
+};
+
+void range_tree_init (struct range_tree *);
+void range_lock_init (struct range_lock *, off_t start, off_t end,
+                      bool exclusive, const void *owner);
+void range_lock_acquire (struct range_tree *, struct range_lock *);
+bool range_lock_try_acquire (struct range_tree *, struct range_lock *);
+void range_lock_release (struct range_tree *, struct range_lock *);
+
+#endif /* filesys/range-lock.h */
@@ -0,0 +1,11 @@
+#ifndef __LIB_FLOCK_H
+#define __LIB_FLOCK_H
+
+/* Operations for flock(), as in BSD.  Exactly one of LOCK_SH,
+   LOCK_EX and LOCK_UN, optionally or'd with LOCK_NB. */
+#define LOCK_SH 1               /* Shared lock. */
+#define LOCK_EX 2               /* Exclusive lock. */
+#define LOCK_NB 4               /* Fail instead of waiting. */
+#define LOCK_UN 8               /* Release the lock. */
+
+#endif /* lib/flock.h */
@@ -0,0 +1,44 @@
+#ifndef __LIB_HEAT_H
+#define __LIB_HEAT_H
+
+/* How much of its memory a process uses, as measured by sampling
+   the accessed and dirty bits of its pages (see heatmap()).  Each
+   sample shifts one bit per page into a history of the last
+   HEAT_HISTORY samples: a page is hot if it was accessed in one of
+   the last HEAT_HOT samples, warm if only in an older one, and cold
+   if in none of them. */
+#define HEAT_HISTORY 8          /* Samples a page's heat looks back. */
+#define HEAT_HOT 2              /* Recent samples that make it hot. */
+
+/* Regions of a process's address space. */
+enum heat_region
+  {
+    HEAT_CODE,                  /* Read-only executable pages. */
+    HEAT_DATA,                  /* Data segment and heap. */
+    HEAT_STACK,                 /* Stack. */
+    HEAT_MMAP,                  /* Memory-mapped files. */
+    HEAT_REGION_CNT
+  };
+
+/* Pages of one region, by heat. */
+struct heat_counts
+  {
+    unsigned hot;               /* Resident and hot. */
+    unsigned warm;              /* Resident and warm. */
+    unsigned cold;              /* Resident and cold. */
+    unsigned absent;            /* Not resident. */
+    unsigned written;           /* Written in the last HEAT_HISTORY
+                                   samples. */
+  };
+
+/* A process's memory heat as of its latest sample. */
+struct heatmap
+  {
+    unsigned samples;           /* Samples taken so far. */
+    unsigned working_set;       /* Pages accessed in the last
+                                   HEAT_HISTORY samples. */
+    unsigned peak_working_set;  /* Largest working set sampled. */
+    struct heat_counts regions[HEAT_REGION_CNT];
+  };
+
+#endif /* lib/heat.h */
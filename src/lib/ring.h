@@ -0,0 +1,57 @@
+#ifndef __LIB_RING_H
+#define __LIB_RING_H
+
+#include <stdint.h>
+
+/* Submission and completion rings shared by a user process and
+   the kernel (see ring_enter()).
+
+   The process fills in submission queue entries at sq_tail and
+   advances it, then calls ring_enter(), which carries out the
+   entries from sq_head onward, advances sq_head past them, and
+   posts one completion queue entry for each at cq_tail.  The
+   process consumes completions from cq_head.  Indexes run freely
+   and are reduced modulo RING_ENTRIES, so tail - head is always
+   the number of entries in a queue. */
+
+/* Number of entries in each queue.  Must be a power of 2. */
+#define RING_ENTRIES 64
+
+/* Operations. */
+enum ring_op
+  {
+    RING_OP_READ,               /* read (fd, buf, len). */
+    RING_OP_WRITE,              /* write (fd, buf, len). */
+    RING_OP_OPEN,               /* open (buf). */
+    RING_OP_CLOSE               /* close (fd). */
+  };
+
+/* Submission queue entry. */
+struct ring_sqe
+  {
+    int op;                     /* A RING_OP_* value. */
+    int fd;                     /* File descriptor. */
+    void *buf;                  /* Buffer, or file name for open. */
+    unsigned len;               /* Size of buffer. */
+    uint32_t user_data;         /* Copied to the completion. */
+  };
+
+/* Completion queue entry. */
+struct ring_cqe
+  {
+    uint32_t user_data;         /* From the submission. */
+    int result;                 /* What the system call returned. */
+  };
+
+/* A pair of rings. */
+struct ring
+  {
+    unsigned sq_head;           /* Advanced by the kernel. */
+    unsigned sq_tail;           /* Advanced by the process. */
+    unsigned cq_head;           /* Advanced by the process. */
+    unsigned cq_tail;           /* Advanced by the kernel. */
+    struct ring_sqe sq[RING_ENTRIES];
+    struct ring_cqe cq[RING_ENTRIES];
+  };
+
+#endif /* lib/ring.h */
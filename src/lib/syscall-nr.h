@@ -28,7 +28,22 @@ enum
     SYS_MKDIR,                  /* Create a directory. */
     SYS_READDIR,                /* Reads a directory entry. */
     SYS_ISDIR,                  /* Tests if a fd represents a directory. */
-    SYS_INUMBER                 /* Returns the inode number for a fd. */
+    SYS_INUMBER,                /* Returns the inode number for a fd. */
+
+    /* Extensions. */
+    SYS_FSYNC,                  /* Write a file's data and metadata to disk. */
+    SYS_FDATASYNC,              /* Write a file's data to disk. */
+    SYS_PREAD,                  /* Read from a file at an offset. */
+    SYS_PWRITE,                 /* Write to a file at an offset. */
+    SYS_READV,                  /* Read from a file into many buffers. */
+    SYS_WRITEV,                 /* Write many buffers to a file. */
+    SYS_COPY_FILE_RANGE,        /* Copy data between files in the kernel. */
+    SYS_RING_ENTER,             /* Carry out queued ring operations. */
+    SYS_SBRK,                   /* Grow or shrink the heap. */
+    SYS_FORK,                   /* Duplicate this process. */
+    SYS_FLOCK,                  /* Take or drop an advisory file lock. */
+    SYS_HEATMAP,                /* Get the heat of this process's memory. */
+    SYS_SYSENTER                /* Ask whether sysenter may be used. */
   };
 
 #endif /* lib/syscall-nr.h */
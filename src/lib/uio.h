@@ -0,0 +1,16 @@
+#ifndef __LIB_UIO_H
+#define __LIB_UIO_H
+
+#include <stddef.h>
+
+/* One buffer of a vectored read or write (readv, writev). */
+struct iovec 
+  {
+    void *iov_base;             /* Start of buffer. */
+    size_t iov_len;             /* Size of buffer in bytes. */
+  };
+
+/* Maximum number of buffers in one readv or writev call. */
+#define IOV_MAX 64
+
+#endif /* lib/uio.h */
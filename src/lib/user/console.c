@@ -8,7 +8,7 @@
 int
 vprintf (const char *format, va_list args) 
 {
-  return vhprintf (STDOUT_FILENO, format, args);
+  return vfprintf (stdout, format, args);
 }
 
 /* Like printf(), but writes output to the given HANDLE. */
@@ -30,7 +30,7 @@ hprintf (int handle, const char *format, ...)
 int
 puts (const char *s) 
 {
-  write (STDOUT_FILENO, s, strlen (s));
+  fputs (s, stdout);
   putchar ('\n');
 
   return 0;
@@ -40,9 +40,7 @@ puts (const char *s)
 int
 putchar (int c) 
 {
-  char c2 = c;
-  write (STDOUT_FILENO, &c2, 1);
-  return c;
+  return fputc (c, stdout);
 }
 
 /* Auxiliary data for vhprintf_helper(). */
@@ -64,6 +62,11 @@ int
 vhprintf (int handle, const char *format, va_list args) 
 {
   struct vhprintf_aux aux;
+
+  /* keep output to the console in order */
+  if (handle == STDOUT_FILENO)
+    fflush (stdout);
+
   aux.p = aux.buf;
   aux.char_cnt = 0;
   aux.handle = handle;
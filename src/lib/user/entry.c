@@ -6,5 +6,6 @@ void _start (int argc, char *argv[]);
 void
 _start (int argc, char *argv[]) 
 {
+  syscall_set_sysenter (true);
   exit (main (argc, argv));
 }
@@ -0,0 +1,367 @@
+#include <malloc.h>
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
+
+/* A user-space malloc() on top of sbrk().
+
+   Blocks are handed out the same way as by the kernel's malloc()
+   in threads/malloc.c: each request is rounded up to a power of
+   2 and served from the free list of the descriptor for that
+   size class, whose blocks are carved out of one-page arenas.
+   Requests too big for any size class get a run of whole pages
+   with the size recorded in the arena header.
+
+   Pages come from a page allocator that keeps freed runs of
+   pages in an address-ordered list, merging neighbors, and gets
+   more from the kernel with sbrk() when no run is big enough.
+   Whenever the last free run ends at the break, it is given back
+   to the kernel with a negative sbrk(), so memory freed at the
+   top of the heap leaves the process.
+
+   A process has a single thread, so nothing here locks: the fast
+   path of malloc() and free() is a push or pop on a free list. */
+
+#define PAGE_SIZE 4096
+
+/* Descriptor. */
+struct desc
+  {
+    size_t block_size;          /* Size of each element in bytes. */
+    size_t blocks_per_arena;    /* Number of blocks in an arena. */
+    struct block *free_list;    /* Free blocks. */
+  };
+
+/* Magic number for detecting arena corruption. */
+#define ARENA_MAGIC 0x9a548eed
+
+/* Arena. */
+struct arena 
+  {
+    unsigned magic;             /* Always set to ARENA_MAGIC. */
+    struct desc *desc;          /* Owning descriptor, null for big block. */
+    size_t free_cnt;            /* Free blocks; pages in big block. */
+  };
+
+/* Free block. */
+struct block 
+  {
+    struct block *next;         /* Next free block. */
+  };
+
+/* Run of free pages, stored in its own first page. */
+struct run
+  {
+    size_t page_cnt;            /* Number of pages. */
+    struct run *next;           /* Next run, at a higher address. */
+  };
+
+/* Our set of descriptors, for blocks of 16 bytes up to a quarter
+   page. */
+static struct desc descs[] =
+  {
+    {16, (PAGE_SIZE - sizeof (struct arena)) / 16, NULL},
+    {32, (PAGE_SIZE - sizeof (struct arena)) / 32, NULL},
+    {64, (PAGE_SIZE - sizeof (struct arena)) / 64, NULL},
+    {128, (PAGE_SIZE - sizeof (struct arena)) / 128, NULL},
+    {256, (PAGE_SIZE - sizeof (struct arena)) / 256, NULL},
+    {512, (PAGE_SIZE - sizeof (struct arena)) / 512, NULL},
+    {1024, (PAGE_SIZE - sizeof (struct arena)) / 1024, NULL},
+  };
+#define DESC_CNT (sizeof descs / sizeof *descs)
+
+/* Free page runs, in order of address. */
+static struct run *free_runs;
+
+static struct arena *block_to_arena (struct block *);
+static struct block *arena_to_block (struct arena *, size_t idx);
+
+/* Returns PAGE_CNT contiguous pages, or a null pointer if the
+   kernel has no more memory to give. */
+static void *
+get_pages (size_t page_cnt) 
+{
+  struct run **rp;
+  uint8_t *p;
+
+  /* First fit among the free runs. */
+  for (rp = &free_runs; *rp != NULL; rp = &(*rp)->next)
+    {
+      struct run *r = *rp;
+      if (r->page_cnt == page_cnt)
+        {
+          *rp = r->next;
+          return r;
+        }
+      else if (r->page_cnt > page_cnt)
+        {
+          /* Take the tail, so the run itself stays put. */
+          r->page_cnt -= page_cnt;
+          return (uint8_t *) r + r->page_cnt * PAGE_SIZE;
+        }
+    }
+
+  /* Grow the heap, keeping it page-aligned. */
+  p = sbrk (0);
+  if (p == (void *) -1)
+    return NULL;
+  if ((uintptr_t) p % PAGE_SIZE != 0
+      && sbrk (PAGE_SIZE - (uintptr_t) p % PAGE_SIZE) == (void *) -1)
+    return NULL;
+  p = sbrk (page_cnt * PAGE_SIZE);
+  return p != (void *) -1 ? p : NULL;
+}
+
+/* Returns the address just past run R. */
+static uint8_t *
+run_end (struct run *r) 
+{
+  return (uint8_t *) r + r->page_cnt * PAGE_SIZE;
+}
+
+/* Frees the PAGE_CNT pages starting at PAGES, and returns any
+   free memory at the top of the heap to the kernel. */
+static void
+free_pages (void *pages, size_t page_cnt) 
+{
+  struct run *r = pages;
+  struct run *prev = NULL;
+  struct run **rp;
+
+  /* Insert in address order. */
+  for (rp = &free_runs; *rp != NULL && *rp < r; rp = &(*rp)->next)
+    prev = *rp;
+  r->page_cnt = page_cnt;
+  r->next = *rp;
+  *rp = r;
+
+  /* Merge with the following run, then the preceding one. */
+  if (r->next != NULL && run_end (r) == (uint8_t *) r->next)
+    {
+      r->page_cnt += r->next->page_cnt;
+      r->next = r->next->next;
+    }
+  if (prev != NULL && run_end (prev) == (uint8_t *) r)
+    {
+      prev->page_cnt += r->page_cnt;
+      prev->next = r->next;
+      r = prev;
+    }
+
+  /* Give the last run back to the kernel if it ends at the
+     break.  Unlink it first, since its pages go away. */
+  if (r->next == NULL && run_end (r) == sbrk (0))
+    {
+      for (rp = &free_runs; *rp != r; rp = &(*rp)->next)
+        continue;
+      *rp = NULL;
+      if (sbrk (-(intptr_t) (r->page_cnt * PAGE_SIZE)) == (void *) -1)
+        *rp = r;
+    }
+}
+
+/* Obtains and returns a new block of at least SIZE bytes.
+   Returns a null pointer if memory is not available. */
+void *
+malloc (size_t size) 
+{
+  struct desc *d;
+  struct block *b;
+  struct arena *a;
+
+  /* A null pointer satisfies a request for 0 bytes. */
+  if (size == 0)
+    return NULL;
+
+  /* Find the smallest descriptor that satisfies a SIZE-byte
+     request. */
+  for (d = descs; d < descs + DESC_CNT; d++)
+    if (d->block_size >= size)
+      break;
+  if (d == descs + DESC_CNT) 
+    {
+      /* SIZE is too big for any descriptor.
+         Allocate enough pages to hold SIZE plus an arena. */
+      size_t page_cnt;
+
+      if (size > SIZE_MAX - sizeof *a)
+        return NULL;
+      page_cnt = DIV_ROUND_UP (size + sizeof *a, PAGE_SIZE);
+      a = get_pages (page_cnt);
+      if (a == NULL)
+        return NULL;
+
+      /* Initialize the arena to indicate a big block of PAGE_CNT
+         pages, and return it. */
+      a->magic = ARENA_MAGIC;
+      a->desc = NULL;
+      a->free_cnt = page_cnt;
+      return a + 1;
+    }
+
+  /* If the free list is empty, create a new arena. */
+  if (d->free_list == NULL)
+    {
+      size_t i;
+
+      a = get_pages (1);
+      if (a == NULL) 
+        return NULL; 
+
+      /* Initialize arena and add its blocks to the free list,
+         lowest address first. */
+      a->magic = ARENA_MAGIC;
+      a->desc = d;
+      a->free_cnt = d->blocks_per_arena;
+      for (i = d->blocks_per_arena; i-- > 0; ) 
+        {
+          b = arena_to_block (a, i);
+          b->next = d->free_list;
+          d->free_list = b;
+        }
+    }
+
+  /* Get a block from free list and return it. */
+  b = d->free_list;
+  d->free_list = b->next;
+  block_to_arena (b)->free_cnt--;
+  return b;
+}
+
+/* Allocates and return A times B bytes initialized to zeroes.
+   Returns a null pointer if memory is not available. */
+void *
+calloc (size_t a, size_t b) 
+{
+  void *p;
+  size_t size;
+
+  /* Calculate block size and make sure it fits in size_t. */
+  size = a * b;
+  if (b != 0 && size / b != a)
+    return NULL;
+
+  /* Allocate and zero memory.  Pages fresh from sbrk() are
+     already zero, but recycled ones are not. */
+  p = malloc (size);
+  if (p != NULL)
+    memset (p, 0, size);
+
+  return p;
+}
+
+/* Returns the number of bytes allocated for BLOCK. */
+static size_t
+block_size (void *block) 
+{
+  struct block *b = block;
+  struct arena *a = block_to_arena (b);
+  struct desc *d = a->desc;
+
+  return (d != NULL ? d->block_size
+          : PAGE_SIZE * a->free_cnt - sizeof *a);
+}
+
+/* Attempts to resize OLD_BLOCK to NEW_SIZE bytes, possibly
+   moving it in the process.
+   If successful, returns the new block; on failure, returns a
+   null pointer.
+   A call with null OLD_BLOCK is equivalent to malloc(NEW_SIZE).
+   A call with zero NEW_SIZE is equivalent to free(OLD_BLOCK). */
+void *
+realloc (void *old_block, size_t new_size) 
+{
+  if (new_size == 0) 
+    {
+      free (old_block);
+      return NULL;
+    }
+  else if (old_block != NULL && new_size <= block_size (old_block))
+    {
+      /* Still fits. */
+      return old_block;
+    }
+  else 
+    {
+      void *new_block = malloc (new_size);
+      if (old_block != NULL && new_block != NULL)
+        {
+          memcpy (new_block, old_block, block_size (old_block));
+          free (old_block);
+        }
+      return new_block;
+    }
+}
+
+/* Frees block P, which must have been previously allocated with
+   malloc(), calloc(), or realloc(). */
+void
+free (void *p) 
+{
+  struct block *b = p;
+  struct arena *a;
+  struct desc *d;
+
+  if (p == NULL)
+    return;
+
+  a = block_to_arena (b);
+  d = a->desc;
+  if (d == NULL)
+    {
+      /* It's a big block.  Free its pages. */
+      free_pages (a, a->free_cnt);
+      return;
+    }
+
+  /* Add block to free list. */
+  b->next = d->free_list;
+  d->free_list = b;
+
+  /* If the arena is now entirely unused, free it. */
+  if (++a->free_cnt >= d->blocks_per_arena) 
+    {
+      struct block **bp;
+
+      ASSERT (a->free_cnt == d->blocks_per_arena);
+      for (bp = &d->free_list; *bp != NULL; )
+        if (block_to_arena (*bp) == a)
+          *bp = (*bp)->next;
+        else
+          bp = &(*bp)->next;
+      free_pages (a, 1);
+    }
+}
+
+/* Returns the arena that block B is inside. */
+static struct arena *
+block_to_arena (struct block *b)
+{
+  struct arena *a = (struct arena *) ((uintptr_t) b & ~(PAGE_SIZE - 1));
+
+  /* Check that the arena is valid. */
+  ASSERT (a != NULL);
+  ASSERT (a->magic == ARENA_MAGIC);
+
+  /* Check that the block is properly aligned for the arena. */
+  ASSERT (a->desc == NULL
+          || ((uintptr_t) b % PAGE_SIZE - sizeof *a)
+             % a->desc->block_size == 0);
+  ASSERT (a->desc != NULL || (uintptr_t) b % PAGE_SIZE == sizeof *a);
+
+  return a;
+}
+
+/* Returns the (IDX - 1)'th block within arena A. */
+static struct block *
+arena_to_block (struct arena *a, size_t idx) 
+{
+  ASSERT (a != NULL);
+  ASSERT (a->magic == ARENA_MAGIC);
+  ASSERT (idx < a->desc->blocks_per_arena);
+  return (struct block *) ((uint8_t *) a
+                           + sizeof *a
+                           + idx * a->desc->block_size);
+}
@@ -4,4 +4,48 @@
 int hprintf (int, const char *, ...) PRINTF_FORMAT (2, 3);
 int vhprintf (int, const char *, va_list) PRINTF_FORMAT (2, 0);
 
+/* Buffered streams. */
+typedef struct FILE FILE;
+
+#define EOF (-1)                /* Returned at end of file or on error. */
+#define BUFSIZ 512              /* Size of a stream's buffer. */
+#define FOPEN_MAX 16            /* Streams open at once, counting
+                                   stdin and stdout. */
+
+/* Buffering modes for setvbuf(). */
+#define _IOFBF 0                /* Write when the buffer fills. */
+#define _IOLBF 1                /* Also write at each new-line. */
+#define _IONBF 2                /* Read and write immediately. */
+
+/* Origins for fseek(). */
+#define SEEK_SET 0              /* Start of file. */
+#define SEEK_CUR 1              /* Current position. */
+#define SEEK_END 2              /* End of file. */
+
+/* Standard input, unbuffered, and standard output, line
+   buffered.  printf(), puts() and putchar() write to stdout. */
+extern FILE *stdin;
+extern FILE *stdout;
+
+FILE *fopen (const char *, const char *mode);
+FILE *fdopen (int fd, const char *mode);
+int fclose (FILE *);
+int fflush (FILE *);
+int setvbuf (FILE *, char *buf, int mode, size_t size);
+
+size_t fread (void *, size_t size, size_t cnt, FILE *);
+size_t fwrite (const void *, size_t size, size_t cnt, FILE *);
+int fgetc (FILE *);
+char *fgets (char *, int size, FILE *);
+int fputc (int, FILE *);
+int fputs (const char *, FILE *);
+int fprintf (FILE *, const char *, ...) PRINTF_FORMAT (2, 3);
+int vfprintf (FILE *, const char *, va_list) PRINTF_FORMAT (2, 0);
+
+int fseek (FILE *, long ofs, int whence);
+long ftell (FILE *);
+int feof (FILE *);
+int ferror (FILE *);
+int fileno (FILE *);
+
 #endif /* lib/user/stdio.h */
@@ -0,0 +1,458 @@
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+
+/* Stream flags. */
+#define F_READ   0x01           /* Opened for reading. */
+#define F_WRITE  0x02           /* Opened for writing. */
+#define F_APPEND 0x04           /* Every write goes at end of file. */
+#define F_EOF    0x08           /* End of file reached. */
+#define F_ERR    0x10           /* An I/O error occurred. */
+
+/* A buffered stream.
+
+   The buffer holds either input not yet consumed, in
+   buf[rpos...rlen), or output not yet written, in buf[0...wlen),
+   never both, so the file position as seen by the caller is the
+   file descriptor's position less the unread input or plus the
+   unwritten output. */
+struct FILE
+  {
+    int fd;                     /* File descriptor. */
+    unsigned flags;             /* F_* flags; 0 if not in use. */
+    int mode;                   /* _IOFBF, _IOLBF or _IONBF. */
+    char *buf;                  /* Buffer. */
+    size_t size;                /* Size of BUF. */
+    size_t rpos, rlen;          /* Unread input. */
+    size_t wlen;                /* Unwritten output. */
+  };
+
+/* Default buffers, one per stream, kept apart from the streams
+   themselves so that they take up no space in the executable. */
+static char buffers[FOPEN_MAX][BUFSIZ];
+
+/* All the streams.  The first two are stdin and stdout. */
+static FILE streams[FOPEN_MAX] =
+  {
+    {STDIN_FILENO, F_READ, _IONBF, buffers[0], BUFSIZ, 0, 0, 0},
+    {STDOUT_FILENO, F_WRITE, _IOLBF, buffers[1], BUFSIZ, 0, 0, 0},
+  };
+
+FILE *stdin = &streams[0];
+FILE *stdout = &streams[1];
+
+/* Parses MODE, as passed to fopen(), into F_* flags.  Returns 0
+   if MODE is invalid. */
+static unsigned
+parse_mode (const char *mode) 
+{
+  unsigned flags;
+
+  switch (mode[0]) 
+    {
+    case 'r': flags = F_READ; break;
+    case 'w': flags = F_WRITE; break;
+    case 'a': flags = F_WRITE | F_APPEND; break;
+    default: return 0;
+    }
+  if (strchr (mode, '+') != NULL)
+    flags |= F_READ | F_WRITE;
+  return flags;
+}
+
+/* Returns a free stream set up to use FD with FLAGS, or a null
+   pointer if all FOPEN_MAX are in use. */
+static FILE *
+alloc_stream (int fd, unsigned flags) 
+{
+  FILE *f;
+
+  for (f = streams; f < streams + FOPEN_MAX; f++)
+    if (f->flags == 0) 
+      {
+        f->fd = fd;
+        f->flags = flags;
+        f->mode = _IOFBF;
+        f->buf = buffers[f - streams];
+        f->size = BUFSIZ;
+        f->rpos = f->rlen = f->wlen = 0;
+        return f;
+      }
+  return NULL;
+}
+
+/* Opens file NAME as a stream.  MODE is "r" to read, "w" to
+   write a new, empty file, or "a" to append to a file, created
+   if necessary, optionally followed by "+" to allow both reading
+   and writing.  Returns the stream, or a null pointer on
+   failure. */
+FILE *
+fopen (const char *name, const char *mode) 
+{
+  unsigned flags = parse_mode (mode);
+  FILE *f;
+  int fd;
+
+  if (flags == 0)
+    return NULL;
+
+  /* Pintos files can't be truncated, but a removed file stays
+     usable by whoever has it open, so replace it instead. */
+  if (mode[0] == 'w')
+    {
+      remove (name);
+      if (!create (name, 0))
+        return NULL;
+    }
+  else if (mode[0] == 'a')
+    create (name, 0);
+
+  fd = open (name);
+  if (fd < 0)
+    return NULL;
+  f = alloc_stream (fd, flags);
+  if (f == NULL)
+    close (fd);
+  return f;
+}
+
+/* Returns a stream for file descriptor FD, which must already be
+   open, with MODE interpreted as by fopen(), or a null pointer on
+   failure. */
+FILE *
+fdopen (int fd, const char *mode) 
+{
+  unsigned flags = parse_mode (mode);
+  return flags != 0 ? alloc_stream (fd, flags) : NULL;
+}
+
+/* Writes F's buffered output.  Returns 0 if successful, EOF on
+   error. */
+static int
+flush_output (FILE *f) 
+{
+  if (f->wlen > 0) 
+    {
+      if (f->flags & F_APPEND)
+        seek (f->fd, filesize (f->fd));
+      if (write (f->fd, f->buf, f->wlen) != (int) f->wlen)
+        {
+          f->flags |= F_ERR;
+          f->wlen = 0;
+          return EOF;
+        }
+      f->wlen = 0;
+    }
+  return 0;
+}
+
+/* Throws away F's buffered input, moving the file descriptor
+   back to where the caller thinks the stream is. */
+static void
+drop_input (FILE *f) 
+{
+  if (f->rpos < f->rlen)
+    seek (f->fd, tell (f->fd) - (f->rlen - f->rpos));
+  f->rpos = f->rlen = 0;
+}
+
+/* Writes any buffered output for F, or for every stream if F is
+   a null pointer.  Returns 0 if successful, EOF on error. */
+int
+fflush (FILE *f) 
+{
+  int result = 0;
+
+  if (f != NULL)
+    return flush_output (f);
+  for (f = streams; f < streams + FOPEN_MAX; f++)
+    if (f->flags & F_WRITE && flush_output (f) != 0)
+      result = EOF;
+  return result;
+}
+
+/* Flushes and closes F.  Returns 0 if successful, EOF if
+   buffered output could not be written. */
+int
+fclose (FILE *f) 
+{
+  int result = flush_output (f);
+  if (f->fd != STDIN_FILENO && f->fd != STDOUT_FILENO)
+    close (f->fd);
+  f->flags = 0;
+  return result;
+}
+
+/* Sets F's buffering MODE, using the SIZE bytes at BUF as its
+   buffer, or F's own buffer if BUF is a null pointer.  Must be
+   called before any I/O on F.  Returns 0 if successful, nonzero
+   otherwise. */
+int
+setvbuf (FILE *f, char *buf, int mode, size_t size) 
+{
+  if (mode != _IOFBF && mode != _IOLBF && mode != _IONBF)
+    return EOF;
+  if (buf == NULL || size == 0) 
+    {
+      buf = buffers[f - streams];
+      size = BUFSIZ;
+    }
+  f->mode = mode;
+  f->buf = buf;
+  f->size = size;
+  return 0;
+}
+
+/* Refills F's buffer from its file.  Returns true if any input
+   is now buffered. */
+static bool
+fill_input (FILE *f) 
+{
+  int n;
+
+  if (flush_output (f) != 0)
+    return false;
+
+  /* the console delivers input one key at a time, so asking an
+     unbuffered stream for more would block */
+  n = read (f->fd, f->buf, f->mode == _IONBF ? 1 : f->size);
+  f->rpos = 0;
+  f->rlen = n > 0 ? n : 0;
+  if (n == 0)
+    f->flags |= F_EOF;
+  else if (n < 0)
+    f->flags |= F_ERR;
+  return n > 0;
+}
+
+/* Reads up to CNT objects of SIZE bytes each from F into
+   BUFFER.  Returns the number of whole objects read. */
+size_t
+fread (void *buffer, size_t size, size_t cnt, FILE *f) 
+{
+  char *dst = buffer;
+  size_t total = size * cnt;
+  size_t done = 0;
+
+  if (total == 0 || !(f->flags & F_READ))
+    return 0;
+
+  while (done < total)
+    {
+      size_t left = total - done;
+      size_t avail = f->rlen - f->rpos;
+
+      if (avail > 0)
+        {
+          size_t n = avail < left ? avail : left;
+          memcpy (dst + done, f->buf + f->rpos, n);
+          f->rpos += n;
+          done += n;
+        }
+      else if (left >= f->size && f->mode != _IONBF)
+        {
+          /* large reads skip the buffer */
+          int n;
+
+          if (flush_output (f) != 0)
+            break;
+          n = read (f->fd, dst + done, left);
+          if (n <= 0)
+            {
+              f->flags |= n == 0 ? F_EOF : F_ERR;
+              break;
+            }
+          done += n;
+        }
+      else if (!fill_input (f))
+        break;
+    }
+  return done / size;
+}
+
+/* Writes CNT objects of SIZE bytes each from BUFFER to F.
+   Returns the number of whole objects written. */
+size_t
+fwrite (const void *buffer, size_t size, size_t cnt, FILE *f) 
+{
+  const char *src = buffer;
+  size_t total = size * cnt;
+
+  if (total == 0 || !(f->flags & F_WRITE))
+    return 0;
+  drop_input (f);
+
+  if (total > f->size - f->wlen)
+    {
+      if (flush_output (f) != 0)
+        return 0;
+      if (total >= f->size)
+        {
+          /* large writes skip the buffer */
+          int n;
+
+          if (f->flags & F_APPEND)
+            seek (f->fd, filesize (f->fd));
+          n = write (f->fd, src, total);
+          if (n != (int) total)
+            f->flags |= F_ERR;
+          return n > 0 ? (size_t) n / size : 0;
+        }
+    }
+
+  memcpy (f->buf + f->wlen, src, total);
+  f->wlen += total;
+  if (f->mode == _IONBF
+      || (f->mode == _IOLBF && memchr (src, '\n', total) != NULL))
+    if (flush_output (f) != 0)
+      return 0;
+  return cnt;
+}
+
+/* Reads and returns one character from F, or EOF at end of file
+   or on error. */
+int
+fgetc (FILE *f) 
+{
+  if (!(f->flags & F_READ))
+    return EOF;
+  if (f->rpos >= f->rlen && !fill_input (f))
+    return EOF;
+  return (unsigned char) f->buf[f->rpos++];
+}
+
+/* Reads characters from F into S until a new-line, which is
+   kept, end of file, or SIZE - 1 characters, and null-terminates
+   S.  Returns S, or a null pointer if nothing could be read. */
+char *
+fgets (char *s, int size, FILE *f) 
+{
+  int i = 0;
+
+  if (size <= 0)
+    return NULL;
+  while (i < size - 1)
+    {
+      int c = fgetc (f);
+      if (c == EOF)
+        break;
+      s[i++] = c;
+      if (c == '\n')
+        break;
+    }
+  if (i == 0)
+    return NULL;
+  s[i] = '\0';
+  return s;
+}
+
+/* Writes character C to F.  Returns C, or EOF on error. */
+int
+fputc (int c, FILE *f) 
+{
+  char c2 = c;
+  return fwrite (&c2, 1, 1, f) == 1 ? (unsigned char) c : EOF;
+}
+
+/* Writes string S to F, without a new-line.  Returns a
+   nonnegative number, or EOF on error. */
+int
+fputs (const char *s, FILE *f) 
+{
+  size_t len = strlen (s);
+  return fwrite (s, 1, len, f) == len ? 0 : EOF;
+}
+
+/* Auxiliary data for vfprintf_helper(). */
+struct vfprintf_aux 
+  {
+    FILE *stream;       /* Output stream. */
+    int char_cnt;       /* Total characters written so far. */
+  };
+
+/* Writes C to the stream in AUX_. */
+static void
+vfprintf_helper (char c, void *aux_) 
+{
+  struct vfprintf_aux *aux = aux_;
+  fputc (c, aux->stream);
+  aux->char_cnt++;
+}
+
+/* Like vprintf(), but writes to stream F. */
+int
+vfprintf (FILE *f, const char *format, va_list args) 
+{
+  struct vfprintf_aux aux;
+  aux.stream = f;
+  aux.char_cnt = 0;
+  __vprintf (format, args, vfprintf_helper, &aux);
+  return aux.char_cnt;
+}
+
+/* Like printf(), but writes to stream F. */
+int
+fprintf (FILE *f, const char *format, ...) 
+{
+  va_list args;
+  int retval;
+
+  va_start (args, format);
+  retval = vfprintf (f, format, args);
+  va_end (args);
+
+  return retval;
+}
+
+/* Moves F's position to OFS bytes from the start of the file
+   (WHENCE is SEEK_SET), its current position (SEEK_CUR), or the
+   end of the file (SEEK_END), and clears its end-of-file
+   indicator.  Returns 0 if successful, -1 on error. */
+int
+fseek (FILE *f, long ofs, int whence) 
+{
+  long pos;
+
+  switch (whence)
+    {
+    case SEEK_SET: pos = ofs; break;
+    case SEEK_CUR: pos = ftell (f) + ofs; break;
+    case SEEK_END: pos = filesize (f->fd) + ofs; break;
+    default: return -1;
+    }
+  if (pos < 0 || flush_output (f) != 0)
+    return -1;
+
+  f->rpos = f->rlen = 0;
+  seek (f->fd, pos);
+  f->flags &= ~F_EOF;
+  return 0;
+}
+
+/* Returns F's position in its file. */
+long
+ftell (FILE *f) 
+{
+  return (long) tell (f->fd) - (long) (f->rlen - f->rpos) + (long) f->wlen;
+}
+
+/* Returns true if end of file has been reached on F. */
+int
+feof (FILE *f) 
+{
+  return (f->flags & F_EOF) != 0;
+}
+
+/* Returns true if an I/O error has occurred on F. */
+int
+ferror (FILE *f) 
+{
+  return (f->flags & F_ERR) != 0;
+}
+
+/* Returns F's file descriptor. */
+int
+fileno (FILE *f) 
+{
+  return f->fd;
+}
@@ -1,9 +1,10 @@
 #include <syscall.h>
+#include <stdio.h>
 #include "../syscall-nr.h"
 
-/* Invokes syscall NUMBER, passing no arguments, and returns the
-   return value as an `int'. */
-#define syscall0(NUMBER)                                        \
+/* Invokes syscall NUMBER with `int $0x30', passing no
+   arguments, and returns the return value as an `int'. */
+#define int_syscall0(NUMBER)                                    \
         ({                                                      \
           int retval;                                           \
           asm volatile                                          \
@@ -14,9 +15,9 @@
           retval;                                               \
         })
 
-/* Invokes syscall NUMBER, passing argument ARG0, and returns the
-   return value as an `int'. */
-#define syscall1(NUMBER, ARG0)                                           \
+/* Invokes syscall NUMBER with `int $0x30', passing argument
+   ARG0, and returns the return value as an `int'. */
+#define int_syscall1(NUMBER, ARG0)                                       \
         ({                                                               \
           int retval;                                                    \
           asm volatile                                                   \
@@ -28,9 +29,9 @@
           retval;                                                        \
         })
 
-/* Invokes syscall NUMBER, passing arguments ARG0 and ARG1, and
-   returns the return value as an `int'. */
-#define syscall2(NUMBER, ARG0, ARG1)                            \
+/* Invokes syscall NUMBER with `int $0x30', passing arguments
+   ARG0 and ARG1, and returns the return value as an `int'. */
+#define int_syscall2(NUMBER, ARG0, ARG1)                        \
         ({                                                      \
           int retval;                                           \
           asm volatile                                          \
@@ -44,9 +45,10 @@
           retval;                                               \
         })
 
-/* Invokes syscall NUMBER, passing arguments ARG0, ARG1, and
-   ARG2, and returns the return value as an `int'. */
-#define syscall3(NUMBER, ARG0, ARG1, ARG2)                      \
+/* Invokes syscall NUMBER with `int $0x30', passing arguments
+   ARG0, ARG1, and ARG2, and returns the return value as an
+   `int'. */
+#define int_syscall3(NUMBER, ARG0, ARG1, ARG2)                  \
         ({                                                      \
           int retval;                                           \
           asm volatile                                          \
@@ -61,6 +63,92 @@
           retval;                                               \
         })
 
+/* Invokes syscall NUMBER with `int $0x30', passing arguments
+   ARG0, ARG1, ARG2, and ARG3, and returns the return value as
+   an `int'. */
+#define int_syscall4(NUMBER, ARG0, ARG1, ARG2, ARG3)            \
+        ({                                                      \
+          int retval;                                           \
+          asm volatile                                          \
+            ("pushl %[arg3]; pushl %[arg2]; pushl %[arg1]; "    \
+             "pushl %[arg0]; pushl %[number]; int $0x30; "      \
+             "addl $20, %%esp"                                  \
+               : "=a" (retval)                                  \
+               : [number] "i" (NUMBER),                         \
+                 [arg0] "r" (ARG0),                             \
+                 [arg1] "r" (ARG1),                             \
+                 [arg2] "r" (ARG2),                             \
+                 [arg3] "r" (ARG3)                              \
+               : "memory");                                     \
+          retval;                                               \
+        })
+
+/* Invokes syscall NUMBER with `int $0x30', passing arguments
+   ARG0, ARG1, ARG2, ARG3, and ARG4, and returns the return
+   value as an `int'. */
+#define int_syscall5(NUMBER, ARG0, ARG1, ARG2, ARG3, ARG4)      \
+        ({                                                      \
+          int retval;                                           \
+          asm volatile                                          \
+            ("pushl %[arg4]; pushl %[arg3]; pushl %[arg2]; "    \
+             "pushl %[arg1]; pushl %[arg0]; "                   \
+             "pushl %[number]; int $0x30; addl $24, %%esp"      \
+               : "=a" (retval)                                  \
+               : [number] "i" (NUMBER),                         \
+                 [arg0] "r" (ARG0),                             \
+                 [arg1] "r" (ARG1),                             \
+                 [arg2] "r" (ARG2),                             \
+                 [arg3] "r" (ARG3),                             \
+                 [arg4] "r" (ARG4)                              \
+               : "memory");                                     \
+          retval;                                               \
+        })
+
+/* True if system calls enter the kernel with sysenter rather than
+   `int $0x30'.  See syscall_set_sysenter(). */
+static bool use_sysenter;
+
+/* Invokes a system call with sysenter.  NUMBER and the arguments
+   that follow are laid out on the stack by the C calling
+   convention exactly as the int_syscallN() macros push them.
+   Defined in sysenter.S. */
+int sysenter_call (int number, ...);
+
+/* Invoke syscall NUMBER with the given arguments through the
+   fastest entry path available, and return the return value as
+   an `int'. */
+#define syscall0(NUMBER)                                        \
+        (use_sysenter ? sysenter_call (NUMBER)                  \
+         : int_syscall0 (NUMBER))
+#define syscall1(NUMBER, ARG0)                                  \
+        (use_sysenter ? sysenter_call (NUMBER, ARG0)            \
+         : int_syscall1 (NUMBER, ARG0))
+#define syscall2(NUMBER, ARG0, ARG1)                            \
+        (use_sysenter ? sysenter_call (NUMBER, ARG0, ARG1)      \
+         : int_syscall2 (NUMBER, ARG0, ARG1))
+#define syscall3(NUMBER, ARG0, ARG1, ARG2)                      \
+        (use_sysenter ? sysenter_call (NUMBER, ARG0, ARG1, ARG2) \
+         : int_syscall3 (NUMBER, ARG0, ARG1, ARG2))
+#define syscall4(NUMBER, ARG0, ARG1, ARG2, ARG3)                \
+        (use_sysenter                                           \
+         ? sysenter_call (NUMBER, ARG0, ARG1, ARG2, ARG3)       \
+         : int_syscall4 (NUMBER, ARG0, ARG1, ARG2, ARG3))
+#define syscall5(NUMBER, ARG0, ARG1, ARG2, ARG3, ARG4)          \
+        (use_sysenter                                           \
+         ? sysenter_call (NUMBER, ARG0, ARG1, ARG2, ARG3, ARG4) \
+         : int_syscall5 (NUMBER, ARG0, ARG1, ARG2, ARG3, ARG4))
+
+/* Makes system calls use sysenter if ENABLE is true and the
+   kernel has set it up, which it is asked with `int $0x30', and
+   `int $0x30' otherwise.  Returns true if sysenter is now in use.
+   Called with ENABLE true by _start(). */
+bool
+syscall_set_sysenter (bool enable) 
+{
+  use_sysenter = enable && int_syscall0 (SYS_SYSENTER) != 0;
+  return use_sysenter;
+}
+
 void
 halt (void) 
 {
@@ -71,6 +159,7 @@ halt (void)
 void
 exit (int status)
 {
+  fflush (NULL);
   syscall1 (SYS_EXIT, status);
   NOT_REACHED ();
 }
@@ -182,3 +271,76 @@ inumber (int fd)
 {
   return syscall1 (SYS_INUMBER, fd);
 }
+
+int
+fsync (int fd) 
+{
+  return syscall1 (SYS_FSYNC, fd);
+}
+
+int
+fdatasync (int fd) 
+{
+  return syscall1 (SYS_FDATASYNC, fd);
+}
+
+int
+pread (int fd, void *buffer, unsigned size, unsigned offset) 
+{
+  return syscall4 (SYS_PREAD, fd, buffer, size, offset);
+}
+
+int
+pwrite (int fd, const void *buffer, unsigned size, unsigned offset) 
+{
+  return syscall4 (SYS_PWRITE, fd, buffer, size, offset);
+}
+
+int
+readv (int fd, const struct iovec *iov, int iovcnt) 
+{
+  return syscall3 (SYS_READV, fd, iov, iovcnt);
+}
+
+int
+writev (int fd, const struct iovec *iov, int iovcnt) 
+{
+  return syscall3 (SYS_WRITEV, fd, iov, iovcnt);
+}
+
+int
+copy_file_range (int fd_in, unsigned off_in, int fd_out, unsigned off_out,
+                 unsigned size) 
+{
+  return syscall5 (SYS_COPY_FILE_RANGE, fd_in, off_in, fd_out, off_out, size);
+}
+
+int
+ring_enter (struct ring *ring, unsigned to_submit) 
+{
+  return syscall2 (SYS_RING_ENTER, ring, to_submit);
+}
+
+void *
+sbrk (intptr_t increment) 
+{
+  return (void *) syscall1 (SYS_SBRK, increment);
+}
+
+pid_t
+fork (void) 
+{
+  return (pid_t) syscall0 (SYS_FORK);
+}
+
+int
+flock (int fd, int operation) 
+{
+  return syscall2 (SYS_FLOCK, fd, operation);
+}
+
+int
+heatmap (struct heatmap *heatmap) 
+{
+  return syscall1 (SYS_HEATMAP, heatmap);
+}
@@ -2,7 +2,12 @@
 #define __LIB_USER_SYSCALL_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <debug.h>
+#include <flock.h>
+#include <heat.h>
+#include <ring.h>
+#include <uio.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -45,4 +50,22 @@ bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir (int fd);
 int inumber (int fd);
 
+/* Extensions. */
+int fsync (int fd);
+int fdatasync (int fd);
+int pread (int fd, void *buffer, unsigned length, unsigned offset);
+int pwrite (int fd, const void *buffer, unsigned length, unsigned offset);
+int readv (int fd, const struct iovec *iov, int iovcnt);
+int writev (int fd, const struct iovec *iov, int iovcnt);
+int copy_file_range (int fd_in, unsigned off_in, int fd_out,
+                     unsigned off_out, unsigned length);
+int ring_enter (struct ring *, unsigned to_submit);
+void *sbrk (intptr_t increment);
+pid_t fork (void);
+int flock (int fd, int operation);
+int heatmap (struct heatmap *);
+
+/* System call entry. */
+bool syscall_set_sysenter (bool enable);
+
 #endif /* lib/user/syscall.h */
@@ -0,0 +1,75 @@
+#include <uring.h>
+#include <string.h>
+#include <syscall.h>
+
+/* Initializes RING with both queues empty. */
+void
+ring_init (struct ring *ring) 
+{
+  memset (ring, 0, sizeof *ring);
+}
+
+/* Returns the next free submission queue entry of RING, which
+   the caller must fill in before the next ring_get_sqe() call,
+   or a null pointer if the queue is full. */
+struct ring_sqe *
+ring_get_sqe (struct ring *ring) 
+{
+  if (ring->sq_tail - ring->sq_head >= RING_ENTRIES)
+    return NULL;
+  return &ring->sq[ring->sq_tail++ % RING_ENTRIES];
+}
+
+/* Queues operation OP on FD with BUF and LEN in RING, tagged with
+   USER_DATA.  If the submission queue is full, submits it first,
+   which the kernel carries out only as far as there are free
+   completion slots.  Returns false if the operation could not be
+   queued because both queues are full; the caller must then consume
+   some completions and try again. */
+bool
+ring_queue (struct ring *ring, int op, int fd, void *buf, unsigned len,
+            uint32_t user_data) 
+{
+  struct ring_sqe *sqe = ring_get_sqe (ring);
+
+  if (sqe == NULL)
+    {
+      ring_submit (ring);
+      sqe = ring_get_sqe (ring);
+      if (sqe == NULL)
+        return false;
+    }
+
+  sqe->op = op;
+  sqe->fd = fd;
+  sqe->buf = buf;
+  sqe->len = len;
+  sqe->user_data = user_data;
+  return true;
+}
+
+/* Hands every queued operation in RING to the kernel with one
+   system call.  Returns the number the kernel carried out, which
+   is fewer than were queued if the completion queue filled. */
+int
+ring_submit (struct ring *ring) 
+{
+  return ring_enter (ring, ring->sq_tail - ring->sq_head);
+}
+
+/* Returns the oldest unconsumed completion in RING, or a null
+   pointer if there is none. */
+struct ring_cqe *
+ring_peek_cqe (struct ring *ring) 
+{
+  if (ring->cq_head == ring->cq_tail)
+    return NULL;
+  return &ring->cq[ring->cq_head % RING_ENTRIES];
+}
+
+/* Consumes the completion returned by ring_peek_cqe(). */
+void
+ring_cqe_seen (struct ring *ring) 
+{
+  ring->cq_head++;
+}
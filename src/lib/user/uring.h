@@ -0,0 +1,18 @@
+#ifndef __LIB_USER_URING_H
+#define __LIB_USER_URING_H
+
+#include <ring.h>
+#include <stdbool.h>
+
+/* Helpers for queuing system calls on a struct ring and
+   submitting them with a single ring_enter() call. */
+
+void ring_init (struct ring *);
+struct ring_sqe *ring_get_sqe (struct ring *);
+bool ring_queue (struct ring *, int op, int fd, void *buf, unsigned len,
+                 uint32_t user_data);
+int ring_submit (struct ring *);
+struct ring_cqe *ring_peek_cqe (struct ring *);
+void ring_cqe_seen (struct ring *);
+
+#endif /* lib/user/uring.h */
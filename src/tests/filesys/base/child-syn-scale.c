@@ -0,0 +1,52 @@
+/* Child process for syn-scale test.
+   Writes its own file a sector at a time, then reads it back
+   READ_PASSES times, checking the contents on every pass. */
+
+#include <random.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/filesys/base/syn-scale.h"
+
+static char buf[FILE_SIZE];
+static char chunk[CHUNK_SIZE];
+
+int
+main (int argc, char *argv[])
+{
+  char file_name[16];
+  int child_idx;
+  int pass;
+  size_t ofs;
+  int fd;
+
+  test_name = "child-syn-scale";
+  quiet = true;
+
+  CHECK (argc == 2, "argc must be 2, actually %d", argc);
+  child_idx = atoi (argv[1]);
+  snprintf (file_name, sizeof file_name, "scale%d", child_idx);
+
+  random_init (child_idx);
+  random_bytes (buf, sizeof buf);
+
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  for (ofs = 0; ofs < FILE_SIZE; ofs += CHUNK_SIZE)
+    CHECK (write (fd, buf + ofs, CHUNK_SIZE) == CHUNK_SIZE,
+           "write \"%s\"", file_name);
+
+  for (pass = 0; pass < READ_PASSES; pass++)
+    {
+      seek (fd, 0);
+      for (ofs = 0; ofs < FILE_SIZE; ofs += CHUNK_SIZE)
+        {
+          CHECK (read (fd, chunk, CHUNK_SIZE) == CHUNK_SIZE,
+                 "read \"%s\"", file_name);
+          compare_bytes (chunk, buf + ofs, CHUNK_SIZE, ofs, file_name);
+        }
+    }
+  close (fd);
+
+  return child_idx;
+}
@@ -0,0 +1,45 @@
+/* Copies a file in the kernel with copy_file_range, in chunks
+   that do not line up with sectors, and verifies the copy. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define CHUNK_SIZE 700
+
+char buf[4321];
+
+void
+test_main (void) 
+{
+  int in_fd, out_fd;
+  unsigned ofs;
+  int copied;
+
+  random_bytes (buf, sizeof buf);
+  CHECK (create ("source", 0), "create \"source\"");
+  CHECK ((in_fd = open ("source")) > 1, "open \"source\"");
+  CHECK (write (in_fd, buf, sizeof buf) == sizeof buf, "write \"source\"");
+  CHECK (create ("copy", 0), "create \"copy\"");
+  CHECK ((out_fd = open ("copy")) > 1, "open \"copy\"");
+
+  msg ("copy \"source\" to \"copy\"");
+  for (ofs = 0; ofs < sizeof buf; ofs += copied)
+    {
+      copied = copy_file_range (in_fd, ofs, out_fd, ofs, CHUNK_SIZE);
+      if (copied <= 0)
+        fail ("copy_file_range at offset %u returned %d", ofs, copied);
+    }
+  CHECK (copy_file_range (in_fd, sizeof buf, out_fd, sizeof buf,
+                          CHUNK_SIZE) == 0,
+         "copy past end of \"source\"");
+  CHECK (copy_file_range (in_fd, 0, in_fd, 100, CHUNK_SIZE) == -1,
+         "copy overlapping range");
+
+  msg ("close \"source\"");
+  close (in_fd);
+  msg ("close \"copy\"");
+  close (out_fd);
+  check_file ("copy", buf, sizeof buf);
+}
@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(sm-copy-range) begin
+(sm-copy-range) create "source"
+(sm-copy-range) open "source"
+(sm-copy-range) write "source"
+(sm-copy-range) create "copy"
+(sm-copy-range) open "copy"
+(sm-copy-range) copy "source" to "copy"
+(sm-copy-range) copy past end of "source"
+(sm-copy-range) copy overlapping range
+(sm-copy-range) close "source"
+(sm-copy-range) close "copy"
+(sm-copy-range) open "copy" for verification
+(sm-copy-range) verified contents of "copy"
+(sm-copy-range) close "copy"
+(sm-copy-range) end
+EOF
+pass;
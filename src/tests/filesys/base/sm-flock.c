@@ -0,0 +1,39 @@
+/* Takes advisory locks on one file through two open files and
+   checks which ones conflict, that they do not block reads and
+   writes, and that closing a file drops its lock. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[] = "flocked";
+
+void
+test_main (void) 
+{
+  const char *file_name = "lockee";
+  int fd1, fd2;
+
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd1 = open (file_name)) > 1, "open \"%s\" once", file_name);
+  CHECK ((fd2 = open (file_name)) > 1, "open \"%s\" twice", file_name);
+
+  CHECK (flock (fd1, LOCK_EX) == 0, "lock first exclusively");
+  CHECK (flock (fd2, LOCK_SH | LOCK_NB) == -1,
+         "shared lock on second conflicts");
+  CHECK (write (fd2, buf, sizeof buf) == sizeof buf,
+         "write through second anyway");
+  CHECK (flock (fd1, LOCK_SH) == 0, "convert first to shared");
+  CHECK (flock (fd2, LOCK_SH | LOCK_NB) == 0, "share lock with second");
+  CHECK (flock (fd1, LOCK_EX | LOCK_NB) == -1,
+         "exclusive lock on first conflicts");
+  msg ("close second");
+  close (fd2);
+  CHECK (flock (fd1, LOCK_EX | LOCK_NB) == 0, "lock first exclusively again");
+  CHECK (flock (fd1, LOCK_UN) == 0, "unlock first");
+  CHECK (flock (fd1, LOCK_SH | LOCK_EX) == -1, "bad operation");
+  CHECK (flock (fd1 + 1, LOCK_SH) == -1, "lock bad fd");
+  msg ("close first");
+  close (fd1);
+  check_file (file_name, buf, sizeof buf);
+}
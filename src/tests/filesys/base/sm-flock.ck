@@ -0,0 +1,27 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(sm-flock) begin
+(sm-flock) create "lockee"
+(sm-flock) open "lockee" once
+(sm-flock) open "lockee" twice
+(sm-flock) lock first exclusively
+(sm-flock) shared lock on second conflicts
+(sm-flock) write through second anyway
+(sm-flock) convert first to shared
+(sm-flock) share lock with second
+(sm-flock) exclusive lock on first conflicts
+(sm-flock) close second
+(sm-flock) lock first exclusively again
+(sm-flock) unlock first
+(sm-flock) bad operation
+(sm-flock) lock bad fd
+(sm-flock) close first
+(sm-flock) open "lockee" for verification
+(sm-flock) verified contents of "lockee"
+(sm-flock) close "lockee"
+(sm-flock) end
+EOF
+pass;
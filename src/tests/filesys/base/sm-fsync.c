@@ -0,0 +1,32 @@
+/* Writes a file, extends it, and syncs it with fsync and
+   fdatasync, then verifies the contents.  Also checks that
+   syncing a bad file descriptor fails. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+char buf[5678];
+
+void
+test_main (void) 
+{
+  const char *file_name = "synced";
+  int fd;
+  
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  random_bytes (buf, sizeof buf);
+  CHECK (write (fd, buf, sizeof buf / 2) == sizeof buf / 2,
+         "write first half of \"%s\"", file_name);
+  CHECK (fdatasync (fd) == 0, "fdatasync \"%s\"", file_name);
+  CHECK (write (fd, buf + sizeof buf / 2, sizeof buf - sizeof buf / 2)
+         == sizeof buf - sizeof buf / 2,
+         "write second half of \"%s\"", file_name);
+  CHECK (fsync (fd) == 0, "fsync \"%s\"", file_name);
+  CHECK (fsync (fd + 1) == -1, "fsync bad fd");
+  msg ("close \"%s\"", file_name);
+  close (fd);
+  check_file (file_name, buf, sizeof buf);
+}
@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(sm-fsync) begin
+(sm-fsync) create "synced"
+(sm-fsync) open "synced"
+(sm-fsync) write first half of "synced"
+(sm-fsync) fdatasync "synced"
+(sm-fsync) write second half of "synced"
+(sm-fsync) fsync "synced"
+(sm-fsync) fsync bad fd
+(sm-fsync) close "synced"
+(sm-fsync) open "synced" for verification
+(sm-fsync) verified contents of "synced"
+(sm-fsync) close "synced"
+(sm-fsync) end
+EOF
+pass;
@@ -0,0 +1,49 @@
+/* Writes a file out of order with pwrite, reads it back with
+   pread, and checks that neither moves the file position. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define BLOCK_SIZE 300
+#define BLOCK_CNT 7
+
+char buf[BLOCK_SIZE * BLOCK_CNT];
+char block[BLOCK_SIZE];
+
+void
+test_main (void) 
+{
+  const char *file_name = "positional";
+  size_t i;
+  int fd;
+  
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  random_bytes (buf, sizeof buf);
+
+  /* Write the blocks backward, so the first write extends the file. */
+  msg ("pwrite \"%s\" backward", file_name);
+  for (i = BLOCK_CNT; i-- > 0; )
+    if (pwrite (fd, buf + i * BLOCK_SIZE, BLOCK_SIZE, i * BLOCK_SIZE)
+        != BLOCK_SIZE)
+      fail ("pwrite of block %zu failed", i);
+  CHECK (tell (fd) == 0, "tell \"%s\" is still 0", file_name);
+
+  msg ("pread \"%s\" forward", file_name);
+  for (i = 0; i < BLOCK_CNT; i++)
+    {
+      if (pread (fd, block, BLOCK_SIZE, i * BLOCK_SIZE) != BLOCK_SIZE)
+        fail ("pread of block %zu failed", i);
+      compare_bytes (block, buf + i * BLOCK_SIZE, BLOCK_SIZE,
+                     i * BLOCK_SIZE, file_name);
+    }
+  CHECK (tell (fd) == 0, "tell \"%s\" is still 0", file_name);
+  CHECK (pread (fd, block, BLOCK_SIZE, sizeof buf) == 0,
+         "pread past end of \"%s\"", file_name);
+
+  msg ("close \"%s\"", file_name);
+  close (fd);
+  check_file (file_name, buf, sizeof buf);
+}
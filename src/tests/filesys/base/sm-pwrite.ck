@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(sm-pwrite) begin
+(sm-pwrite) create "positional"
+(sm-pwrite) open "positional"
+(sm-pwrite) pwrite "positional" backward
+(sm-pwrite) tell "positional" is still 0
+(sm-pwrite) pread "positional" forward
+(sm-pwrite) tell "positional" is still 0
+(sm-pwrite) pread past end of "positional"
+(sm-pwrite) close "positional"
+(sm-pwrite) open "positional" for verification
+(sm-pwrite) verified contents of "positional"
+(sm-pwrite) close "positional"
+(sm-pwrite) end
+EOF
+pass;
@@ -0,0 +1,57 @@
+/* Writes a file through a buffered stream with fprintf, reads it
+   back a line at a time with fgets, then seeks into the middle
+   of the buffered data and reads with fread. */
+
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define LINE_CNT 100
+
+char buf[LINE_CNT * 16];
+char line[64];
+
+void
+test_main (void) 
+{
+  const char *file_name = "lines";
+  size_t len = 0;
+  FILE *f;
+  int i;
+
+  for (i = 0; i < LINE_CNT; i++)
+    len += snprintf (buf + len, sizeof buf - len, "line %d\n", i);
+
+  CHECK ((f = fopen (file_name, "w")) != NULL,
+         "fopen \"%s\" for writing", file_name);
+  msg ("fprintf %d lines", LINE_CNT);
+  for (i = 0; i < LINE_CNT; i++)
+    fprintf (f, "line %d\n", i);
+  CHECK (ftell (f) == (long) len, "ftell \"%s\" is %zu", file_name, len);
+  CHECK (fclose (f) == 0, "fclose \"%s\"", file_name);
+  check_file (file_name, buf, len);
+
+  CHECK ((f = fopen (file_name, "r")) != NULL,
+         "fopen \"%s\" for reading", file_name);
+  msg ("fgets %d lines", LINE_CNT);
+  for (i = 0; i < LINE_CNT; i++)
+    {
+      char expected[16];
+
+      snprintf (expected, sizeof expected, "line %d\n", i);
+      if (fgets (line, sizeof line, f) == NULL)
+        fail ("fgets of line %d failed", i);
+      if (strcmp (line, expected))
+        fail ("line %d is \"%s\"", i, line);
+    }
+  CHECK (fgets (line, sizeof line, f) == NULL && feof (f),
+         "fgets at end of \"%s\"", file_name);
+
+  CHECK (fseek (f, 500, SEEK_SET) == 0 && ftell (f) == 500,
+         "fseek \"%s\" to 500", file_name);
+  CHECK (fread (line, 1, 50, f) == 50, "fread 50 bytes");
+  compare_bytes (line, buf + 500, 50, 500, file_name);
+  CHECK (fclose (f) == 0, "fclose \"%s\"", file_name);
+}
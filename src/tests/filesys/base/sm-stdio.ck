@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(sm-stdio) begin
+(sm-stdio) fopen "lines" for writing
+(sm-stdio) fprintf 100 lines
+(sm-stdio) ftell "lines" is 790
+(sm-stdio) fclose "lines"
+(sm-stdio) open "lines" for verification
+(sm-stdio) verified contents of "lines"
+(sm-stdio) close "lines"
+(sm-stdio) fopen "lines" for reading
+(sm-stdio) fgets 100 lines
+(sm-stdio) fgets at end of "lines"
+(sm-stdio) fseek "lines" to 500
+(sm-stdio) fread 50 bytes
+(sm-stdio) fclose "lines"
+(sm-stdio) end
+EOF
+pass;
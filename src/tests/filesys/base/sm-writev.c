@@ -0,0 +1,45 @@
+/* Writes a file from several buffers with one writev, then reads
+   it back into differently sized buffers with one readv. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+char buf[3000];
+char out[3000];
+
+void
+test_main (void) 
+{
+  const char *file_name = "vectored";
+  struct iovec iov[4];
+  int fd;
+  
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  random_bytes (buf, sizeof buf);
+
+  iov[0].iov_base = buf;
+  iov[0].iov_len = 100;
+  iov[1].iov_base = buf + 100;
+  iov[1].iov_len = 0;
+  iov[2].iov_base = buf + 100;
+  iov[2].iov_len = 1500;
+  iov[3].iov_base = buf + 1600;
+  iov[3].iov_len = sizeof buf - 1600;
+  CHECK (writev (fd, iov, 4) == sizeof buf, "writev \"%s\"", file_name);
+  CHECK (tell (fd) == sizeof buf, "tell \"%s\" after writev", file_name);
+
+  msg ("seek \"%s\" to 0", file_name);
+  seek (fd, 0);
+  iov[0].iov_base = out;
+  iov[0].iov_len = 1000;
+  iov[1].iov_base = out + 1000;
+  iov[1].iov_len = 2000;
+  CHECK (readv (fd, iov, 2) == sizeof out, "readv \"%s\"", file_name);
+  compare_bytes (out, buf, sizeof buf, 0, file_name);
+
+  msg ("close \"%s\"", file_name);
+  close (fd);
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(sm-writev) begin
+(sm-writev) create "vectored"
+(sm-writev) open "vectored"
+(sm-writev) writev "vectored"
+(sm-writev) tell "vectored" after writev
+(sm-writev) seek "vectored" to 0
+(sm-writev) readv "vectored"
+(sm-writev) close "vectored"
+(sm-writev) end
+EOF
+pass;
@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(syn-scale) begin
+(syn-scale) create "scale0"
+(syn-scale) create "scale1"
+(syn-scale) create "scale2"
+(syn-scale) create "scale3"
+(syn-scale) exec child 1 of 4: "child-syn-scale 0"
+(syn-scale) exec child 2 of 4: "child-syn-scale 1"
+(syn-scale) exec child 3 of 4: "child-syn-scale 2"
+(syn-scale) exec child 4 of 4: "child-syn-scale 3"
+(syn-scale) wait for child 1 of 4 returned 0 (expected 0)
+(syn-scale) wait for child 2 of 4 returned 1 (expected 1)
+(syn-scale) wait for child 3 of 4 returned 2 (expected 2)
+(syn-scale) wait for child 4 of 4 returned 3 (expected 3)
+(syn-scale) end
+EOF
+pass;
@@ -0,0 +1,9 @@
+#ifndef TESTS_FILESYS_BASE_SYN_SCALE_H
+#define TESTS_FILESYS_BASE_SYN_SCALE_H
+
+#define CHILD_CNT 4
+#define CHUNK_SIZE 512
+#define FILE_SIZE (16 * CHUNK_SIZE)
+#define READ_PASSES 32
+
+#endif /* tests/filesys/base/syn-scale.h */
@@ -0,0 +1,40 @@
+/* Creates a directory on a 64 MB file system, whose free map is
+   32 sectors long, then creates 40 files in that directory and
+   grows each of them to 6 kB, so that both the directory and the
+   files grow on a disk whose whole free map would not fit in one
+   journal transaction. */
+
+#include <syscall.h>
+#include <stdio.h>
+#include "tests/filesys/seq-test.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_CNT 40
+
+static char buf[6144];
+
+static size_t
+return_block_size (void) 
+{
+  return 1234;
+}
+
+void
+test_main (void) 
+{
+  size_t i;
+
+  CHECK (mkdir ("/x"), "mkdir /x");
+  for (i = 0; i < FILE_CNT; i++) 
+    {
+      char file_name[128];
+      snprintf (file_name, sizeof file_name, "/x/file%zu", i);
+
+      msg ("creating and checking \"%s\"", file_name);
+
+      quiet = true;
+      seq_test (file_name, buf, sizeof buf, 0, return_block_size, NULL);
+      quiet = false;
+    }
+}
@@ -0,0 +1,51 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::random;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(grow-big-disk) begin
+(grow-big-disk) mkdir /x
+(grow-big-disk) creating and checking "/x/file0"
+(grow-big-disk) creating and checking "/x/file1"
+(grow-big-disk) creating and checking "/x/file2"
+(grow-big-disk) creating and checking "/x/file3"
+(grow-big-disk) creating and checking "/x/file4"
+(grow-big-disk) creating and checking "/x/file5"
+(grow-big-disk) creating and checking "/x/file6"
+(grow-big-disk) creating and checking "/x/file7"
+(grow-big-disk) creating and checking "/x/file8"
+(grow-big-disk) creating and checking "/x/file9"
+(grow-big-disk) creating and checking "/x/file10"
+(grow-big-disk) creating and checking "/x/file11"
+(grow-big-disk) creating and checking "/x/file12"
+(grow-big-disk) creating and checking "/x/file13"
+(grow-big-disk) creating and checking "/x/file14"
+(grow-big-disk) creating and checking "/x/file15"
+(grow-big-disk) creating and checking "/x/file16"
+(grow-big-disk) creating and checking "/x/file17"
+(grow-big-disk) creating and checking "/x/file18"
+(grow-big-disk) creating and checking "/x/file19"
+(grow-big-disk) creating and checking "/x/file20"
+(grow-big-disk) creating and checking "/x/file21"
+(grow-big-disk) creating and checking "/x/file22"
+(grow-big-disk) creating and checking "/x/file23"
+(grow-big-disk) creating and checking "/x/file24"
+(grow-big-disk) creating and checking "/x/file25"
+(grow-big-disk) creating and checking "/x/file26"
+(grow-big-disk) creating and checking "/x/file27"
+(grow-big-disk) creating and checking "/x/file28"
+(grow-big-disk) creating and checking "/x/file29"
+(grow-big-disk) creating and checking "/x/file30"
+(grow-big-disk) creating and checking "/x/file31"
+(grow-big-disk) creating and checking "/x/file32"
+(grow-big-disk) creating and checking "/x/file33"
+(grow-big-disk) creating and checking "/x/file34"
+(grow-big-disk) creating and checking "/x/file35"
+(grow-big-disk) creating and checking "/x/file36"
+(grow-big-disk) creating and checking "/x/file37"
+(grow-big-disk) creating and checking "/x/file38"
+(grow-big-disk) creating and checking "/x/file39"
+(grow-big-disk) end
+EOF
+pass;
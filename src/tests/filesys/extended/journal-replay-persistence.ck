@@ -0,0 +1,9 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::random;
+my ($fs) = {'b' => [random_bytes (20480)]};
+$fs->{'keep'}{"file$_"} = [''] foreach grep ($_ % 2 == 0, 0...31);
+check_archive ($fs);
+pass;
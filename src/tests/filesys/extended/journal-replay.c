@@ -0,0 +1,81 @@
+/* Creates, removes and grows files and directories, has the journal
+   commit the changes with fsync, and halts with -crash-on-halt in
+   effect, so that nothing is written back and the next boot has to
+   replay the log.  The directory "/a" grows and is logged in one
+   transaction, then removed in the next, and its sectors are reused
+   for the data of "/b", so replaying the old images of "/a" over them
+   would corrupt "/b". */
+
+#include <random.h>
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_CNT 32
+
+static char buf[20480];
+
+/* Writes FILE_NAME, which so far is only in the buffer cache,
+   back to disk. */
+static void
+sync_file (const char *file_name) 
+{
+  int fd;
+
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  CHECK (fsync (fd) == 0, "fsync \"%s\"", file_name);
+  close (fd);
+}
+
+void
+test_main (void) 
+{
+  char file_name[32];
+  size_t i;
+  int fd;
+
+  /* halting skips writing back the programs too */
+  sync_file ("journal-replay");
+  sync_file ("tar");
+
+  CHECK (mkdir ("/a"), "mkdir \"/a\"");
+  CHECK (mkdir ("/keep"), "mkdir \"/keep\"");
+  msg ("create %d files each in \"/a\" and \"/keep\"", FILE_CNT);
+  quiet = true;
+  for (i = 0; i < FILE_CNT; i++) 
+    {
+      snprintf (file_name, sizeof file_name, "/a/file%zu", i);
+      CHECK (create (file_name, 0), "create \"%s\"", file_name);
+      snprintf (file_name, sizeof file_name, "/keep/file%zu", i);
+      CHECK (create (file_name, 0), "create \"%s\"", file_name);
+    }
+  quiet = false;
+  sync_file ("/keep/file0");
+
+  msg ("remove the files in \"/a\" and every other one in \"/keep\"");
+  quiet = true;
+  for (i = 0; i < FILE_CNT; i++) 
+    {
+      snprintf (file_name, sizeof file_name, "/a/file%zu", i);
+      CHECK (remove (file_name), "remove \"%s\"", file_name);
+      if (i % 2 == 1) 
+        {
+          snprintf (file_name, sizeof file_name, "/keep/file%zu", i);
+          CHECK (remove (file_name), "remove \"%s\"", file_name);
+        }
+    }
+  quiet = false;
+  CHECK (remove ("/a"), "remove \"/a\"");
+
+  random_init (0);
+  random_bytes (buf, sizeof buf);
+  CHECK (create ("/b", 0), "create \"/b\"");
+  CHECK ((fd = open ("/b")) > 1, "open \"/b\"");
+  CHECK (write (fd, buf, sizeof buf) == (int) sizeof buf, "write \"/b\"");
+  CHECK (fsync (fd) == 0, "fsync \"/b\"");
+
+  msg ("halt");
+  halt ();
+  fail ("should have halted");
+}
@@ -0,0 +1,24 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(journal-replay) begin
+(journal-replay) open "journal-replay"
+(journal-replay) fsync "journal-replay"
+(journal-replay) open "tar"
+(journal-replay) fsync "tar"
+(journal-replay) mkdir "/a"
+(journal-replay) mkdir "/keep"
+(journal-replay) create 32 files each in "/a" and "/keep"
+(journal-replay) open "/keep/file0"
+(journal-replay) fsync "/keep/file0"
+(journal-replay) remove the files in "/a" and every other one in "/keep"
+(journal-replay) remove "/a"
+(journal-replay) create "/b"
+(journal-replay) open "/b"
+(journal-replay) write "/b"
+(journal-replay) fsync "/b"
+(journal-replay) halt
+EOF
+pass;
@@ -0,0 +1,35 @@
+/* Executes a program, overwrites it with a different program,
+   and executes it again.  The second exec must run the new
+   program, not a copy of the old one kept from the first exec. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Copies the contents of file FROM over those of file TO. */
+static void
+copy (const char *from, const char *to)
+{
+  static char buf[1024];
+  int in, out, n;
+
+  if ((in = open (from)) < 2 || (out = open (to)) < 2)
+    fail ("open \"%s\" or \"%s\"", from, to);
+  while ((n = read (in, buf, sizeof buf)) > 0)
+    if (write (out, buf, n) != n)
+      fail ("write \"%s\"", to);
+  close (in);
+  close (out);
+}
+
+void
+test_main (void) 
+{
+  CHECK (create ("child-copy", 0), "create \"child-copy\"");
+
+  copy ("child-simple", "child-copy");
+  CHECK (wait (exec ("child-copy")) == 81, "exec \"child-copy\"");
+
+  copy ("child-args", "child-copy");
+  CHECK (wait (exec ("child-copy x")) == 0, "exec \"child-copy x\"");
+}
@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(exec-rewrite) begin
+(exec-rewrite) create "child-copy"
+(exec-rewrite) exec "child-copy"
+(child-simple) run
+child-copy: exit(81)
+(exec-rewrite) exec "child-copy x"
+(args) begin
+(args) argc = 2
+(args) argv[0] = 'child-copy'
+(args) argv[1] = 'x'
+(args) argv[2] = null
+(args) end
+child-copy: exit(0)
+(exec-rewrite) end
+exec-rewrite: exit(0)
+EOF
+pass;
@@ -0,0 +1,46 @@
+/* Forks a child, which checks that it sees the parent's memory and
+   open file as they were at the fork, then writes to its copy of a
+   global, a local variable and (through the read system call) a
+   buffer.  The parent then checks that its own memory is
+   unchanged, and that the file position the child advanced is
+   shared. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static int global = 1;
+static char buffer[16];
+
+void
+test_main (void)
+{
+  int local = 2;
+  int handle;
+  pid_t pid;
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+
+  pid = fork ();
+  if (pid == 0)
+    {
+      msg ("child: global = %d, local = %d", global, local);
+      global = 3;
+      local = 4;
+      if (read (handle, buffer, 5) != 5 || memcmp (buffer, sample, 5))
+        fail ("child read from shared file");
+      msg ("child: read from shared file");
+      exit (global + local);
+    }
+  if (pid < 0)
+    fail ("fork");
+
+  /* CHECK would print before the child is done */
+  if (wait (pid) != 7)
+    fail ("wait for child");
+  msg ("parent: global = %d, local = %d, buffer[0] = %d", global, local,
+       buffer[0]);
+  CHECK (tell (handle) == 5, "file position is shared");
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(fork-cow) begin
+(fork-cow) open "sample.txt"
+(fork-cow) child: global = 1, local = 2
+(fork-cow) child: read from shared file
+fork-cow: exit(7)
+(fork-cow) parent: global = 1, local = 2, buffer[0] = 0
+(fork-cow) file position is shared
+(fork-cow) end
+fork-cow: exit(0)
+EOF
+pass;
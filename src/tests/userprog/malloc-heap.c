@@ -0,0 +1,72 @@
+/* Grows and shrinks the heap with sbrk, then builds a linked list
+   with malloc, grows a big block with realloc, and checks that
+   freeing everything gives the heap pages back. */
+
+#include <malloc.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define NODE_CNT 1000
+
+struct node
+  {
+    struct node *next;
+    int value;
+    char pad[20];
+  };
+
+void
+test_main (void) 
+{
+  struct node *head = NULL, *n;
+  char *start, *p, *big;
+  int i;
+
+  start = sbrk (0);
+  CHECK (sbrk (PAGE_SIZE) == start, "sbrk one page");
+  memset (start, 0x5a, PAGE_SIZE);
+  CHECK (sbrk (-PAGE_SIZE) == start + PAGE_SIZE, "sbrk it back");
+  CHECK (sbrk (0) == start, "break is back where it started");
+  CHECK (sbrk (0x7fffffff) == (void *) -1, "sbrk into the stack fails");
+
+  for (i = 0; i < NODE_CNT; i++)
+    {
+      n = malloc (sizeof *n);
+      if (n == NULL)
+        fail ("malloc of node %d failed", i);
+      n->value = i;
+      memset (n->pad, i, sizeof n->pad);
+      n->next = head;
+      head = n;
+    }
+  msg ("malloc %d list nodes", NODE_CNT);
+  for (n = head, i = NODE_CNT; n != NULL; n = n->next)
+    {
+      i--;
+      if (n->value != i || n->pad[sizeof n->pad - 1] != (char) i)
+        fail ("node %d corrupted", i);
+    }
+  CHECK (i == 0, "walk list");
+
+  CHECK ((big = malloc (10000)) != NULL, "malloc 10000 bytes");
+  for (i = 0; i < 10000; i++)
+    big[i] = i;
+  CHECK ((big = realloc (big, 40000)) != NULL, "realloc to 40000 bytes");
+  for (i = 0; i < 10000; i++)
+    if (big[i] != (char) i)
+      fail ("byte %d lost by realloc", i);
+  CHECK ((p = calloc (100, 100)) != NULL && p[9999] == 0, "calloc");
+  free (p);
+  free (big);
+
+  while (head != NULL)
+    {
+      n = head->next;
+      free (head);
+      head = n;
+    }
+  CHECK ((char *) sbrk (0) < start + PAGE_SIZE, "free returns heap pages");
+}
@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(malloc-heap) begin
+(malloc-heap) sbrk one page
+(malloc-heap) sbrk it back
+(malloc-heap) break is back where it started
+(malloc-heap) sbrk into the stack fails
+(malloc-heap) malloc 1000 list nodes
+(malloc-heap) walk list
+(malloc-heap) malloc 10000 bytes
+(malloc-heap) realloc to 40000 bytes
+(malloc-heap) calloc
+(malloc-heap) free returns heap pages
+(malloc-heap) end
+malloc-heap: exit(0)
+EOF
+pass;
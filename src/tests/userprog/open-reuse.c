@@ -0,0 +1,39 @@
+/* Opens a file many times, so the descriptor table has to grow,
+   then checks that closed descriptors are reused lowest first. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define OPEN_CNT 100
+
+void
+test_main (void) 
+{
+  int fds[OPEN_CNT];
+  int i, fd;
+
+  for (i = 0; i < OPEN_CNT; i++)
+    {
+      fds[i] = open ("sample.txt");
+      if (fds[i] < 2)
+        fail ("open #%d of \"sample.txt\" returned %d", i, fds[i]);
+      if (i > 0 && fds[i] != fds[i - 1] + 1)
+        fail ("open #%d returned %d after %d", i, fds[i], fds[i - 1]);
+    }
+  msg ("open \"sample.txt\" %d times", OPEN_CNT);
+
+  close (fds[70]);
+  close (fds[30]);
+  CHECK ((fd = open ("sample.txt")) == fds[30],
+         "reopen takes lowest free fd");
+  CHECK ((fd = open ("sample.txt")) == fds[70],
+         "reopen takes next free fd");
+  CHECK ((fd = open ("sample.txt")) == fds[OPEN_CNT - 1] + 1,
+         "reopen with no free fd extends the table");
+  close (fd);
+
+  for (i = 0; i < OPEN_CNT; i++)
+    close (fds[i]);
+  CHECK (open ("sample.txt") == fds[0], "reopen after closing all");
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(open-reuse) begin
+(open-reuse) open "sample.txt" 100 times
+(open-reuse) reopen takes lowest free fd
+(open-reuse) reopen takes next free fd
+(open-reuse) reopen with no free fd extends the table
+(open-reuse) reopen after closing all
+(open-reuse) end
+open-reuse: exit(0)
+EOF
+pass;
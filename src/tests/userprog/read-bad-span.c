@@ -0,0 +1,20 @@
+/* Passes read a buffer that starts in valid memory but runs on
+   into unmapped pages.  The kernel must notice the bad pages
+   even though the first one is fine.
+   The process must be terminated with -1 exit code. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[64];
+
+void
+test_main (void) 
+{
+  int handle;
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+
+  read (handle, buf, 0x10000000);
+  fail ("should not have survived read()");
+}
@@ -0,0 +1,98 @@
+/* Writes the same records to two files, one write() call per
+   record and then through a submission ring with one ring_enter()
+   per RING_ENTRIES records, times both, and checks that the files
+   came out the same. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <syscall.h>
+#include <uring.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define RECORD_CNT 512
+#define RECORD_SIZE 8
+
+static char records[RECORD_CNT][RECORD_SIZE];
+static char buf[RECORD_CNT * RECORD_SIZE];
+static struct ring ring;
+
+/* Returns the CPU's time-stamp counter. */
+static inline uint64_t
+rdtsc (void) 
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Checks and consumes every completion in RING. */
+static void
+reap (void) 
+{
+  struct ring_cqe *cqe;
+
+  while ((cqe = ring_peek_cqe (&ring)) != NULL)
+    {
+      if (cqe->result != RECORD_SIZE)
+        fail ("ring write of record %u returned %d",
+              (unsigned) cqe->user_data, cqe->result);
+      ring_cqe_seen (&ring);
+    }
+}
+
+void
+test_main (void) 
+{
+  uint64_t start;
+  unsigned plain_cycles, ring_cycles;
+  int fd, i;
+
+  for (i = 0; i < RECORD_CNT; i++)
+    snprintf (records[i], RECORD_SIZE, "rec%04d", i);
+
+  CHECK (create ("plain", 0), "create \"plain\"");
+  CHECK ((fd = open ("plain")) > 1, "open \"plain\"");
+  start = rdtsc ();
+  for (i = 0; i < RECORD_CNT; i++)
+    if (write (fd, records[i], RECORD_SIZE) != RECORD_SIZE)
+      fail ("write of record %d failed", i);
+  plain_cycles = rdtsc () - start;
+  close (fd);
+
+  CHECK (create ("ring", 0), "create \"ring\"");
+  CHECK ((fd = open ("ring")) > 1, "open \"ring\"");
+  ring_init (&ring);
+  start = rdtsc ();
+  for (i = 0; i < RECORD_CNT; i++)
+    {
+      ring_queue (&ring, RING_OP_WRITE, fd, records[i], RECORD_SIZE, i);
+      if (ring.sq_tail - ring.sq_head == RING_ENTRIES)
+        {
+          if (ring_submit (&ring) != RING_ENTRIES)
+            fail ("ring_enter did not take a full queue");
+          reap ();
+        }
+    }
+  ring_cycles = rdtsc () - start;
+  if (ring.sq_head != ring.sq_tail)
+    fail ("submissions left over");
+  close (fd);
+
+  msg ("write: %u cycles per record", plain_cycles / RECORD_CNT);
+  msg ("ring: %u cycles per record", ring_cycles / RECORD_CNT);
+
+  /* read the second file back through the ring as well */
+  ring_init (&ring);
+  ring_queue (&ring, RING_OP_OPEN, 0, "ring", 0, 0);
+  CHECK (ring_submit (&ring) == 1, "open \"ring\" through ring");
+  CHECK ((fd = ring_peek_cqe (&ring)->result) > 1, "ring open returned fd");
+  ring_cqe_seen (&ring);
+  ring_queue (&ring, RING_OP_READ, fd, buf, sizeof buf, 1);
+  ring_queue (&ring, RING_OP_CLOSE, fd, NULL, 0, 2);
+  CHECK (ring_submit (&ring) == 2, "read and close through ring");
+  CHECK (ring_peek_cqe (&ring)->result == (int) sizeof buf,
+         "read returned %d bytes", (int) sizeof buf);
+  compare_bytes (buf, records, sizeof buf, 0, "ring");
+  check_file ("plain", records, sizeof records);
+}
@@ -0,0 +1,31 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+
+# Timings vary from run to run.
+s/: \d+ cycles per record$/: N cycles per record/ foreach @output;
+
+compare_output ("run", \@output, [<<'EOF']);
+(ring-write) begin
+(ring-write) create "plain"
+(ring-write) open "plain"
+(ring-write) create "ring"
+(ring-write) open "ring"
+(ring-write) write: N cycles per record
+(ring-write) ring: N cycles per record
+(ring-write) open "ring" through ring
+(ring-write) ring open returned fd
+(ring-write) read and close through ring
+(ring-write) read returned 4096 bytes
+(ring-write) open "plain" for verification
+(ring-write) verified contents of "plain"
+(ring-write) close "plain"
+(ring-write) end
+ring-write: exit(0)
+EOF
+pass;
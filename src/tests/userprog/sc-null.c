@@ -0,0 +1,48 @@
+/* Times a round trip into the kernel and back with a system call
+   that does no work, first through `int $0x30' and then through
+   sysenter if the CPU supports it. */
+
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define CALL_CNT 1000
+
+/* Returns the CPU's time-stamp counter. */
+static inline uint64_t
+rdtsc (void) 
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Makes CALL_CNT calls to tell() on a file descriptor that is not
+   open, which the kernel rejects without doing anything else, and
+   returns the average number of cycles per call. */
+static unsigned
+time_null_syscall (void) 
+{
+  uint64_t start;
+  int i;
+
+  tell (-1);
+  start = rdtsc ();
+  for (i = 0; i < CALL_CNT; i++)
+    if (tell (-1) != (unsigned) -1)
+      fail ("tell on bad fd did not fail");
+  return (rdtsc () - start) / CALL_CNT;
+}
+
+void
+test_main (void) 
+{
+  syscall_set_sysenter (false);
+  msg ("int $0x30: %u cycles per call", time_null_syscall ());
+
+  if (syscall_set_sysenter (true))
+    msg ("sysenter: %u cycles per call", time_null_syscall ());
+  else
+    msg ("sysenter: not supported");
+}
@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "missing int \$0x30 timing in output"
+  unless grep (/^\(sc-null\) int \$0x30: \d+ cycles per call$/, @output);
+fail "missing sysenter timing in output"
+  unless grep (/^\(sc-null\) sysenter: (\d+ cycles per call|not supported)$/,
+	       @output);
+fail "missing end in output"
+  unless grep ($_ eq '(sc-null) end', @output);
+
+pass;
@@ -0,0 +1,59 @@
+/* Writes a known number of data pages, waits for the heat sampler
+   to take a sample after that, and checks the working set and the
+   counts of each region that heatmap() reports.  Must be run with
+   -heat.  The kernel prints the final heat map when the process
+   exits, which heat-map.ck checks too. */
+
+#include <heat.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGE_CNT 32
+
+static char buf[PAGE_CNT * PAGE_SIZE];
+
+/* Waits for the next sample of this process's memory and stores it
+   into *H. */
+static void
+next_sample (struct heatmap *h)
+{
+  unsigned samples;
+
+  if (heatmap (h) != 0)
+    fail ("heatmap failed; is the kernel running with -heat?");
+  samples = h->samples;
+  while (h->samples == samples)
+    heatmap (h);
+}
+
+void
+test_main (void)
+{
+  struct heatmap h;
+  struct heat_counts *c;
+  size_t i;
+
+  for (i = 0; i < PAGE_CNT; i++)
+    buf[i * PAGE_SIZE] = i;
+  next_sample (&h);
+
+  CHECK (h.working_set >= PAGE_CNT, "working set covers the pages written");
+  CHECK (h.peak_working_set >= h.working_set, "peak is at least current");
+
+  c = &h.regions[HEAT_DATA];
+  CHECK (c->hot + c->warm >= PAGE_CNT, "data pages written are hot or warm");
+  CHECK (c->written >= PAGE_CNT, "data pages written are counted written");
+
+  c = &h.regions[HEAT_CODE];
+  CHECK (c->hot + c->warm + c->cold + c->absent > 0, "code pages counted");
+  CHECK (c->written == 0, "no code pages written");
+
+  c = &h.regions[HEAT_STACK];
+  CHECK (c->hot + c->warm >= 1, "stack is in use");
+
+  c = &h.regions[HEAT_MMAP];
+  CHECK (c->hot + c->warm + c->cold + c->absent + c->written == 0,
+         "nothing mapped");
+}
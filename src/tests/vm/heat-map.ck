@@ -0,0 +1,36 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+
+# Heat varies from run to run, except that code is never written and
+# nothing is mapped.
+foreach (@output) {
+    s/^(heat: heat-map:) \d+ samples, working set \d+ pages, peak \d+ pages$/$1 N samples, working set N pages, peak N pages/;
+    s/^(heat: heat-map: (?:code |data |stack)) +\d+ hot +\d+ warm +\d+ cold +\d+ absent/$1 N hot N warm N cold N absent/;
+    s/^(heat: heat-map: (?:data |stack) .* absent) +\d+ written$/$1 N written/;
+}
+
+compare_output ("run", \@output, [<<'EOF']);
+(heat-map) begin
+(heat-map) working set covers the pages written
+(heat-map) peak is at least current
+(heat-map) data pages written are hot or warm
+(heat-map) data pages written are counted written
+(heat-map) code pages counted
+(heat-map) no code pages written
+(heat-map) stack is in use
+(heat-map) nothing mapped
+(heat-map) end
+heat-map: exit(0)
+heat: heat-map: N samples, working set N pages, peak N pages
+heat: heat-map: code  N hot N warm N cold N absent     0 written
+heat: heat-map: data  N hot N warm N cold N absent N written
+heat: heat-map: stack N hot N warm N cold N absent N written
+heat: heat-map: mmap      0 hot     0 warm     0 cold     0 absent     0 written
+EOF
+pass;
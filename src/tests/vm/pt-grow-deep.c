@@ -0,0 +1,35 @@
+/* Recurses 512 levels with a 1 kB array in each frame, growing the
+   stack by about 512 kB, a quarter page or so per call, and checks
+   that every frame kept its contents.
+   This must succeed. */
+
+#include <string.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define DEPTH 512
+
+static int
+recurse (int depth)
+{
+  char frame[1024];
+  int sum;
+  size_t i;
+
+  memset (frame, depth, sizeof frame);
+  sum = depth > 0 ? recurse (depth - 1) : 0;
+  for (i = 0; i < sizeof frame; i++)
+    if (frame[i] != (char) depth)
+      fail ("frame at depth %d corrupted", depth);
+  return sum + depth;
+}
+
+void
+test_main (void)
+{
+  int sum = recurse (DEPTH);
+
+  if (sum != DEPTH * (DEPTH + 1) / 2)
+    fail ("sum is %d, not %d", sum, DEPTH * (DEPTH + 1) / 2);
+  msg ("recursed %d levels", DEPTH);
+}
@@ -24,7 +24,9 @@
 #include <string.h>
 #ifdef USERPROG
 #include "userprog/exception.h"
+#include "userprog/exec-cache.h"
 #include "userprog/gdt.h"
+#include "userprog/pagedir.h"
 #include "userprog/process.h"
 #include "userprog/syscall.h"
 #include "userprog/tss.h"
@@ -37,6 +39,15 @@
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
 #endif
+#ifdef VM
+#include "vm/frame.h"
+#include "vm/heat.h"
+#include "vm/swap.h"
+#endif
+
+/* Page size extension: CPUID(1).EDX bit and CR4 enable bit. */
+#define CPUID_PSE (1u << 3)
+#define CR4_PSE 0x00000010
 
 /* Page directory with kernel mappings only. */
 uint32_t *init_page_dir;
@@ -57,6 +68,12 @@ static const char *swap_bdev_name;
 /* -ul: Maximum number of pages to put into palloc's user pool. */
 static size_t user_page_limit = SIZE_MAX;
 
+#ifdef VM
+/* -heat: Milliseconds between samples of user memory heat, or 0 to
+   not sample. */
+static unsigned heat_interval;
+#endif
+
 static void bss_init (void);
 static void paging_init (void);
 
@@ -98,6 +115,12 @@ main (void)
   palloc_init (user_page_limit);
   malloc_init ();
   paging_init ();
+#ifdef USERPROG
+  pagedir_init ();
+#endif
+#ifdef VM
+  frame_init ();
+#endif
 
   /* Segmentation. */
 #ifdef USERPROG
@@ -113,18 +136,25 @@ main (void)
 #ifdef USERPROG
   exception_init ();
   syscall_init ();
+  exec_cache_init ();
 #endif
 
   /* Start thread scheduler and enable interrupts. */
   thread_start ();
   serial_init_queue ();
   timer_calibrate ();
+#ifdef VM
+  heat_init (heat_interval);
+#endif
 
 #ifdef FILESYS
   /* Initialize file system. */
   ide_init ();
   locate_block_devices ();
   filesys_init (format_filesys);
+#ifdef VM
+  swap_init ();
+#endif
 #endif
 
   printf ("Boot complete.\n");
@@ -150,16 +180,33 @@ bss_init (void)
   memset (&_start_bss, 0, &_end_bss - &_start_bss);
 }
 
+/* Returns true if the CPU has the page size extension, which
+   lets a page directory entry map a 4 MB page. */
+static bool
+cpu_has_pse (void)
+{
+  uint32_t eax, ebx, ecx, edx;
+
+  asm("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(1));
+  return (edx & CPUID_PSE) != 0;
+}
+
 /* Populates the base page directory and page table with the
    kernel virtual mapping, and then sets up the CPU to use the
    new page directory.  Points init_page_dir to the page
-   directory it creates. */
+   directory it creates.
+
+   If the CPU can, each 4 MB of physical memory that does not hold
+   kernel text is mapped with a single large page, which needs no
+   page table and takes one TLB entry instead of 1,024.  The rest
+   is mapped with 4 kB pages so that kernel text stays read-only. */
 static void
 paging_init (void)
 {
   uint32_t *pd, *pt;
   size_t page;
   extern char _start, _end_kernel_text;
+  bool pse = cpu_has_pse ();
 
   pd = init_page_dir = palloc_get_page (PAL_ASSERT | PAL_ZERO);
   pt = NULL;
@@ -171,6 +218,14 @@ paging_init (void)
       size_t pte_idx = pt_no (vaddr);
       bool in_kernel_text = &_start <= vaddr && vaddr < &_end_kernel_text;
 
+      if (pse && pte_idx == 0 && page + PTSPAN / PGSIZE <= init_ram_pages
+          && (vaddr + PTSPAN <= &_start || vaddr >= &_end_kernel_text))
+        {
+          pd[pde_idx] = pde_create_large (vaddr, true);
+          page += PTSPAN / PGSIZE - 1;
+          continue;
+        }
+
       if (pd[pde_idx] == 0)
         {
           pt = palloc_get_page (PAL_ASSERT | PAL_ZERO);
@@ -180,6 +235,15 @@ paging_init (void)
       pt[pte_idx] = pte_create_kernel (vaddr, !in_kernel_text);
     }
 
+  /* Large pages need CR4.PSE before the CPU walks the new page
+     directory. */
+  if (pse)
+    {
+      uint32_t cr4;
+      asm volatile("movl %%cr4, %0" : "=r"(cr4));
+      asm volatile("movl %0, %%cr4" : : "r"(cr4 | CR4_PSE));
+    }
+
   /* Store the physical address of the page directory into CR3
      aka PDBR (page directory base register).  This activates our
      new page tables immediately.  See [IA32-v2a] "MOV--Move
@@ -259,6 +323,14 @@ parse_options (char **argv)
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
+      else if (!strcmp (name, "-crash-on-halt"))
+        halt_crashes = true;
+#endif
+#ifdef VM
+      else if (!strcmp (name, "-stack"))
+        stack_limit = (size_t)atoi (value) * 1024;
+      else if (!strcmp (name, "-heat"))
+        heat_interval = value != NULL ? atoi (value) : 100;
 #endif
       else
         PANIC ("unknown option `%s' (use -h for help)", name);
@@ -379,6 +451,11 @@ usage (void)
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
+          "  -crash-on-halt     Make halt skip writing back the file system.\n"
+#endif
+#ifdef VM
+          "  -stack=KB          Limit user stacks to KB kB.\n"
+          "  -heat[=MS]         Sample user memory heat every MS ms (100).\n"
 #endif
   );
   shutdown_power_off ();
@@ -2,13 +2,14 @@
 #include <bitmap.h>
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/interrupt.h"
 #include "threads/loader.h"
-#include "threads/synch.h"
 #include "threads/vaddr.h"
 
 /* Page allocator.  Hands out memory in page-size (or
@@ -23,14 +24,60 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   kernel pool, but that's just fine for demonstration purposes.
 
-/* A memory pool. */
+   Within a pool, free pages are kept by a binary buddy allocator:
+   a free block of 2**K pages, starting at a page index that is a
+   multiple of 2**K, is kept on the pool's list for order K, so
+   finding and freeing a block takes time logarithmic in the size
+   of the pool.  A request for N pages takes the smallest block of
+   at least N pages, splitting a larger one if need be, and gives
+   back what it doesn't need; freed pages merge with their free
+   buddies into ever larger blocks.  The lists are linked through
+   the free pages themselves.  The pool's bitmap of used pages is
+   still kept up to date, to check the lists against.
+
+   Each pool also keeps a few free pages zeroed ahead of time by
+   the idle thread (see palloc_prezero()), so that a request for a
+   single zeroed page needn't clear one.  Those pages are marked
+   used in the pool's bitmap and kept on a list linked through
+   their first word, which is cleared again when one is handed
+   out.  They go back to the bitmap when the pool runs out of
+   other free pages. */
+
+/* Most pages each pool keeps zeroed ahead of time. */
+#define PREZERO_MAX 64
+
+/* Number of block sizes, from 1 page up to 2**(PALLOC_ORDERS - 1)
+   pages, more than a pool can hold. */
+#define PALLOC_ORDERS 20
+
+/* A memory pool.
+
+   Pages are freed with interrupts off in thread_schedule_tail(),
+   where we cannot wait for a lock, so everything but the
+   statistics is protected by disabling interrupts instead.  No
+   operation keeps them off for more than a few steps per order. */
 struct pool
   {
-    struct lock lock;                   /* Mutual exclusion. */
+    const char *name;                   /* Name, for statistics. */
+    struct list free_lists[PALLOC_ORDERS]; /* Free blocks, by order. */
+    uint8_t *free_order;                /* Per page: 1 + order if it
+                                           starts a free block,
+                                           otherwise 0. */
     struct bitmap *used_map;            /* Bitmap of free pages. */
     uint8_t *base;                      /* Base of pool. */
+    size_t free_cnt;                    /* Number of free pages. */
+
+    /* Statistics. */
+    unsigned long long splits;          /* Blocks split in two. */
+    unsigned long long merges;          /* Buddies merged. */
+    unsigned long long failures;        /* Requests that failed. */
+
+    /* Pages zeroed ahead of time. */
+    void **zeroed;                      /* List of zeroed pages. */
+    size_t zeroed_cnt;                  /* Number of pages in list. */
+    size_t zeroed_max;                  /* Most pages to keep. */
   };
 
 /* Two pools: one for kernel data, one for user pages. */
@@ -39,6 +86,10 @@ static struct pool kernel_pool, user_pool;
 static void init_pool (struct pool *, void *base, size_t page_cnt,
                        const char *name);
 static bool page_from_pool (const struct pool *, void *page);
+static size_t alloc_pages (struct pool *, size_t page_cnt);
+static void free_pages (struct pool *, size_t page_idx, size_t page_cnt);
+static void *take_zeroed (struct pool *);
+static bool reclaim_zeroed (struct pool *);
 
 /* Initializes the page allocator.  At most USER_PAGE_LIMIT
    pages are put into the user pool. */
@@ -71,15 +122,27 @@ void *
 palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
 {
   struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+  enum intr_level old_level;
   void *pages;
   size_t page_idx;
 
   if (page_cnt == 0)
     return NULL;
 
-  lock_acquire (&pool->lock);
-  page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
-  lock_release (&pool->lock);
+  if (page_cnt == 1 && (flags & PAL_ZERO))
+    {
+      pages = take_zeroed (pool);
+      if (pages != NULL)
+        return pages;
+    }
+
+  old_level = intr_disable ();
+  page_idx = alloc_pages (pool, page_cnt);
+  if (page_idx == BITMAP_ERROR && reclaim_zeroed (pool))
+    page_idx = alloc_pages (pool, page_cnt);
+  if (page_idx == BITMAP_ERROR)
+    pool->failures++;
+  intr_set_level (old_level);
 
   if (page_idx != BITMAP_ERROR)
     pages = pool->base + PGSIZE * page_idx;
@@ -118,6 +181,7 @@ void
 palloc_free_multiple (void *pages, size_t page_cnt) 
 {
   struct pool *pool;
+  enum intr_level old_level;
   size_t page_idx;
 
   ASSERT (pg_ofs (pages) == 0);
@@ -137,8 +201,9 @@ palloc_free_multiple (void *pages, size_t page_cnt)
   memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
 
-  ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
-  bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+  old_level = intr_disable ();
+  free_pages (pool, page_idx, page_cnt);
+  intr_set_level (old_level);
 }
 
 /* Frees the page at PAGE. */
@@ -148,25 +213,278 @@ palloc_free_page (void *page)
   palloc_free_multiple (page, 1);
 }
 
+/* Zeroes a free page ahead of time for a pool that has fewer than
+   it may keep.  Returns true if a page was zeroed, false if there
+   was nothing to do.  Called by the idle thread. */
+bool
+palloc_prezero (void) 
+{
+  struct pool *pools[] = { &kernel_pool, &user_pool };
+  size_t i;
+
+  for (i = 0; i < sizeof pools / sizeof *pools; i++)
+    {
+      struct pool *pool = pools[i];
+      enum intr_level old_level;
+      size_t page_idx;
+      void **page;
+
+      if (pool->zeroed_cnt >= pool->zeroed_max)
+        continue;
+      old_level = intr_disable ();
+      page_idx = alloc_pages (pool, 1);
+      intr_set_level (old_level);
+      if (page_idx == BITMAP_ERROR)
+        continue;
+
+      page = (void **) (pool->base + PGSIZE * page_idx);
+      memset (page, 0, PGSIZE);
+
+      old_level = intr_disable ();
+      *page = pool->zeroed;
+      pool->zeroed = page;
+      pool->zeroed_cnt++;
+      intr_set_level (old_level);
+      return true;
+    }
+  return false;
+}
+
+/* Removes and returns one of POOL's pages zeroed ahead of time, or
+   a null pointer if it has none. */
+static void *
+take_zeroed (struct pool *pool) 
+{
+  enum intr_level old_level;
+  void **page;
+
+  old_level = intr_disable ();
+  page = pool->zeroed;
+  if (page != NULL)
+    {
+      pool->zeroed = *page;
+      pool->zeroed_cnt--;
+    }
+  intr_set_level (old_level);
+
+  if (page != NULL)
+    *page = NULL;
+  return page;
+}
+
+/* Returns all of POOL's pages zeroed ahead of time to its free
+   pages, for an allocation that found no other free pages.  Returns
+   true if there were any.  Interrupts must be off. */
+static bool
+reclaim_zeroed (struct pool *pool) 
+{
+  bool reclaimed = false;
+  void *page;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  while ((page = take_zeroed (pool)) != NULL)
+    {
+      free_pages (pool, pg_no (page) - pg_no (pool->base), 1);
+      reclaimed = true;
+    }
+  return reclaimed;
+}
+
+/* Prints statistics about the free blocks of each pool. */
+void
+palloc_print_stats (void) 
+{
+  struct pool *pools[] = { &kernel_pool, &user_pool };
+  size_t i;
+
+  for (i = 0; i < sizeof pools / sizeof *pools; i++)
+    {
+      struct pool *pool = pools[i];
+      enum intr_level old_level;
+      size_t free_cnt, block_cnt = 0, largest = 0;
+      int order;
+
+      old_level = intr_disable ();
+      free_cnt = pool->free_cnt;
+      for (order = 0; order < PALLOC_ORDERS; order++)
+        {
+          size_t cnt = list_size (&pool->free_lists[order]);
+          block_cnt += cnt;
+          if (cnt > 0)
+            largest = (size_t) 1 << order;
+        }
+      intr_set_level (old_level);
+
+      printf ("Palloc: %s: %zu of %zu pages free in %zu blocks, "
+              "largest %zu pages (%zu%% fragmented)\n",
+              pool->name, free_cnt, bitmap_size (pool->used_map),
+              block_cnt, largest,
+              free_cnt > 0 ? 100 - largest * 100 / free_cnt : 0);
+      printf ("Palloc: %s: %llu splits, %llu merges, %llu failures\n",
+              pool->name, pool->splits, pool->merges, pool->failures);
+    }
+}
+
+/* Returns the first page of the free block that starts with
+   ELEM. */
+static size_t
+block_idx (const struct pool *pool, struct list_elem *elem) 
+{
+  return pg_no (elem) - pg_no (pool->base);
+}
+
+/* Returns the list element at the start of the block that starts
+   at PAGE_IDX. */
+static struct list_elem *
+block_elem (const struct pool *pool, size_t page_idx) 
+{
+  return (struct list_elem *) (pool->base + PGSIZE * page_idx);
+}
+
+/* Puts the free block of 2**ORDER pages at PAGE_IDX on POOL's list
+   for ORDER. */
+static void
+push_block (struct pool *pool, size_t page_idx, int order) 
+{
+  pool->free_order[page_idx] = order + 1;
+  list_push_front (&pool->free_lists[order], block_elem (pool, page_idx));
+}
+
+/* Removes the free block at PAGE_IDX from its list. */
+static void
+remove_block (struct pool *pool, size_t page_idx) 
+{
+  ASSERT (pool->free_order[page_idx] != 0);
+
+  list_remove (block_elem (pool, page_idx));
+  pool->free_order[page_idx] = 0;
+}
+
+/* Frees the block of 2**ORDER pages at PAGE_IDX, merging it with
+   its buddy for as long as the buddy is free too. */
+static void
+free_block (struct pool *pool, size_t page_idx, int order) 
+{
+  size_t pool_size = bitmap_size (pool->used_map);
+
+  while (order + 1 < PALLOC_ORDERS)
+    {
+      size_t size = (size_t) 1 << order;
+      size_t buddy_idx = page_idx ^ size;
+
+      if (buddy_idx + size > pool_size
+          || pool->free_order[buddy_idx] != order + 1)
+        break;
+      remove_block (pool, buddy_idx);
+      page_idx &= ~size;
+      order++;
+      pool->merges++;
+    }
+  push_block (pool, page_idx, order);
+}
+
+/* Frees the PAGE_CNT pages at PAGE_IDX, as the largest blocks their
+   alignment allows. */
+static void
+free_range (struct pool *pool, size_t page_idx, size_t page_cnt) 
+{
+  while (page_cnt > 0)
+    {
+      int order = 0;
+
+      while (order + 1 < PALLOC_ORDERS
+             && page_idx % ((size_t) 2 << order) == 0
+             && ((size_t) 2 << order) <= page_cnt)
+        order++;
+      free_block (pool, page_idx, order);
+      page_idx += (size_t) 1 << order;
+      page_cnt -= (size_t) 1 << order;
+    }
+}
+
+/* Allocates PAGE_CNT contiguous pages from POOL and returns the
+   index of the first, or BITMAP_ERROR if no free block is large
+   enough.  Interrupts must be off. */
+static size_t
+alloc_pages (struct pool *pool, size_t page_cnt) 
+{
+  int want, order;
+  size_t page_idx;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  /* find the smallest free block that is big enough */
+  for (want = 0; ((size_t) 1 << want) < page_cnt; want++)
+    if (want + 1 >= PALLOC_ORDERS)
+      return BITMAP_ERROR;
+  for (order = want; order < PALLOC_ORDERS; order++)
+    if (!list_empty (&pool->free_lists[order]))
+      break;
+  if (order >= PALLOC_ORDERS)
+    return BITMAP_ERROR;
+
+  page_idx = block_idx (pool, list_front (&pool->free_lists[order]));
+  remove_block (pool, page_idx);
+
+  /* split it down to size, then give back the pages past the end */
+  while (order > want)
+    {
+      order--;
+      push_block (pool, page_idx + ((size_t) 1 << order), order);
+      pool->splits++;
+    }
+  free_range (pool, page_idx + page_cnt, ((size_t) 1 << want) - page_cnt);
+
+  ASSERT (bitmap_none (pool->used_map, page_idx, page_cnt));
+  bitmap_set_multiple (pool->used_map, page_idx, page_cnt, true);
+  pool->free_cnt -= page_cnt;
+  return page_idx;
+}
+
+/* Frees the PAGE_CNT pages at PAGE_IDX in POOL.  Interrupts must be
+   off. */
+static void
+free_pages (struct pool *pool, size_t page_idx, size_t page_cnt) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
+
+  bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+  pool->free_cnt += page_cnt;
+  free_range (pool, page_idx, page_cnt);
+}
+
 /* Initializes pool P as starting at START and ending at END,
    naming it NAME for debugging purposes. */
 static void
 init_pool (struct pool *p, void *base, size_t page_cnt, const char *name) 
 {
-  /* We'll put the pool's used_map at its base.
-     Calculate the space needed for the bitmap
+  /* We'll put the pool's used_map at its base, followed by
+     free_order.  Calculate the space needed for them
      and subtract it from the pool's size. */
-  size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (page_cnt), PGSIZE);
+  size_t bm_size = bitmap_buf_size (page_cnt);
+  size_t bm_pages = DIV_ROUND_UP (bm_size + page_cnt, PGSIZE);
+  int order;
   if (bm_pages > page_cnt)
     PANIC ("Not enough memory in %s for bitmap.", name);
   page_cnt -= bm_pages;
 
   printf ("%zu pages available in %s.\n", page_cnt, name);
 
-  /* Initialize the pool. */
-  lock_init (&p->lock);
-  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_pages * PGSIZE);
+  /* Initialize the pool, with all its pages free. */
+  p->name = name;
+  for (order = 0; order < PALLOC_ORDERS; order++)
+    list_init (&p->free_lists[order]);
+  p->free_order = (uint8_t *) base + bm_size;
+  memset (p->free_order, 0, page_cnt);
+  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_size);
   p->base = base + bm_pages * PGSIZE;
+  p->free_cnt = page_cnt;
+  free_range (p, 0, page_cnt);
+  p->zeroed = NULL;
+  p->zeroed_cnt = 0;
+  p->zeroed_max = page_cnt / 16 < PREZERO_MAX ? page_cnt / 16 : PREZERO_MAX;
 }
 
 /* Returns true if PAGE was allocated from POOL,
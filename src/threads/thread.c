@@ -2,6 +2,7 @@
 #include "threads/flags.h"
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/switch.h"
 #include "threads/synch.h"
@@ -401,6 +402,11 @@ idle (void *idle_started_ UNUSED)
 
   for (;;)
     {
+      /* Zero pages for palloc ahead of time while nobody else
+         wants the CPU. */
+      while (list_empty (&ready_list) && palloc_prezero ())
+        continue;
+
       /* Let someone else run. */
       intr_disable ();
       thread_block ();
@@ -474,8 +480,12 @@ init_thread (struct thread *t, const char *name, int priority)
   t->parent = NULL;
   list_init (&t->children);
   lock_init (&t->children_lock);
-  list_init (&t->open_files);
-  t->cur_fd = 2;
+  t->fds = NULL;
+  t->fd_cnt = 0;
+  t->fd_free = FD_MIN;
+#ifdef VM
+  list_init (&t->mappings);
+#endif
 
   old_level = intr_disable ();
   list_push_back (&all_list, &t->allelem);
@@ -627,40 +637,74 @@ find_thread (tid_t id)
   return t;
 }
 
-/* Finds an open file within the provided thread's children with the
-   provided file descriptor. */
+/* Finds the open file with the provided file descriptor in the provided
+   thread's descriptor table.  Returns NULL if FD is not open. */
 struct open_file *
 find_open_file (int fd, struct thread *cur)
 {
-  struct open_file *of;
-  struct open_file *found;
-  struct list_elem *e;
-  for (e = list_begin (&cur->open_files); e != list_end (&cur->open_files);
-       e = list_next (e))
+  if (fd < FD_MIN || fd >= cur->fd_cnt)
+    return NULL;
+  return cur->fds[fd];
+}
+
+/* Installs OF in the provided thread's descriptor table under the lowest
+   unused file descriptor, growing the table if it is full, and returns
+   the descriptor.  Returns -1 if the table cannot grow. */
+int
+add_open_file (struct open_file *of, struct thread *cur)
+{
+  int fd = cur->fd_free;
+
+  while (fd < cur->fd_cnt && cur->fds[fd] != NULL)
+    fd++;
+
+  if (fd >= cur->fd_cnt)
     {
-      of = list_entry (e, struct open_file, elem);
-      if (of->fd == fd)
-        {
-          found = of;
-          break;
-        }
+      /* double the table */
+      int new_cnt = cur->fd_cnt > 0 ? cur->fd_cnt * 2 : FD_TABLE_INIT;
+      struct open_file **fds = realloc (cur->fds, new_cnt * sizeof *fds);
+      if (fds == NULL)
+        return -1;
+      for (int i = cur->fd_cnt; i < new_cnt; i++)
+        fds[i] = NULL;
+      cur->fds = fds;
+      cur->fd_cnt = new_cnt;
     }
-  return found;
+
+  of->fd = fd;
+  cur->fds[fd] = of;
+  cur->fd_free = fd + 1;
+  return fd;
 }
 
-/* Close all open files for the provided thread. */
-void
-close_all_open_files (struct thread *cur)
+/* Removes the file with the provided file descriptor from the provided
+   thread's descriptor table and returns it, so the descriptor can be
+   reused.  Returns NULL if FD is not open. */
+struct open_file *
+remove_open_file (int fd, struct thread *cur)
 {
-  struct open_file *of;
-  struct list_elem *e;
-  for (e = list_begin (&cur->open_files); e != list_end (&cur->open_files);
-       e = list_next (e))
+  struct open_file *of = find_open_file (fd, cur);
+
+  if (of != NULL)
     {
-      of = list_entry (e, struct open_file, elem);
-      close (of->fd);
-      list_remove (e);
+      cur->fds[fd] = NULL;
+      if (fd < cur->fd_free)
+        cur->fd_free = fd;
     }
+  return of;
+}
+
+/* Close all open files for the provided thread and free its descriptor
+   table. */
+void
+close_all_open_files (struct thread *cur)
+{
+  for (int fd = FD_MIN; fd < cur->fd_cnt; fd++)
+    if (cur->fds[fd] != NULL)
+      close (fd);
+  free (cur->fds);
+  cur->fds = NULL;
+  cur->fd_cnt = 0;
 }
 
 /* Removes all children of the provided thread. Called within syscall.c exit
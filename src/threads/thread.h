@@ -4,6 +4,7 @@
 #include "filesys/directory.h"
 #include "threads/synch.h"
 #include <debug.h>
+#include <hash.h>
 #include <list.h>
 #include <stdint.h>
 
@@ -101,10 +102,21 @@ struct thread
   struct thread *parent;     /* Parent thread that spawned this. */
   struct list children;      /* Stores all children of this thread. */
   struct lock children_lock; /* Lock for accessing the children list. */
-  struct list open_files;    /* All files this thread has open. */
+  struct open_file **fds;    /* Open files indexed by fd, NULL if unused. */
+  int fd_cnt;                /* Number of slots in fds. */
+  int fd_free;               /* No fd below this one is unused. */
   struct file *cur_file;     /* The current file this thread has open. */
-  int cur_fd; /* The current max file descriptor that has been assigned by this
-                 thread. */
+  uint8_t *heap_start;       /* Start of the heap, after the segments. */
+  uint8_t *brk;              /* Current end of the heap (sbrk). */
+#ifdef VM
+  struct hash pages;          /* Supplemental page table (vm/page.c). */
+  uint8_t *last_swap_in;      /* Last page read back from swap. */
+  struct list mappings;       /* Memory-mapped files (file_mapping). */
+  int next_mapid;             /* Id for the next mapping. */
+  struct list_elem heat_elem; /* Element in the sampler's list. */
+  uint8_t *stack_low;         /* Lowest stack page grown so far. */
+  struct heatmap *heat;       /* Latest heat sample, or null. */
+#endif
   struct child *child_self; /* A pointer to the child structure that represents
                                this thread. */
 #endif
@@ -112,6 +124,13 @@ struct thread
   /* Project 4 (if we get to subdirectories). */
   struct dir *dir; /* The current working directory for this thread. */
 
+#ifdef FILESYS
+  /* Owned by filesys/journal.c. */
+  int journal_depth;      /* Journal operations open, counting nested. */
+  size_t journal_credits; /* Images the outermost one reserved. */
+  size_t journal_revokes; /* Revokes the outermost one reserved. */
+#endif
+
   /* Owned by thread.c. */
   unsigned magic; /* Detects stack overflow. */
 };
@@ -172,6 +191,8 @@ struct thread *find_thread (tid_t id);
 struct child *find_child (tid_t id, struct thread *parent);
 void remove_all_children (struct thread *cur);
 struct open_file *find_open_file (int fd, struct thread *cur);
+int add_open_file (struct open_file *of, struct thread *cur);
+struct open_file *remove_open_file (int fd, struct thread *cur);
 void close_all_open_files (struct thread *cur);
 
 #endif /* threads/thread.h */
@@ -1,8 +1,15 @@
 #include "userprog/exception.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "threads/vaddr.h"
 #include "userprog/gdt.h"
+#include "userprog/pagedir.h"
+#include "userprog/process.h"
 #include "userprog/syscall.h"
+#include "userprog/usermem.h"
+#ifdef VM
+#include "vm/page.h"
+#endif
 #include <inttypes.h>
 #include <stdio.h>
 
@@ -175,6 +182,38 @@ page_fault (struct intr_frame *f)
   write = (f->error_code & PF_W) != 0;
   user = (f->error_code & PF_U) != 0;
 
+  /* A write to a page shared copy-on-write since fork gets a
+     private copy of the page, whether the process wrote it or the
+     kernel did on its behalf. */
+  if (!not_present && write && is_user_vaddr (fault_addr)
+      && thread_current ()->pagedir != NULL
+      && pagedir_cow_fault (thread_current ()->pagedir, fault_addr))
+    return;
+
+#ifdef VM
+  /* Bring in a page the process has but that has not been loaded
+     yet, again whether the process or the kernel touched it, or
+     grow the stack down to it.  The kernel touches user memory only
+     in system calls, with the user's stack pointer saved on entry. */
+  if (not_present
+      && (page_fault_in (fault_addr)
+          || page_grow_stack (
+              fault_addr,
+              user ? f->esp : process_user_frame (thread_current ())->esp)))
+    return;
+#endif
+
+  /* A kernel access to a bad user address from one of the probes in
+     userprog/usermem.c, which left the address to resume at in EAX.
+     Resume there, reporting the failure with EAX = -1.  Any other
+     kernel fault is a bug. */
+  if (!user && is_user_vaddr (fault_addr) && usermem_probe_at (f->eip))
+    {
+      f->eip = (void (*) (void))f->eax;
+      f->eax = 0xffffffff;
+      return;
+    }
+
   /* To implement virtual memory, delete the rest of the function
      body, and replace it with code that brings in the page to
      which fault_addr refers. */
@@ -0,0 +1,299 @@
+#include "userprog/exec-cache.h"
+#include "filesys/file.h"
+#include "filesys/inode.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#ifdef VM
+#include "vm/frame.h"
+#endif
+#include <debug.h>
+#include <string.h>
+
+/* Executables that have been loaded before, most recently used
+   first.  load() in userprog/process.c parses an executable once,
+   and each read-only page is read into a frame held here the first
+   time any process needs it.  From then on that frame is mapped into
+   every process running the executable instead of being read
+   again.  An image is keyed by its open inode and dropped as soon
+   as the inode is written to or removed.  Images no process is
+   using are dropped, least recently used first, when the user pool
+   runs out, which frees their frames. */
+static struct list exec_cache;
+static size_t exec_cache_cnt;
+
+/* Protects exec_cache, exec_cache_cnt and the images' users.  May be
+   acquired while holding an image's lock, but not the other way
+   around. */
+static struct lock exec_cache_lock;
+
+/* Initializes the executable cache. */
+void
+exec_cache_init (void)
+{
+  list_init (&exec_cache);
+  lock_init (&exec_cache_lock);
+}
+
+/* Returns a new, empty image for INODE, of which it takes a new
+   reference, with room for SEGMENT_CNT segments.  Returns a null
+   pointer if memory runs out.  The caller fills in the rest. */
+struct exec_image *
+exec_image_create (struct inode *inode, size_t segment_cnt)
+{
+  struct exec_image *image
+      = calloc (1, sizeof *image + segment_cnt * sizeof *image->segments);
+  if (image == NULL)
+    return NULL;
+
+  image->inode = inode_reopen (inode);
+  image->write_cnt = inode_write_count (inode);
+  image->users = 1;
+  lock_init (&image->lock);
+  return image;
+}
+
+/* Frees IMAGE, its segments and its claims on their frames. */
+void
+exec_image_destroy (struct exec_image *image)
+{
+  for (size_t i = 0; i < image->segment_cnt; i++)
+    {
+      struct exec_segment *seg = &image->segments[i];
+      size_t pages = (seg->read_bytes + seg->zero_bytes) / PGSIZE;
+
+      if (seg->frames == NULL)
+        continue;
+      for (size_t j = 0; j < pages; j++)
+        if (seg->frames[j] != NULL)
+          pagedir_release_frame (seg->frames[j]);
+      free (seg->frames);
+    }
+  inode_close (image->inode);
+  free (image);
+}
+
+/* Returns the frame holding page number PAGE of read-only segment
+   SEG of IMAGE, reading it from FILE, an open handle on the
+   executable, if no process has needed the page before.  The frame
+   belongs to IMAGE; a process that maps it must take its own claim
+   with pagedir_share_page().  Returns a null pointer if memory runs
+   out or the read fails. */
+void *
+exec_image_frame (struct exec_image *image, struct exec_segment *seg,
+                  size_t page, struct file *file)
+{
+  void *kpage;
+
+  ASSERT (seg->frames != NULL);
+  ASSERT (page < (seg->read_bytes + seg->zero_bytes) / PGSIZE);
+
+  lock_acquire (&image->lock);
+  kpage = seg->frames[page];
+  if (kpage == NULL)
+    {
+      uint32_t ofs = page * PGSIZE;
+      size_t read_bytes = 0;
+
+      if (ofs < seg->read_bytes)
+        read_bytes = seg->read_bytes - ofs < PGSIZE ? seg->read_bytes - ofs
+                                                    : PGSIZE;
+#ifdef VM
+      /* shared frames have no owner, so they are never evicted; they
+         are freed with the image */
+      kpage = frame_alloc (0, NULL);
+#else
+      kpage = palloc_get_page (PAL_USER);
+#endif
+      if (kpage != NULL
+          && file_read_at (file, kpage, read_bytes, seg->file_page + ofs)
+                 != (off_t)read_bytes)
+        {
+          pagedir_release_frame (kpage);
+          kpage = NULL;
+        }
+      if (kpage != NULL)
+        {
+          memset ((uint8_t *)kpage + read_bytes, 0, PGSIZE - read_bytes);
+          seg->frames[page] = kpage;
+        }
+    }
+  lock_release (&image->lock);
+  return kpage;
+}
+
+/* Removes IMAGE from the cache.  Returns true if no process is using
+   it, in which case the caller must free it with exec_image_destroy()
+   once it has released exec_cache_lock; otherwise the last
+   exec_cache_release() frees it.  The caller must hold
+   exec_cache_lock. */
+static bool
+exec_cache_remove (struct exec_image *image)
+{
+  list_remove (&image->elem);
+  exec_cache_cnt--;
+  image->elem.prev = image->elem.next = NULL;
+  return image->users == 0;
+}
+
+/* Returns the cached image of INODE, with a use taken on it that the
+   caller must drop with exec_cache_release(), or a null pointer if
+   INODE is not cached or has been written since it was. */
+struct exec_image *
+exec_cache_lookup (struct inode *inode)
+{
+  struct exec_image *stale = NULL;
+  struct list_elem *e;
+
+  lock_acquire (&exec_cache_lock);
+  for (e = list_begin (&exec_cache); e != list_end (&exec_cache);
+       e = list_next (e))
+    {
+      struct exec_image *image = list_entry (e, struct exec_image, elem);
+      if (image->inode != inode)
+        continue;
+
+      if (image->write_cnt != inode_write_count (inode))
+        {
+          if (exec_cache_remove (image))
+            stale = image;
+          break;
+        }
+
+      /* move to the front, for eviction */
+      list_remove (&image->elem);
+      list_push_front (&exec_cache, &image->elem);
+      image->users++;
+      lock_release (&exec_cache_lock);
+      return image;
+    }
+  lock_release (&exec_cache_lock);
+
+  if (stale != NULL)
+    exec_image_destroy (stale);
+  return NULL;
+}
+
+/* Adds IMAGE, made by exec_image_create() and still in use by the
+   caller, to the cache, evicting the least recently used image if
+   the cache is full.  If another load cached the same executable in
+   the meantime, IMAGE is freed and that image is used instead.
+   Returns the image the caller now uses. */
+struct exec_image *
+exec_cache_insert (struct exec_image *image)
+{
+  struct list_elem *e;
+
+  lock_acquire (&exec_cache_lock);
+  for (e = list_begin (&exec_cache); e != list_end (&exec_cache);
+       e = list_next (e))
+    {
+      struct exec_image *other = list_entry (e, struct exec_image, elem);
+      if (other->inode == image->inode
+          && other->write_cnt == image->write_cnt)
+        {
+          other->users++;
+          lock_release (&exec_cache_lock);
+          exec_image_destroy (image);
+          return other;
+        }
+    }
+
+  struct exec_image *victim = NULL;
+  if (exec_cache_cnt >= EXEC_CACHE_SIZE)
+    {
+      victim = list_entry (list_back (&exec_cache), struct exec_image, elem);
+      if (!exec_cache_remove (victim))
+        victim = NULL;
+    }
+  list_push_front (&exec_cache, &image->elem);
+  exec_cache_cnt++;
+  lock_release (&exec_cache_lock);
+
+  if (victim != NULL)
+    exec_image_destroy (victim);
+  return image;
+}
+
+/* Drops the least recently used image that no process is using,
+   freeing its frames and closing its inode.  Returns false if every
+   cached image is in use.  Called when the user pool runs out. */
+bool
+exec_cache_reclaim (void)
+{
+  struct exec_image *victim = NULL;
+  struct list_elem *e;
+
+  lock_acquire (&exec_cache_lock);
+  for (e = list_rbegin (&exec_cache); e != list_rend (&exec_cache);
+       e = list_prev (e))
+    {
+      struct exec_image *image = list_entry (e, struct exec_image, elem);
+      if (image->users == 0)
+        {
+          exec_cache_remove (image);
+          victim = image;
+          break;
+        }
+    }
+  lock_release (&exec_cache_lock);
+
+  if (victim != NULL)
+    exec_image_destroy (victim);
+  return victim != NULL;
+}
+
+/* Drops the cached image of INODE, if any, so that the cache does
+   not keep a removed executable open.  Processes still running it
+   keep their use of the image. */
+void
+exec_cache_drop (struct inode *inode)
+{
+  struct exec_image *idle = NULL;
+  struct list_elem *e;
+
+  lock_acquire (&exec_cache_lock);
+  for (e = list_begin (&exec_cache); e != list_end (&exec_cache);
+       e = list_next (e))
+    {
+      struct exec_image *image = list_entry (e, struct exec_image, elem);
+      if (image->inode == inode)
+        {
+          if (exec_cache_remove (image))
+            idle = image;
+          break;
+        }
+    }
+  lock_release (&exec_cache_lock);
+
+  if (idle != NULL)
+    exec_image_destroy (idle);
+}
+
+/* Takes another use of IMAGE, which the caller already uses, to be
+   dropped with exec_cache_release(). */
+void
+exec_cache_hold (struct exec_image *image)
+{
+  lock_acquire (&exec_cache_lock);
+  ASSERT (image->users > 0);
+  image->users++;
+  lock_release (&exec_cache_lock);
+}
+
+/* Drops the caller's use of IMAGE, freeing it if it has left the
+   cache in the meantime. */
+void
+exec_cache_release (struct exec_image *image)
+{
+  bool destroy;
+
+  lock_acquire (&exec_cache_lock);
+  ASSERT (image->users > 0);
+  destroy = --image->users == 0 && image->elem.next == NULL;
+  lock_release (&exec_cache_lock);
+
+  if (destroy)
+    exec_image_destroy (image);
+}
@@ -0,0 +1,57 @@
+#ifndef USERPROG_EXEC_CACHE_H
+#define USERPROG_EXEC_CACHE_H
+
+#include "threads/synch.h"
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct file;
+struct inode;
+
+/* Most executables the cache keeps. */
+#define EXEC_CACHE_SIZE 16
+
+/* A loadable segment of an executable, as load_segment() takes it. */
+struct exec_segment
+{
+  uint32_t file_page;  /* Page-aligned offset in the file. */
+  uint8_t *upage;      /* Page-aligned user virtual address. */
+  uint32_t read_bytes; /* Bytes to read from the file. */
+  uint32_t zero_bytes; /* Bytes to zero after them. */
+  bool writable;       /* Writable by the process? */
+  void **frames;       /* For a read-only segment, the frames holding its
+                          pages, shared by every process running the
+                          executable and read in on first use.  Null
+                          for a writable segment. */
+};
+
+/* An executable whose headers have been parsed, kept between execs
+   of the same file. */
+struct exec_image
+{
+  struct list_elem elem;          /* Element in the cache. */
+  struct inode *inode;            /* The executable, kept open. */
+  unsigned write_cnt;             /* inode_write_count() when parsed. */
+  int users;                      /* Processes using the image. */
+  struct lock lock;               /* Serializes filling in frames. */
+  void (*entry) (void);           /* Entry point. */
+  uint8_t *heap_start;            /* End of the last segment. */
+  size_t segment_cnt;             /* Number of segments. */
+  struct exec_segment segments[]; /* The loadable segments. */
+};
+
+void exec_cache_init (void);
+struct exec_image *exec_image_create (struct inode *, size_t segment_cnt);
+void exec_image_destroy (struct exec_image *);
+void *exec_image_frame (struct exec_image *, struct exec_segment *,
+                        size_t page, struct file *);
+struct exec_image *exec_cache_lookup (struct inode *);
+struct exec_image *exec_cache_insert (struct exec_image *);
+bool exec_cache_reclaim (void);
+void exec_cache_drop (struct inode *);
+void exec_cache_hold (struct exec_image *);
+void exec_cache_release (struct exec_image *);
+
+#endif /* userprog/exec-cache.h */
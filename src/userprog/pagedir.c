@@ -2,13 +2,60 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <string.h>
+#include <round.h>
 #include "threads/init.h"
 #include "threads/pte.h"
 #include "threads/palloc.h"
+#include "threads/synch.h"
+#ifdef VM
+#include "vm/frame.h"
+#endif
+
+/* Marks a user page that pagedir_fork() made read-only because it
+   is shared copy-on-write.  One of the PTE_AVL bits, which the CPU
+   ignores. */
+#define PTE_COW 0x200
 
 static uint32_t *active_pd (void);
 static void invalidate_pagedir (uint32_t *);
 
+/* Number of page directories beyond the first that map each
+   physical frame, indexed by physical page number.  Nonzero only
+   for frames shared after fork. */
+static uint16_t *frame_shares;
+
+/* Protects frame_shares. */
+static struct lock frame_shares_lock;
+
+/* Sets up the sharing counts for every physical frame.  Must be
+   called after palloc_init(). */
+void
+pagedir_init (void) 
+{
+  size_t pages = DIV_ROUND_UP (init_ram_pages * sizeof *frame_shares,
+                               PGSIZE);
+
+  frame_shares = palloc_get_multiple (PAL_ASSERT | PAL_ZERO, pages);
+  lock_init (&frame_shares_lock);
+}
+
+#ifdef VM
+/* Gives frame KPAGE back to the one process that maps it, if no
+   other page directory shares it any more, so that the frame table
+   may evict it again. */
+static void
+readopt_frame (void *kpage) 
+{
+  bool held = frame_table_lock ();
+
+  lock_acquire (&frame_shares_lock);
+  if (frame_shares[vtop (kpage) >> PGBITS] == 0)
+    frame_readopt (kpage);
+  lock_release (&frame_shares_lock);
+  frame_table_unlock (held);
+}
+#endif
+
 /* Creates a new page directory that has mappings for kernel
    virtual addresses, but none for user virtual addresses.
    Returns the new page directory, or a null pointer if memory
@@ -41,7 +88,7 @@ pagedir_destroy (uint32_t *pd)
         
         for (pte = pt; pte < pt + PGSIZE / sizeof *pte; pte++)
           if (*pte & PTE_P) 
-            palloc_free_page (pte_get_page (*pte));
+            pagedir_release_frame (pte_get_page (*pte));
         palloc_free_page (pt);
       }
   palloc_free_page (pd);
@@ -118,6 +165,33 @@ pagedir_set_page (uint32_t *pd, void *upage, void *kpage, bool writable)
     return false;
 }
 
+/* Like pagedir_set_page(), but KPAGE stays shared with whoever
+   already holds it, such as another page directory or the
+   executable cache, and PD takes an additional claim on it.  If
+   WRITABLE is true, the page is mapped copy-on-write. */
+bool
+pagedir_share_page (uint32_t *pd, void *upage, void *kpage, bool writable)
+{
+  uint32_t *pte;
+
+  ASSERT (pg_ofs (upage) == 0);
+  ASSERT (pg_ofs (kpage) == 0);
+  ASSERT (is_user_vaddr (upage));
+  ASSERT (pd != init_page_dir);
+
+  pte = lookup_page (pd, upage, true);
+  if (pte == NULL)
+    return false;
+
+  ASSERT ((*pte & PTE_P) == 0);
+  *pte = pte_create_user (kpage, false) | (writable ? PTE_COW : 0);
+
+  lock_acquire (&frame_shares_lock);
+  frame_shares[vtop (kpage) >> PGBITS]++;
+  lock_release (&frame_shares_lock);
+  return true;
+}
+
 /* Looks up the physical address that corresponds to user virtual
    address UADDR in PD.  Returns the kernel virtual address
    corresponding to that physical address, or a null pointer if
@@ -156,6 +230,152 @@ pagedir_clear_page (uint32_t *pd, void *upage)
     }
 }
 
+/* Removes the mapping for user virtual page UPAGE from PD and
+   frees the frame behind it, unless another page directory still
+   shares the frame.  UPAGE need not be mapped. */
+void
+pagedir_free_page (uint32_t *pd, void *upage) 
+{
+  uint32_t *pte;
+
+  ASSERT (pg_ofs (upage) == 0);
+  ASSERT (is_user_vaddr (upage));
+
+  pte = lookup_page (pd, upage, false);
+  if (pte != NULL && (*pte & PTE_P) != 0)
+    {
+      void *kpage = pte_get_page (*pte);
+      *pte = 0;
+      invalidate_pagedir (pd);
+      pagedir_release_frame (kpage);
+    }
+}
+
+/* Maps every user page of PARENT into CHILD, which must have no
+   user mappings yet, at the same address and sharing the same
+   frame.  Writable pages become read-only copy-on-write in both
+   page directories; the first write to one is handled by
+   pagedir_cow_fault().  Returns true if successful, false if a
+   page table could not be allocated, in which case CHILD holds
+   some of the mappings and should be destroyed. */
+bool
+pagedir_fork (uint32_t *child, uint32_t *parent) 
+{
+  uint32_t *pde;
+  bool success = true;
+
+  ASSERT (child != init_page_dir && parent != init_page_dir);
+
+  for (pde = parent; pde < parent + pd_no (PHYS_BASE) && success; pde++)
+    if (*pde & PTE_P) 
+      {
+        uint32_t *pt = pde_get_pt (*pde);
+        size_t i;
+
+        for (i = 0; i < PGSIZE / sizeof *pt; i++)
+          if (pt[i] & PTE_P) 
+            {
+              void *upage = (void *) (((uintptr_t) (pde - parent) << PDSHIFT)
+                                      | (i << PTSHIFT));
+              uint32_t *pte = lookup_page (child, upage, true);
+              if (pte == NULL)
+                {
+                  success = false;
+                  break;
+                }
+
+              if (pt[i] & PTE_W)
+                pt[i] = (pt[i] & ~(uint32_t) PTE_W) | PTE_COW;
+#ifdef VM
+              /* The dirty bit tells the frame table whether the page
+                 still matches its file, so the child keeps it. */
+              *pte = pt[i] & ~(uint32_t) PTE_A;
+#else
+              *pte = pt[i] & ~(uint32_t) (PTE_A | PTE_D);
+#endif
+
+              lock_acquire (&frame_shares_lock);
+              frame_shares[vtop (pte_get_page (pt[i])) >> PGBITS]++;
+              lock_release (&frame_shares_lock);
+#ifdef VM
+              frame_disown (pte_get_page (pt[i]));
+#endif
+            }
+      }
+
+  /* The parent's writable pages are read-only now. */
+  invalidate_pagedir (parent);
+  return success;
+}
+
+/* Resolves a write fault on user virtual address UADDR in PD.  If
+   the page is copy-on-write, gives PD a private writable copy of it,
+   or just makes it writable again if no other page directory still
+   shares its frame, and returns true.  Returns false if the page is
+   not copy-on-write, so the fault is a real error, or if memory for
+   the copy runs out. */
+bool
+pagedir_cow_fault (uint32_t *pd, const void *uaddr) 
+{
+  uint32_t *pte;
+  void *copy;
+
+  ASSERT (is_user_vaddr (uaddr));
+
+  pte = lookup_page (pd, uaddr, false);
+  if (pte == NULL || (*pte & (PTE_P | PTE_COW)) != (PTE_P | PTE_COW))
+    return false;
+
+  /* Allocate first, so the lock is never held while we wait on the
+     page allocator. */
+#ifdef VM
+  copy = frame_alloc (0, pg_round_down (uaddr));
+#else
+  copy = palloc_get_page (PAL_USER);
+#endif
+
+  lock_acquire (&frame_shares_lock);
+  void *kpage = pte_get_page (*pte);
+  uint16_t *shares = &frame_shares[vtop (kpage) >> PGBITS];
+  if (*shares == 0)
+    {
+      /* Every other sharer has copied or exited already. */
+      *pte = (*pte & ~(uint32_t) PTE_COW) | PTE_W;
+    }
+  else if (copy != NULL)
+    {
+      memcpy (copy, kpage, PGSIZE);
+      (*shares)--;
+      *pte = pte_create_user (copy, true) | (*pte & PTE_A);
+      copy = NULL;
+    }
+  else
+    {
+      lock_release (&frame_shares_lock);
+      return false;
+    }
+  lock_release (&frame_shares_lock);
+  invalidate_pagedir (pd);
+
+#ifdef VM
+  /* Either way the page is private now, so the frame table may
+     evict it, and so may the frame we copied if only one other
+     process maps it now. */
+  if (copy != NULL)
+    frame_free (copy);
+  if (pte_get_page (*pte) == kpage)
+    frame_adopt (kpage, pg_round_down (uaddr));
+  else
+    {
+      frame_unpin (pte_get_page (*pte));
+      readopt_frame (kpage);
+    }
+#else
+  palloc_free_page (copy);
+#endif
+  return true;
+}
+
 /* Returns true if the PTE for virtual page VPAGE in PD is dirty,
    that is, if the page has been modified since the PTE was
    installed.
@@ -214,6 +434,32 @@ pagedir_set_accessed (uint32_t *pd, const void *vpage, bool accessed)
     }
 }
 
+/* Drops one claim on physical frame KPAGE, and frees the frame if
+   nothing else shares it.  Claims are held by the page directories
+   that map the frame, and by anyone who took one with
+   pagedir_share_page(). */
+void
+pagedir_release_frame (void *kpage) 
+{
+  uint16_t *shares = &frame_shares[vtop (kpage) >> PGBITS];
+  bool last;
+
+  lock_acquire (&frame_shares_lock);
+  last = *shares == 0;
+  if (!last)
+    (*shares)--;
+  lock_release (&frame_shares_lock);
+
+  if (last)
+#ifdef VM
+    frame_free (kpage);
+  else
+    readopt_frame (kpage);
+#else
+    palloc_free_page (kpage);
+#endif
+}
+
 /* Loads page directory PD into the CPU's page directory base
    register. */
 void
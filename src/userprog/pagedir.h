@@ -4,11 +4,17 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+void pagedir_init (void);
 uint32_t *pagedir_create (void);
 void pagedir_destroy (uint32_t *pd);
 bool pagedir_set_page (uint32_t *pd, void *upage, void *kpage, bool rw);
+bool pagedir_share_page (uint32_t *pd, void *upage, void *kpage, bool rw);
 void *pagedir_get_page (uint32_t *pd, const void *upage);
 void pagedir_clear_page (uint32_t *pd, void *upage);
+void pagedir_free_page (uint32_t *pd, void *upage);
+bool pagedir_fork (uint32_t *child, uint32_t *parent);
+bool pagedir_cow_fault (uint32_t *pd, const void *upage);
+void pagedir_release_frame (void *kpage);
 bool pagedir_is_dirty (uint32_t *pd, const void *upage);
 void pagedir_set_dirty (uint32_t *pd, const void *upage, bool dirty);
 bool pagedir_is_accessed (uint32_t *pd, const void *upage);
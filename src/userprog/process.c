@@ -5,14 +5,20 @@
 #include "threads/flags.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
+#include "userprog/exec-cache.h"
 #include "userprog/gdt.h"
 #include "userprog/pagedir.h"
 #include "userprog/syscall.h"
 #include "userprog/tss.h"
 #include "vm/frame.h"
+#ifdef VM
+#include "vm/heat.h"
+#include "vm/page.h"
+#endif
 #include <debug.h>
 #include <inttypes.h>
 #include <round.h>
@@ -22,7 +28,11 @@
 
 #define STACK_ARGS 25
 
+/* -stack: Most bytes a process's stack may grow to. */
+size_t stack_limit = STACK_MAX;
+
 static thread_func start_process NO_RETURN;
+static thread_func start_fork NO_RETURN;
 static bool load (const char *cmdline, void (**eip) (void), void **esp);
 
 /* Starts a new thread running a user program loaded from
@@ -130,6 +140,201 @@ start_process (void *process_args_)
   NOT_REACHED ();
 }
 
+/* Arguments for start_fork(). */
+struct fork_args
+{
+  struct intr_frame if_; /* User registers to start the child with. */
+  struct thread *parent; /* The forking process. */
+  struct child *self;    /* The child's entry for the parent. */
+};
+
+/* Returns the interrupt frame that saved thread T's user registers
+   when it entered the kernel.  Both `int $0x30' and sysenter build
+   it at the very top of the thread's kernel stack. */
+struct intr_frame *
+process_user_frame (struct thread *t)
+{
+  return (struct intr_frame *)((uint8_t *)t + PGSIZE) - 1;
+}
+
+/* Creates a child of the current process that is a copy of it:
+   same memory, sharing its pages copy-on-write, same open files,
+   sharing their positions, and the same registers, except that
+   fork() returns 0 in the child.  Returns the child's thread id,
+   or TID_ERROR if the child could not be created.  Must be called
+   from a system call. */
+tid_t
+process_fork (void)
+{
+  struct thread *cur = thread_current ();
+  struct child *child = palloc_get_page (PAL_ZERO);
+  struct fork_args *fa = malloc (sizeof *fa);
+  tid_t tid;
+
+  if (child == NULL || fa == NULL)
+    {
+      palloc_free_page (child);
+      free (fa);
+      return TID_ERROR;
+    }
+  sema_init (&child->load_sema, 0);
+  sema_init (&child->exit_sema, 0);
+  sema_init (&child->parent_sema, 0);
+
+  fa->if_ = *process_user_frame (cur);
+  fa->if_.eax = 0;
+  fa->parent = cur;
+  fa->self = child;
+
+  tid = thread_create (cur->name, PRI_DEFAULT, start_fork, fa);
+  if (tid == TID_ERROR)
+    {
+      palloc_free_page (child);
+      free (fa);
+      return TID_ERROR;
+    }
+
+  /* wait for the child to finish copying us */
+  sema_down (&child->load_sema);
+  free (fa);
+
+  return child->loaded ? tid : TID_ERROR;
+}
+
+/* Gives T a copy of PARENT's descriptor table, with each open file
+   shared, and its own handle on PARENT's executable.  Returns true if
+   successful, false if memory runs out, leaving whatever was copied
+   for process_exit() to close. */
+static bool
+fork_files (struct thread *t, struct thread *parent)
+{
+  if (parent->cur_file != NULL)
+    {
+      t->cur_file = file_reopen (parent->cur_file);
+      if (t->cur_file == NULL)
+        return false;
+      file_deny_write (t->cur_file);
+    }
+
+  if (parent->fd_cnt == 0)
+    return true;
+
+  t->fds = calloc (parent->fd_cnt, sizeof *t->fds);
+  if (t->fds == NULL)
+    return false;
+  t->fd_cnt = parent->fd_cnt;
+  t->fd_free = parent->fd_free;
+
+  for (int fd = FD_MIN; fd < parent->fd_cnt; fd++)
+    if (parent->fds[fd] != NULL)
+      {
+        struct open_file *of = malloc (sizeof *of);
+        if (of == NULL)
+          return false;
+        of->fd = fd;
+        of->file = file_dup (parent->fds[fd]->file);
+        t->fds[fd] = of;
+      }
+  return true;
+}
+
+#ifdef VM
+/* Gives T, whose page table is a copy of PARENT's, a copy of each of
+   PARENT's memory mappings, with its own handle on the file, and
+   points T's pages in the mapping at that handle.  Returns true if
+   successful, false if memory runs out, leaving whatever was copied
+   for process_exit() to unmap. */
+static bool
+fork_mappings (struct thread *t, struct thread *parent)
+{
+  struct list_elem *e;
+
+  t->next_mapid = parent->next_mapid;
+  for (e = list_begin (&parent->mappings); e != list_end (&parent->mappings);
+       e = list_next (e))
+    {
+      struct file_mapping *m = list_entry (e, struct file_mapping, elem);
+      struct file_mapping *copy = malloc (sizeof *copy);
+      if (copy == NULL)
+        return false;
+
+      *copy = *m;
+      copy->file = file_reopen (m->file);
+      if (copy->file == NULL)
+        {
+          free (copy);
+          return false;
+        }
+      for (size_t i = 0; i < copy->page_count; i++)
+        page_lookup (t, copy->start + i * PGSIZE)->file = copy->file;
+      list_push_back (&t->mappings, &copy->elem);
+    }
+  return true;
+}
+#endif
+
+/* A thread function that turns a new thread into a copy of the
+   forking process and starts it running in user mode. */
+static void
+start_fork (void *fork_args_)
+{
+  struct fork_args *fa = fork_args_;
+  struct thread *parent = fa->parent;
+  struct child *self = fa->self;
+  struct thread *cur = thread_current ();
+  struct intr_frame if_ = fa->if_;
+  bool success;
+  cur->parent = parent;
+
+  /* The parent is blocked until we are done, so its address space and
+     descriptor table hold still while we copy them. */
+#ifdef VM
+  /* a process with a page directory always has a page table */
+  if (page_table_init ())
+#endif
+    cur->pagedir = pagedir_create ();
+  success = cur->pagedir != NULL && fork_files (cur, parent);
+#ifdef VM
+  /* keep the parent's pages from being evicted while they are shared */
+  bool held = frame_table_lock ();
+  success = (success && pagedir_fork (cur->pagedir, parent->pagedir)
+             && page_table_copy (cur, parent));
+  frame_table_unlock (held);
+  success = success && fork_mappings (cur, parent);
+  if (cur->pagedir != NULL)
+    heat_add (cur);
+#else
+  success = success && pagedir_fork (cur->pagedir, parent->pagedir);
+#endif
+  process_activate ();
+  cur->heap_start = parent->heap_start;
+  cur->brk = parent->brk;
+#ifdef VM
+  cur->stack_low = parent->stack_low;
+#endif
+
+  /* init the child element for this process */
+  self->exit_status = 0;
+  self->self = cur;
+  self->loaded = success;
+  cur->child_self = self;
+
+  /* add the child to the parent thread's children */
+  lock_acquire (&parent->children_lock);
+  list_push_front (&parent->children, &self->elem);
+  lock_release (&parent->children_lock);
+
+  /* tell parent that the child is ready, after which FA is gone */
+  sema_up (&self->load_sema);
+
+  if (!success)
+    thread_exit ();
+
+  /* Return to user mode where the parent entered the kernel. */
+  asm volatile("movl %0, %%esp; jmp intr_exit" : : "g"(&if_) : "memory");
+  NOT_REACHED ();
+}
+
 /* Waits for thread TID to die and returns its exit status.  If
    it was terminated by the kernel (i.e. killed due to an
    exception), returns -1.  If TID is invalid or if it was not a
@@ -183,6 +388,11 @@ process_exit (void)
   /* close all file opened by this thread */
   close_all_open_files (cur);
 
+#ifdef VM
+  /* write back mapped files while the page directory is still there */
+  munmap_all ();
+#endif
+
   uint32_t *pd;
 
   /* Destroy the current process's page directory and switch back
@@ -197,9 +407,22 @@ process_exit (void)
          directory before destroying the process's page
          directory, or our active page directory will be one
          that's been freed (and cleared). */
+#ifdef VM
+      /* frame_evict() and the heat sampler leave processes without
+         a page directory alone, so once it is gone nobody else
+         touches either table. */
+      heat_remove (cur);
+      bool held = frame_table_lock ();
+      cur->pagedir = NULL;
+      frame_table_unlock (held);
+#else
       cur->pagedir = NULL;
+#endif
       pagedir_activate (NULL);
       pagedir_destroy (pd);
+#ifdef VM
+      page_table_destroy ();
+#endif
     }
 
   /* if there is a file currently open, make sure to close it and allow
@@ -294,10 +517,10 @@ struct Elf32_Phdr
 
 static bool setup_stack (void **esp, char *argv[],
                          int argc); /* added argv, argc */
+static struct exec_image *read_image (struct file *, const char *name);
 static bool validate_segment (const struct Elf32_Phdr *, struct file *);
-static bool load_segment (struct file *file, off_t ofs, uint8_t *upage,
-                          uint32_t read_bytes, uint32_t zero_bytes,
-                          bool writable);
+static bool load_segment (struct file *, struct exec_image *,
+                          struct exec_segment *);
 
 static void push_args_stack (void **esp, char *argv[], int argc);
 static int tokenize (const char *file_name, char *argv[], int argc);
@@ -310,16 +533,23 @@ bool
 load (const char *file_name, void (**eip) (void), void **esp)
 {
   struct thread *t = thread_current ();
-  struct Elf32_Ehdr ehdr;
+  struct exec_image *image = NULL;
   struct file *file = NULL;
-  off_t file_ofs;
   bool success = false;
   int i;
 
   /* Allocate and activate page directory. */
+#ifdef VM
+  /* a process with a page directory always has a page table */
+  if (!page_table_init ())
+    goto done;
+#endif
   t->pagedir = pagedir_create ();
   if (t->pagedir == NULL)
     goto done;
+#ifdef VM
+  heat_add (t);
+#endif
   process_activate ();
 
   /* tokenize the file name for pushing arguments to stack */
@@ -335,16 +565,78 @@ load (const char *file_name, void (**eip) (void), void **esp)
       goto done;
     }
   t->cur_file = file;
+
+  /* Parse the executable, unless it has been already. */
+  image = exec_cache_lookup (file_get_inode (file));
+  if (image == NULL)
+    {
+      image = read_image (file, argv[0]);
+      if (image == NULL)
+        goto done;
+      image = exec_cache_insert (image);
+    }
+
+  for (i = 0; (size_t)i < image->segment_cnt; i++)
+    if (!load_segment (file, image, &image->segments[i]))
+      goto done;
+
+  /* Set up stack. */
+  if (!setup_stack (esp, argv, argc))
+    goto done;
+
+  /* Start address. */
+  *eip = image->entry;
+
+  t->heap_start = t->brk = image->heap_start;
+  success = true;
+
+done:
+  if (image != NULL)
+    exec_cache_release (image);
+
+  /* deny writing to executables */
+  if (success)
+    file_deny_write (file);
+  else
+    file_close (file);
+  return success;
+}
+
+/* load() helpers. */
+
+static bool install_page (void *upage, void *kpage, bool writable);
+static void *alloc_user_page (void *upage);
+static void free_user_page (void *kpage);
+
+/* Reads and checks the headers of executable FILE, and the contents
+   of its read-only segments, and returns them as a new image for the
+   executable cache.  Returns a null pointer if FILE is not a valid
+   executable or memory runs out.  NAME is for error messages. */
+static struct exec_image *
+read_image (struct file *file, const char *name)
+{
+  struct Elf32_Ehdr ehdr;
+  struct exec_image *image;
+  uint8_t *heap_start = NULL;
+  off_t file_ofs;
+  int i;
+
   /* Read and verify executable header. */
+  file_seek (file, 0);
   if (file_read (file, &ehdr, sizeof ehdr) != sizeof ehdr
       || memcmp (ehdr.e_ident, "\177ELF\1\1\1", 7) || ehdr.e_type != 2
       || ehdr.e_machine != 3 || ehdr.e_version != 1
       || ehdr.e_phentsize != sizeof (struct Elf32_Phdr) || ehdr.e_phnum > 1024)
     {
-      printf ("load: %s: error loading executable\n", argv[0]);
-      goto done;
+      printf ("load: %s: error loading executable\n", name);
+      return NULL;
     }
 
+  image = exec_image_create (file_get_inode (file), ehdr.e_phnum);
+  if (image == NULL)
+    return NULL;
+  image->entry = (void (*) (void))ehdr.e_entry;
+
   /* Read program headers. */
   file_ofs = ehdr.e_phoff;
   for (i = 0; i < ehdr.e_phnum; i++)
@@ -352,11 +644,11 @@ load (const char *file_name, void (**eip) (void), void **esp)
       struct Elf32_Phdr phdr;
 
       if (file_ofs < 0 || file_ofs > file_length (file))
-        goto done;
+        goto error;
       file_seek (file, file_ofs);
 
       if (file_read (file, &phdr, sizeof phdr) != sizeof phdr)
-        goto done;
+        goto error;
       file_ofs += sizeof phdr;
       switch (phdr.p_type)
         {
@@ -370,62 +662,63 @@ load (const char *file_name, void (**eip) (void), void **esp)
         case PT_DYNAMIC:
         case PT_INTERP:
         case PT_SHLIB:
-          goto done;
+          goto error;
         case PT_LOAD:
           if (validate_segment (&phdr, file))
             {
-              bool writable = (phdr.p_flags & PF_W) != 0;
-              uint32_t file_page = phdr.p_offset & ~PGMASK;
-              uint32_t mem_page = phdr.p_vaddr & ~PGMASK;
+              struct exec_segment *seg
+                  = &image->segments[image->segment_cnt++];
               uint32_t page_offset = phdr.p_vaddr & PGMASK;
-              uint32_t read_bytes, zero_bytes;
+
+              seg->writable = (phdr.p_flags & PF_W) != 0;
+              seg->file_page = phdr.p_offset & ~PGMASK;
+              seg->upage = (uint8_t *)(phdr.p_vaddr & ~PGMASK);
               if (phdr.p_filesz > 0)
                 {
                   /* Normal segment.
                      Read initial part from disk and zero the rest. */
-                  read_bytes = page_offset + phdr.p_filesz;
-                  zero_bytes = (ROUND_UP (page_offset + phdr.p_memsz, PGSIZE)
-                                - read_bytes);
+                  seg->read_bytes = page_offset + phdr.p_filesz;
+                  seg->zero_bytes
+                      = (ROUND_UP (page_offset + phdr.p_memsz, PGSIZE)
+                         - seg->read_bytes);
                 }
               else
                 {
                   /* Entirely zero.
                      Don't read anything from disk. */
-                  read_bytes = 0;
-                  zero_bytes = ROUND_UP (page_offset + phdr.p_memsz, PGSIZE);
+                  seg->read_bytes = 0;
+                  seg->zero_bytes
+                      = ROUND_UP (page_offset + phdr.p_memsz, PGSIZE);
+                }
+
+              /* read-only pages are read once and shared */
+              if (!seg->writable)
+                {
+                  seg->frames = calloc (
+                      (seg->read_bytes + seg->zero_bytes) / PGSIZE,
+                      sizeof *seg->frames);
+                  if (seg->frames == NULL)
+                    goto error;
                 }
-              if (!load_segment (file, file_page, (void *)mem_page, read_bytes,
-                                 zero_bytes, writable))
-                goto done;
+
+              /* the heap starts after the last segment */
+              if (seg->upage + seg->read_bytes + seg->zero_bytes > heap_start)
+                heap_start = seg->upage + seg->read_bytes + seg->zero_bytes;
             }
           else
-            goto done;
+            goto error;
           break;
         }
     }
 
-  /* Set up stack. */
-  if (!setup_stack (esp, argv, argc))
-    goto done;
+  image->heap_start = heap_start;
+  return image;
 
-  /* Start address. */
-  *eip = (void (*) (void))ehdr.e_entry;
-
-  success = true;
-
-done:
-  /* deny writing to executables */
-  if (success)
-    file_deny_write (file);
-  else
-    file_close (file);
-  return success;
+error:
+  exec_image_destroy (image);
+  return NULL;
 }
 
-/* load() helpers. */
-
-static bool install_page (void *upage, void *kpage, bool writable);
-
 /* Checks whether PHDR describes a valid, loadable segment in
    FILE and returns true if so, false otherwise. */
 static bool
@@ -471,29 +764,55 @@ validate_segment (const struct Elf32_Phdr *phdr, struct file *file)
   return true;
 }
 
-/* Loads a segment starting at offset OFS in FILE at address
-   UPAGE.  In total, READ_BYTES + ZERO_BYTES bytes of virtual
-   memory are initialized, as follows:
+/* Loads segment SEG of IMAGE, the executable FILE, into the current
+   process.  A read-only segment maps the frames the executable cache
+   holds, reading them first if no process has yet.  A writable one
+   gets fresh pages, initialized as follows:
 
         - READ_BYTES bytes at UPAGE must be read from FILE
-          starting at offset OFS.
+          starting at offset FILE_PAGE.
 
         - ZERO_BYTES bytes at UPAGE + READ_BYTES must be zeroed.
 
-   The pages initialized by this function must be writable by the
-   user process if WRITABLE is true, read-only otherwise.
-
    Return true if successful, false if a memory allocation error
    or disk read error occurs. */
 static bool
-load_segment (struct file *file, off_t ofs, uint8_t *upage,
-              uint32_t read_bytes, uint32_t zero_bytes, bool writable)
+load_segment (struct file *file, struct exec_image *image,
+              struct exec_segment *seg)
 {
+  uint32_t read_bytes = seg->read_bytes;
+  uint32_t zero_bytes = seg->zero_bytes;
+  uint8_t *upage = seg->upage;
+
   ASSERT ((read_bytes + zero_bytes) % PGSIZE == 0);
   ASSERT (pg_ofs (upage) == 0);
-  ASSERT (ofs % PGSIZE == 0);
+  ASSERT (seg->file_page % PGSIZE == 0);
+
+#ifdef VM
+  /* With virtual memory, pages are only recorded here and brought
+     in by page_fault() when the process first touches them. */
+  if (seg->frames != NULL)
+    return page_add_image (image, seg, file);
+  return page_add_file (file, seg->file_page, upage, read_bytes, zero_bytes,
+                        seg->writable);
+#else
+  struct thread *t = thread_current ();
 
-  file_seek (file, ofs);
+  if (seg->frames != NULL)
+    {
+      for (size_t i = 0; i < (read_bytes + zero_bytes) / PGSIZE; i++)
+        {
+          void *kpage = exec_image_frame (image, seg, i, file);
+          if (kpage == NULL
+              || pagedir_get_page (t->pagedir, upage + i * PGSIZE) != NULL
+              || !pagedir_share_page (t->pagedir, upage + i * PGSIZE, kpage,
+                                      false))
+            return false;
+        }
+      return true;
+    }
+
+  file_seek (file, seg->file_page);
   while (read_bytes > 0 || zero_bytes > 0)
     {
       /* Calculate how to fill this page.
@@ -516,7 +835,7 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
       memset (kpage + page_read_bytes, 0, page_zero_bytes);
 
       /* Add the page to the process's address space. */
-      if (!install_page (upage, kpage, writable))
+      if (!install_page (upage, kpage, seg->writable))
         {
           palloc_free_page (kpage);
           return false;
@@ -528,6 +847,7 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
       upage += PGSIZE;
     }
   return true;
+#endif
 }
 
 /* Create the stack by mapping a zeroed page at the top of user virtual memory
@@ -535,31 +855,60 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 static bool
 setup_stack (void **esp, char *argv[], int argc)
 {
+  uint8_t *upage = ((uint8_t *)PHYS_BASE) - PGSIZE;
   uint8_t *kpage;
   bool success = false;
 
-  kpage = palloc_get_page (PAL_USER | PAL_ZERO);
+  kpage = alloc_user_page (upage);
   if (kpage != NULL)
     {
-      success = install_page (((uint8_t *)PHYS_BASE) - PGSIZE, kpage, true);
+      success = install_page (upage, kpage, true);
       if (success)
         {
+#ifdef VM
+          thread_current ()->stack_low = upage;
+#endif
           *esp = PHYS_BASE;
           push_args_stack (esp, argv, argc);
         }
       else
-        palloc_free_page (kpage);
+        free_user_page (kpage);
     }
   return success;
 }
 
+/* Returns a zeroed frame for user page UPAGE of the current process,
+   to be mapped with install_page(), or a null pointer if memory runs
+   out. */
+static void *
+alloc_user_page (void *upage UNUSED)
+{
+#ifdef VM
+  return frame_alloc (PAL_ZERO, upage);
+#else
+  return palloc_get_page (PAL_USER | PAL_ZERO);
+#endif
+}
+
+/* Frees KPAGE, obtained from alloc_user_page() but not installed. */
+static void
+free_user_page (void *kpage)
+{
+#ifdef VM
+  if (kpage != NULL)
+    frame_free (kpage);
+#else
+  palloc_free_page (kpage);
+#endif
+}
+
 /* Adds a mapping from user virtual address UPAGE to kernel
    virtual address KPAGE to the page table.
    If WRITABLE is true, the user process may modify the page;
    otherwise, it is read-only.
    UPAGE must not already be mapped.
    KPAGE should probably be a page obtained from the user pool
-   with palloc_get_page().
+   with alloc_user_page().
    Returns true on success, false if UPAGE is already mapped or
    if memory allocation fails. */
 static bool
@@ -569,8 +918,79 @@ install_page (void *upage, void *kpage, bool writable)
 
   /* Verify that there's not already a page at that virtual
      address, then map our page there. */
+#ifdef VM
+  if (pagedir_get_page (t->pagedir, upage) != NULL
+      || !page_add_frame (upage, writable))
+    return false;
+  if (!pagedir_set_page (t->pagedir, upage, kpage, writable))
+    {
+      page_remove (upage);
+      return false;
+    }
+  frame_unpin (kpage);
+  return true;
+#else
   return (pagedir_get_page (t->pagedir, upage) == NULL
           && pagedir_set_page (t->pagedir, upage, kpage, writable));
+#endif
+}
+
+/* Unmaps and frees the heap pages from START up to END, both
+   page-aligned, skipping any that are not mapped. */
+static void
+release_heap_pages (uint8_t *start, uint8_t *end)
+{
+  struct thread *t = thread_current ();
+  uint8_t *upage;
+
+#ifdef VM
+  /* a frame must not be evicted while it is being freed */
+  bool held = frame_table_lock ();
+#endif
+  for (upage = start; upage < end; upage += PGSIZE)
+    {
+      pagedir_free_page (t->pagedir, upage);
+#ifdef VM
+      page_remove (upage);
+#endif
+    }
+#ifdef VM
+  frame_table_unlock (held);
+#endif
+}
+
+/* Moves the current process's heap break by INCREMENT bytes and
+   returns the old break, or (void *) -1 if the break would fall
+   below the start of the heap or into the stack region, or if
+   memory runs out.  Pages the heap grows into are zeroed; pages
+   it shrinks out of are freed at once. */
+void *
+process_sbrk (intptr_t increment)
+{
+  struct thread *t = thread_current ();
+  uint8_t *old_brk = t->brk;
+  uint8_t *new_brk = old_brk + increment;
+  uint8_t *upage;
+
+  if ((increment > 0 && new_brk < old_brk)
+      || (increment < 0 && new_brk > old_brk) || new_brk < t->heap_start
+      || new_brk > (uint8_t *)PHYS_BASE - STACK_MAX)
+    return (void *)-1;
+
+  for (upage = pg_round_up (old_brk); upage < new_brk; upage += PGSIZE)
+    {
+      void *kpage = alloc_user_page (upage);
+      if (kpage == NULL || !install_page (upage, kpage, true))
+        {
+          free_user_page (kpage);
+          release_heap_pages (pg_round_up (old_brk), upage);
+          return (void *)-1;
+        }
+    }
+  release_heap_pages (pg_round_up (new_brk), pg_round_up (old_brk));
+
+  t->brk = new_brk;
+  return old_brk;
 }
 
 /* Parses a raw file name and splits it into tokens to be held within
@@ -4,11 +4,32 @@
 #include "threads/synch.h"
 #include "threads/thread.h"
 #include <list.h>
+#include <stdint.h>
+
+/* Bytes of address space below PHYS_BASE kept for the user stack.
+   The heap may not grow into them. */
+#define STACK_MAX (8 * 1024 * 1024)
+
+/* Bytes at the bottom of the stack region that the stack never
+   grows into, so that running off the end of the stack faults
+   instead of reaching whatever lies below. */
+#define STACK_GUARD (64 * 1024)
+
+/* Pages mapped at once when the stack grows one page after
+   another, as in deep recursion. */
+#define STACK_PREFETCH 4
+
+extern size_t stack_limit;
+
+struct intr_frame;
 
 tid_t process_execute (const char *file_name);
 int process_wait (tid_t);
 void process_exit (void);
 void process_activate (void);
+void *process_sbrk (intptr_t increment);
+tid_t process_fork (void);
+struct intr_frame *process_user_frame (struct thread *);
 
 /* A structure to hold arguments being passed to start_process. */
 struct process_args
@@ -2,148 +2,601 @@
 #include "devices/shutdown.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
+#include "filesys/directory.h"
 #include "filesys/inode.h"
 #include "threads/interrupt.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
+#include "userprog/process.h"
+#include "userprog/sysenter.h"
+#include "userprog/tss.h"
+#include "userprog/usermem.h"
+#ifdef VM
+#include "vm/heat.h"
+#include "vm/page.h"
+#endif
 #include <stdio.h>
+#include <flock.h>
+#include <round.h>
 #include <syscall-nr.h>
+#include <uio.h>
 
 #define STDIN 0
 #define STDOUT 1
 
 static void syscall_handler (struct intr_frame *);
-static struct lock filesys_lock;
+static void validate_buffer (void *buffer, unsigned size, bool write);
 
+/* True if sysenter was set up as a way into the kernel. */
+static bool sysenter_enabled;
+
+/* -crash-on-halt: Power off without writing back the file system when
+   a process halts, to test recovery from the journal. */
+bool halt_crashes;
+
+/* The file system layers synchronize themselves with per-object locks
+   (buffer cache entries, inodes, directories and the free map), so
+   system calls on unrelated files run concurrently. */
 void
 syscall_init (void)
 {
-  lock_init (&filesys_lock);
   intr_register_int (0x30, 3, INTR_ON, syscall_handler, "syscall");
+
+  /* User programs prefer sysenter when the kernel set it up, which
+     they ask about with `int $0x30', and fall back to that
+     otherwise. */
+  sysenter_enabled = tss_enable_sysenter (sysenter_entry);
+}
+
+/* Handles a system call made with sysenter.  F is laid out as if
+   the call had come through int $0x30. */
+void
+syscall_sysenter (struct intr_frame *f)
+{
+  syscall_handler (f);
+}
+
+/* Copies the user string USTR into a fresh page, which the caller must
+   free with palloc_free_page.  Kills the process if USTR is a bad
+   pointer or is not terminated within a page. */
+static char *
+copy_in_string (const char *ustr)
+{
+  char *kstr = palloc_get_page (0);
+  if (kstr == NULL)
+    exit (EXIT_FAILURE);
+
+  int len = strncpy_from_user (kstr, ustr, PGSIZE);
+  if (len < 0 || len == PGSIZE)
+    {
+      palloc_free_page (kstr);
+      exit (EXIT_FAILURE);
+    }
+  return kstr;
 }
 
+/* Kinds of system call argument, which say how the dispatcher
+   checks or copies an argument before the call. */
+enum syscall_arg
+  {
+    ARG_INT,      /* Plain value, passed through. */
+    ARG_STR,      /* User string, copied into a kernel page. */
+    ARG_IN_BUF,   /* User buffer the kernel reads from, with its
+                     length in the next argument. */
+    ARG_OUT_BUF,  /* User buffer the kernel writes to, with its
+                     length in the next argument. */
+    ARG_NAME_BUF  /* User buffer of NAME_MAX + 1 bytes the kernel
+                     writes to. */
+  };
+
+/* Most arguments any system call takes. */
+#define SYSCALL_MAX_ARGS 5
+
+/* A system call implementation.  ARGS holds the arguments, already
+   checked and copied as the descriptor says.  Returns the value for
+   the user's %eax. */
+typedef int syscall_func (const int *args);
+
+/* Describes a system call. */
+struct syscall
+  {
+    const char *name;                        /* For statistics. */
+    syscall_func *func;                      /* Implementation. */
+    int argc;                                /* Number of arguments. */
+    enum syscall_arg args[SYSCALL_MAX_ARGS]; /* Argument kinds. */
+  };
+
+static int sys_halt (const int *);
+static int sys_exit (const int *);
+static int sys_exec (const int *);
+static int sys_wait (const int *);
+static int sys_create (const int *);
+static int sys_remove (const int *);
+static int sys_open (const int *);
+static int sys_filesize (const int *);
+static int sys_read (const int *);
+static int sys_write (const int *);
+static int sys_seek (const int *);
+static int sys_tell (const int *);
+static int sys_close (const int *);
+static int sys_chdir (const int *);
+static int sys_mkdir (const int *);
+static int sys_readdir (const int *);
+static int sys_isdir (const int *);
+static int sys_inumber (const int *);
+static int sys_fsync (const int *);
+static int sys_fdatasync (const int *);
+static int sys_pread (const int *);
+static int sys_pwrite (const int *);
+static int sys_readv (const int *);
+static int sys_writev (const int *);
+static int sys_copy_file_range (const int *);
+static int sys_ring_enter (const int *);
+static int sys_sbrk (const int *);
+static int sys_fork (const int *);
+static int sys_flock (const int *);
+static int sys_sysenter (const int *);
+#ifdef VM
+static int sys_mmap (const int *);
+static int sys_munmap (const int *);
+static int sys_heatmap (const int *);
+#endif
+
+/* System calls, indexed by number.  Numbers without an entry are
+   not implemented. */
+static const struct syscall syscall_table[] = {
+  [SYS_HALT] = { "halt", sys_halt, 0, { 0 } },
+  [SYS_EXIT] = { "exit", sys_exit, 1, { ARG_INT } },
+  [SYS_EXEC] = { "exec", sys_exec, 1, { ARG_STR } },
+  [SYS_WAIT] = { "wait", sys_wait, 1, { ARG_INT } },
+  [SYS_CREATE] = { "create", sys_create, 2, { ARG_STR, ARG_INT } },
+  [SYS_REMOVE] = { "remove", sys_remove, 1, { ARG_STR } },
+  [SYS_OPEN] = { "open", sys_open, 1, { ARG_STR } },
+  [SYS_FILESIZE] = { "filesize", sys_filesize, 1, { ARG_INT } },
+  [SYS_READ] = { "read", sys_read, 3, { ARG_INT, ARG_OUT_BUF, ARG_INT } },
+  [SYS_WRITE] = { "write", sys_write, 3, { ARG_INT, ARG_IN_BUF, ARG_INT } },
+  [SYS_SEEK] = { "seek", sys_seek, 2, { ARG_INT, ARG_INT } },
+  [SYS_TELL] = { "tell", sys_tell, 1, { ARG_INT } },
+  [SYS_CLOSE] = { "close", sys_close, 1, { ARG_INT } },
+  [SYS_CHDIR] = { "chdir", sys_chdir, 1, { ARG_STR } },
+  [SYS_MKDIR] = { "mkdir", sys_mkdir, 1, { ARG_STR } },
+  [SYS_READDIR] = { "readdir", sys_readdir, 2, { ARG_INT, ARG_NAME_BUF } },
+  [SYS_ISDIR] = { "isdir", sys_isdir, 1, { ARG_INT } },
+  [SYS_INUMBER] = { "inumber", sys_inumber, 1, { ARG_INT } },
+  [SYS_FSYNC] = { "fsync", sys_fsync, 1, { ARG_INT } },
+  [SYS_FDATASYNC] = { "fdatasync", sys_fdatasync, 1, { ARG_INT } },
+  [SYS_PREAD] = { "pread", sys_pread, 4,
+                  { ARG_INT, ARG_OUT_BUF, ARG_INT, ARG_INT } },
+  [SYS_PWRITE] = { "pwrite", sys_pwrite, 4,
+                   { ARG_INT, ARG_IN_BUF, ARG_INT, ARG_INT } },
+  /* the iovec arrays are checked by copy_iovec */
+  [SYS_READV] = { "readv", sys_readv, 3, { ARG_INT, ARG_INT, ARG_INT } },
+  [SYS_WRITEV] = { "writev", sys_writev, 3, { ARG_INT, ARG_INT, ARG_INT } },
+  [SYS_COPY_FILE_RANGE] = { "copy_file_range", sys_copy_file_range, 5,
+                            { ARG_INT, ARG_INT, ARG_INT, ARG_INT, ARG_INT } },
+  /* the ring is accessed with copy_from_user and copy_to_user */
+  [SYS_RING_ENTER] = { "ring_enter", sys_ring_enter, 2, { ARG_INT, ARG_INT } },
+  [SYS_SBRK] = { "sbrk", sys_sbrk, 1, { ARG_INT } },
+  [SYS_FORK] = { "fork", sys_fork, 0, { 0 } },
+  [SYS_FLOCK] = { "flock", sys_flock, 2, { ARG_INT, ARG_INT } },
+  [SYS_SYSENTER] = { "sysenter", sys_sysenter, 0, { 0 } },
+#ifdef VM
+  [SYS_MMAP] = { "mmap", sys_mmap, 2, { ARG_INT, ARG_INT } },
+  [SYS_MUNMAP] = { "munmap", sys_munmap, 1, { ARG_INT } },
+  /* the heat map is copied out with copy_to_user */
+  [SYS_HEATMAP] = { "heatmap", sys_heatmap, 1, { ARG_INT } },
+#endif
+};
+
+#define SYSCALL_CNT (sizeof syscall_table / sizeof *syscall_table)
+
+/* Per system call statistics, indexed like syscall_table.  Updated
+   with interrupts off so concurrent calls don't lose counts. */
+static long long syscall_calls[SYSCALL_CNT];  /* Number of calls. */
+static long long syscall_cycles[SYSCALL_CNT]; /* Time-stamp counter
+                                                 cycles spent. */
+
+/* Returns the CPU's time-stamp counter. */
+static inline uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A"(tsc));
+  return tsc;
+}
+
+#ifdef VM
+/* Pins, if PIN is true, or unpins the user buffer that argument I of
+   system call SC points to, if it is a name buffer.  Data buffers,
+   which may be larger than memory, are pinned a page at a time by
+   file_transfer() instead.  Returns false if pinning fails because the
+   buffer is gone. */
+static bool
+pin_buffer (const struct syscall *sc, const int *args, int i, bool pin)
+{
+  void *buffer = (void *)args[i];
+
+  if (sc->args[i] != ARG_NAME_BUF)
+    return true;
+  if (!pin)
+    {
+      page_unpin (buffer, NAME_MAX + 1);
+      return true;
+    }
+  return page_pin (buffer, NAME_MAX + 1, true);
+}
+
+/* Pins, if PIN is true, or unpins the IOVCNT buffers of KIOV, writable
+   ones if WRITE is true.  Returns false, with nothing pinned, if
+   pinning fails because a buffer is gone. */
+static bool
+pin_iovec (const struct iovec *kiov, int iovcnt, bool write, bool pin)
+{
+  int i;
+
+  for (i = 0; i < iovcnt; i++)
+    if (!pin)
+      page_unpin (kiov[i].iov_base, kiov[i].iov_len);
+    else if (!page_pin (kiov[i].iov_base, kiov[i].iov_len, write))
+      {
+        pin_iovec (kiov, i, write, false);
+        return false;
+      }
+  return true;
+}
+#endif
+
+/* Reads SIZE bytes of FILE into user BUFFER, or writes them from BUFFER
+   if WRITE is true, at OFFSET, or at the file position if OFFSET is
+   negative.  Stops at the first short transfer.  Returns the number of
+   bytes transferred.
+
+   The file system touches BUFFER while holding locks that paging it in
+   would need, so it must be resident, but pinning all of a large buffer
+   at once could take every frame.  So it is transferred a page at a
+   time, with only that page pinned. */
+static off_t
+file_transfer (struct file *file, void *buffer, unsigned size,
+               off_t offset, bool write)
+{
+  off_t done = 0;
+
+  while ((unsigned)done < size)
+    {
+      uint8_t *chunk = (uint8_t *)buffer + done;
+      off_t chunk_size = PGSIZE - pg_ofs (chunk);
+      off_t bytes;
+
+      if ((unsigned)chunk_size > size - done)
+        chunk_size = size - done;
+#ifdef VM
+      if (!page_pin (chunk, chunk_size, !write))
+        exit (EXIT_FAILURE);
+#endif
+      if (offset < 0)
+        bytes = write ? file_write (file, chunk, chunk_size)
+                      : file_read (file, chunk, chunk_size);
+      else
+        bytes = write ? file_write_at (file, chunk, chunk_size, offset + done)
+                      : file_read_at (file, chunk, chunk_size, offset + done);
+#ifdef VM
+      page_unpin (chunk, chunk_size);
+#endif
+      if (bytes > 0)
+        done += bytes;
+      if (bytes < chunk_size)
+        break;
+    }
+  return done;
+}
+
+/* Fetches the system call number and its arguments from the user
+   stack, checks or copies each argument as its descriptor says,
+   and calls the implementation.  Any bad pointer kills the
+   process. */
 static void
-syscall_handler (struct intr_frame *f UNUSED)
+syscall_handler (struct intr_frame *f)
 {
+  const struct syscall *sc;
+  int args[SYSCALL_MAX_ARGS];
+  int number;
+  uint64_t start;
+  enum intr_level old_level;
 
-  struct thread *cur = thread_current ();
-  validate_page_ptr (cur->pagedir, (const void *)f->esp);
-
-  int args[3];
-  void *page_ptr;
-  int sys_code = *(int *)f->esp;
-
-  switch (sys_code)
-    {
-    case SYS_HALT:
-      halt ();
-      break;
-    case SYS_EXIT:
-      /* status */
-      get_stack_args (f, &args[0], 1);
-      exit (args[0]);
-      break;
-    case SYS_EXEC:
-      /* file name */
-      get_stack_args (f, &args[0], 1);
-      args[0] = validate_page_ptr (cur->pagedir, (const void *)args[0]);
-      f->eax = exec ((const char *)args[0]);
-      break;
-    case SYS_WAIT:
-      /* pid */
-      get_stack_args (f, &args[0], 1);
-      f->eax = (int)wait ((pid_t)args[0]);
-      break;
-    case SYS_CREATE:
-      /* file name, size */
-      get_stack_args (f, &args[0], 2);
-      validate_buffer ((void *)args[0], (unsigned *)args[1]);
-      args[0] = validate_page_ptr (cur->pagedir, (const void *)args[0]);
-      f->eax = create ((const char *)args[0], (unsigned)args[1]);
-      break;
-    case SYS_REMOVE:
-      /* file name */
-      get_stack_args (f, &args[0], 1);
-      args[0] = validate_page_ptr (cur->pagedir, (const void *)args[0]);
-      f->eax = remove ((const char *)args[0]);
-      break;
-    case SYS_WRITE:
-      /* fd, buffer, size */
-      get_stack_args (f, &args[0], 3);
-      validate_buffer ((void *)args[1], args[2]);
-      args[1] = validate_page_ptr (cur->pagedir, (const void *)args[1]);
-      f->eax = write (args[0], (void *)args[1], (unsigned)args[2]);
-      break;
-    case SYS_READ:
-      /* fd, buffer, size */
-      get_stack_args (f, &args[0], 3);
-      validate_buffer ((void *)args[1], args[2]);
-      args[1] = validate_page_ptr (cur->pagedir, (const void *)args[1]);
-      f->eax = read (args[0], (const void *)args[1], (unsigned)args[2]);
-      break;
-    case SYS_OPEN:
-      /* file name */
-      get_stack_args (f, &args[0], 1);
-      args[0] = validate_page_ptr (cur->pagedir, (const void *)args[0]);
-      f->eax = open ((const char *)args[0]);
-      break;
-    case SYS_FILESIZE:
-      /* fd */
-      get_stack_args (f, &args[0], 1);
-      f->eax = filesize (args[0]);
-      break;
-    case SYS_SEEK:
-      /* fd, position */
-      get_stack_args (f, &args[0], 2);
-      seek (args[0], (unsigned)args[1]);
-      break;
-    case SYS_TELL:
-      /* fd */
-      get_stack_args (f, &args[0], 1);
-      f->eax = tell (args[0]);
-      break;
-    case SYS_CLOSE:
-      /* fd */
-      get_stack_args (f, &args[0], 1);
-      close ((const void *)args[0]);
-      break;
-    case SYS_CHDIR:
-      /* file name */
-      get_stack_args (f, &args[0], 1);
-      f->eax = chdir (args[0]);
-      break;
-    case SYS_MKDIR:
-      /* file name */
-      get_stack_args (f, &args[0], 1);
-      f->eax = mkdir (args[0]);
-      break;
-    case SYS_READDIR:
-      /* fd, file name */
-      get_stack_args (f, &args[0], 2);
-      f->eax = readdir (args[0], args[1]);
-      break;
-    case SYS_ISDIR:
-      /* fd */
-      get_stack_args (f, &args[0], 1);
-      f->eax = isdir (args[0]);
-      break;
-    case SYS_INUMBER:
-      /* fd */
-      get_stack_args (f, &args[0], 1);
-      f->eax = inumber (args[0]);
-      break;
-    default:
+  if (!copy_from_user (&number, f->esp, sizeof number))
+    exit (EXIT_FAILURE);
+  if (number < 0 || (size_t)number >= SYSCALL_CNT
+      || syscall_table[number].func == NULL)
+    {
       printf ("ERROR: system call not implemented!");
       exit (EXIT_FAILURE);
-      break;
     }
+  sc = &syscall_table[number];
+
+  old_level = intr_disable ();
+  syscall_calls[number]++;
+  intr_set_level (old_level);
+  start = rdtsc ();
+
+  /* all the arguments in one copy, then each checked in turn.  No
+     call takes more than one string, so a later bad argument can't
+     leak a copied one. */
+  if (!copy_from_user (args, (int *)f->esp + 1, sc->argc * sizeof *args))
+    exit (EXIT_FAILURE);
+  for (int i = 0; i < sc->argc; i++)
+    switch (sc->args[i])
+      {
+      case ARG_INT:
+        break;
+      case ARG_STR:
+        args[i] = (int)copy_in_string ((const char *)args[i]);
+        break;
+      case ARG_IN_BUF:
+      case ARG_OUT_BUF:
+        ASSERT (i + 1 < sc->argc);
+        validate_buffer ((void *)args[i], args[i + 1],
+                         sc->args[i] == ARG_OUT_BUF);
+        break;
+      case ARG_NAME_BUF:
+        validate_buffer ((void *)args[i], NAME_MAX + 1, true);
+        break;
+      }
+
+#ifdef VM
+  /* name buffers stay resident for the whole call, which may access
+     them holding file system locks that paging them in would need */
+  for (int i = 0; i < sc->argc; i++)
+    if (!pin_buffer (sc, args, i, true))
+      {
+        for (int j = 0; j < i; j++)
+          pin_buffer (sc, args, j, false);
+        exit (EXIT_FAILURE);
+      }
+#endif
+
+  f->eax = sc->func (args);
+
+#ifdef VM
+  for (int i = 0; i < sc->argc; i++)
+    pin_buffer (sc, args, i, false);
+#endif
+  for (int i = 0; i < sc->argc; i++)
+    if (sc->args[i] == ARG_STR)
+      palloc_free_page ((void *)args[i]);
+
+  old_level = intr_disable ();
+  syscall_cycles[number] += rdtsc () - start;
+  intr_set_level (old_level);
 }
 
+/* Prints statistics about system calls made so far. */
+void
+syscall_print_stats (void)
+{
+  for (size_t i = 0; i < SYSCALL_CNT; i++)
+    if (syscall_calls[i] > 0)
+      printf ("Syscall: %s: %lld calls, %lld cycles\n",
+              syscall_table[i].name, syscall_calls[i], syscall_cycles[i]);
+}
+
+/* Unpacks ARGS for the system call implementations below. */
+
+static int
+sys_halt (const int *args UNUSED)
+{
+  halt ();
+  NOT_REACHED ();
+}
+
+static int
+sys_exit (const int *args)
+{
+  exit (args[0]);
+  NOT_REACHED ();
+}
+
+static int
+sys_exec (const int *args)
+{
+  return exec ((const char *)args[0]);
+}
+
+static int
+sys_wait (const int *args)
+{
+  return wait ((pid_t)args[0]);
+}
+
+static int
+sys_create (const int *args)
+{
+  return create ((const char *)args[0], (unsigned)args[1]);
+}
+
+static int
+sys_remove (const int *args)
+{
+  return remove ((const char *)args[0]);
+}
+
+static int
+sys_open (const int *args)
+{
+  return open ((const char *)args[0]);
+}
+
+static int
+sys_filesize (const int *args)
+{
+  return filesize (args[0]);
+}
+
+static int
+sys_read (const int *args)
+{
+  return read (args[0], (void *)args[1], (unsigned)args[2]);
+}
+
+static int
+sys_write (const int *args)
+{
+  return write (args[0], (const void *)args[1], (unsigned)args[2]);
+}
+
+static int
+sys_seek (const int *args)
+{
+  seek (args[0], (unsigned)args[1]);
+  return 0;
+}
+
+static int
+sys_tell (const int *args)
+{
+  return tell (args[0]);
+}
+
+static int
+sys_close (const int *args)
+{
+  close (args[0]);
+  return 0;
+}
+
+static int
+sys_chdir (const int *args)
+{
+  return chdir ((const char *)args[0]);
+}
+
+static int
+sys_mkdir (const int *args)
+{
+  return mkdir ((const char *)args[0]);
+}
+
+static int
+sys_readdir (const int *args)
+{
+  return readdir (args[0], (char *)args[1]);
+}
+
+static int
+sys_isdir (const int *args)
+{
+  return isdir (args[0]);
+}
+
+static int
+sys_inumber (const int *args)
+{
+  return inumber (args[0]);
+}
+
+static int
+sys_fsync (const int *args)
+{
+  return fsync (args[0]);
+}
+
+static int
+sys_fdatasync (const int *args)
+{
+  return fdatasync (args[0]);
+}
+
+static int
+sys_pread (const int *args)
+{
+  return pread (args[0], (void *)args[1], (unsigned)args[2],
+                (unsigned)args[3]);
+}
+
+static int
+sys_pwrite (const int *args)
+{
+  return pwrite (args[0], (const void *)args[1], (unsigned)args[2],
+                 (unsigned)args[3]);
+}
+
+static int
+sys_readv (const int *args)
+{
+  return readv (args[0], (const struct iovec *)args[1], args[2]);
+}
+
+static int
+sys_writev (const int *args)
+{
+  return writev (args[0], (const struct iovec *)args[1], args[2]);
+}
+
+static int
+sys_copy_file_range (const int *args)
+{
+  return copy_file_range (args[0], (unsigned)args[1], args[2],
+                          (unsigned)args[3], (unsigned)args[4]);
+}
+
+static int
+sys_ring_enter (const int *args)
+{
+  return ring_enter ((struct ring *)args[0], (unsigned)args[1]);
+}
+
+static int
+sys_sbrk (const int *args)
+{
+  return (int)process_sbrk (args[0]);
+}
+
+static int
+sys_fork (const int *args UNUSED)
+{
+  return fork ();
+}
+
+static int
+sys_flock (const int *args)
+{
+  return flock (args[0], args[1]);
+}
+
+static int
+sys_sysenter (const int *args UNUSED)
+{
+  return sysenter_enabled;
+}
+
+#ifdef VM
+static int
+sys_mmap (const int *args)
+{
+  return mmap (args[0], (void *)args[1]);
+}
+
+static int
+sys_munmap (const int *args)
+{
+  munmap (args[0]);
+  return 0;
+}
+
+static int
+sys_heatmap (const int *args)
+{
+  return heatmap ((struct heatmap *)args[0]);
+}
+#endif
+
 void
 halt (void)
 {
+  if (halt_crashes)
+    shutdown_power_cut ();
   shutdown_power_off ();
 }
 
@@ -164,6 +617,12 @@ wait (pid_t pid)
   return process_wait (pid);
 }
 
+pid_t
+fork (void)
+{
+  return process_fork ();
+}
+
 pid_t
 exec (const char *cmd_line)
 {
@@ -171,9 +630,7 @@ exec (const char *cmd_line)
     {
       return EXIT_FAILURE;
     }
-  lock_acquire (&filesys_lock);
   pid_t child_tid = process_execute (cmd_line);
-  lock_release (&filesys_lock);
   return child_tid;
 }
 
@@ -187,7 +644,7 @@ write (int fd, const void *buffer, unsigned size)
       return size;
     }
 
-  if (fd == STDIN || list_empty (&cur->open_files))
+  if (fd == STDIN)
     {
       return 0;
     }
@@ -197,26 +654,21 @@ write (int fd, const void *buffer, unsigned size)
       return size;
     }
 
-  lock_acquire (&filesys_lock);
   struct open_file *of = find_open_file (fd, cur);
   if (of == NULL)
     {
-      lock_release (&filesys_lock);
       return EXIT_FAILURE;
     }
 
-  int bytes = (int)file_write (of->file, buffer, size);
+  int bytes = (int)file_transfer (of->file, (void *)buffer, size, -1, true);
 
-  lock_release (&filesys_lock);
   return bytes;
 };
 
 bool
 create (const char *file, unsigned initial_size)
 {
-  lock_acquire (&filesys_lock);
   bool status = filesys_create (file, initial_size, false);
-  lock_release (&filesys_lock);
   return status;
 };
 
@@ -225,9 +677,7 @@ remove (const char *file)
 {
   if (file == NULL)
     return EXIT_FAILURE;
-  lock_acquire (&filesys_lock);
   bool status = filesys_remove (file);
-  lock_release (&filesys_lock);
   return status;
 }
 
@@ -239,23 +689,24 @@ open (const char *file)
   struct thread *cur = thread_current ();
 
   /* allocate open_file struct */
-  struct open_file *of = palloc_get_page (PAL_ZERO);
+  struct open_file *of = malloc (sizeof *of);
   if (of == NULL)
     return EXIT_FAILURE;
 
-  lock_acquire (&filesys_lock);
   of->file = filesys_open (file);
   if (of->file == NULL)
     {
-      palloc_free_page (of);
-      lock_release (&filesys_lock);
+      free (of);
       return EXIT_FAILURE;
     }
 
-  of->fd = cur->cur_fd;
-  cur->cur_fd++;
-  list_push_front (&cur->open_files, &of->elem);
-  lock_release (&filesys_lock);
+  /* take the lowest free descriptor */
+  if (add_open_file (of, cur) < 0)
+    {
+      file_close (of->file);
+      free (of);
+      return EXIT_FAILURE;
+    }
   return of->fd;
 }
 
@@ -264,17 +715,14 @@ filesize (int fd)
 {
   struct thread *cur = thread_current ();
 
-  lock_acquire (&filesys_lock);
   struct open_file *of = find_open_file (fd, cur);
 
   if (of == NULL)
     {
-      lock_release (&filesys_lock);
       return EXIT_FAILURE;
     }
 
   int length = file_length (of->file);
-  lock_release (&filesys_lock);
   return length;
 }
 
@@ -282,30 +730,25 @@ int
 read (int fd, void *buffer, unsigned size)
 {
   struct thread *cur = thread_current ();
-  lock_acquire (&filesys_lock);
 
   if (fd == STDIN)
     {
-      lock_release (&filesys_lock);
       return (int)input_getc ();
     }
 
   /* can't read from STDOUT or non-existent file */
-  if (fd == STDOUT || list_empty (&cur->open_files))
+  if (fd == STDOUT)
     {
-      lock_release (&filesys_lock);
       return 0;
     }
 
   struct open_file *of = find_open_file (fd, cur);
   if (of == NULL)
     {
-      lock_release (&filesys_lock);
       return EXIT_FAILURE;
     }
 
-  lock_release (&filesys_lock);
-  int bytes = (int)file_read (of->file, buffer, size);
+  int bytes = (int)file_transfer (of->file, buffer, size, -1, false);
   return bytes;
 }
 
@@ -313,20 +756,12 @@ void
 seek (int fd, unsigned position)
 {
   struct thread *cur = thread_current ();
-  lock_acquire (&filesys_lock);
-  if (list_empty (&cur->open_files))
-    {
-      lock_release (&filesys_lock);
-      return;
-    }
   struct open_file *of = find_open_file (fd, cur);
   if (of == NULL)
     {
-      lock_release (&filesys_lock);
       return;
     }
   file_seek (of->file, position);
-  lock_release (&filesys_lock);
 
   return;
 }
@@ -335,20 +770,12 @@ unsigned
 tell (int fd)
 {
   struct thread *cur = thread_current ();
-  lock_acquire (&filesys_lock);
-  if (list_empty (&cur->open_files))
-    {
-      lock_release (&filesys_lock);
-      return EXIT_FAILURE;
-    }
   struct open_file *of = find_open_file (fd, cur);
   if (of == NULL)
     {
-      lock_release (&filesys_lock);
       return EXIT_FAILURE;
     }
   unsigned pos = file_tell (of->file);
-  lock_release (&filesys_lock);
 
   return pos;
 }
@@ -357,21 +784,13 @@ void
 close (int fd)
 {
   struct thread *cur = thread_current ();
-  lock_acquire (&filesys_lock);
-  if (list_empty (&cur->open_files))
-    {
-      lock_release (&filesys_lock);
-      return;
-    }
-  struct open_file *of = find_open_file (fd, cur);
+  struct open_file *of = remove_open_file (fd, cur);
   if (of == NULL)
     {
-      lock_release (&filesys_lock);
       return;
     }
   file_close (of->file);
-  list_remove (&of->elem);
-  lock_release (&filesys_lock);
+  free (of);
 
   return;
 }
@@ -385,9 +804,7 @@ chdir (const char *dir)
 bool
 mkdir (const char *dir)
 {
-  lock_acquire (&filesys_lock);
   bool ret = filesys_create (dir, 0, true);
-  lock_release (&filesys_lock);
 
   return ret;
 }
@@ -402,17 +819,14 @@ bool
 isdir (int fd)
 {
   struct thread *cur = thread_current ();
-  lock_acquire (&filesys_lock);
 
   struct open_file *of = find_open_file (fd, cur);
   if (of == NULL)
     {
-      lock_release (&filesys_lock);
       return EXIT_FAILURE;
     }
   bool ret = (int)inode_is_directory (file_get_inode (of->file));
 
-  lock_release (&filesys_lock);
   return ret;
 }
 
@@ -420,64 +834,438 @@ int
 inumber (int fd)
 {
   struct thread *cur = thread_current ();
-  lock_acquire (&filesys_lock);
 
   struct open_file *of = find_open_file (fd, cur);
   if (of == NULL)
     {
-      lock_release (&filesys_lock);
       return EXIT_FAILURE;
     }
   int ret = (int)inode_get_inumber (file_get_inode (of->file));
 
-  lock_release (&filesys_lock);
   return ret;
 }
 
+/* Writes the file's dirty data and metadata sectors to disk, leaving the
+ * rest of the buffer cache alone. */
 int
-validate_page_ptr (uint32_t pagedir, const void *page_ptr)
+fsync (int fd)
 {
-  page_ptr = pagedir_get_page (pagedir, (const void *)page_ptr);
+  struct thread *cur = thread_current ();
 
-  if (page_ptr == NULL)
+  struct open_file *of = find_open_file (fd, cur);
+  if (of == NULL)
+    {
+      return EXIT_FAILURE;
+    }
+  file_sync (of->file, false);
+
+  return 0;
+}
+
+/* Like fsync, but skips the metadata unless it is needed to read the data
+ * back. */
+int
+fdatasync (int fd)
+{
+  struct thread *cur = thread_current ();
+
+  struct open_file *of = find_open_file (fd, cur);
+  if (of == NULL)
+    {
+      return EXIT_FAILURE;
+    }
+  file_sync (of->file, true);
+
+  return 0;
+}
+
+/* Reads SIZE bytes at OFFSET in the file into BUFFER without moving the
+ * file position. */
+int
+pread (int fd, void *buffer, unsigned size, unsigned offset)
+{
+  struct thread *cur = thread_current ();
+
+  struct open_file *of = find_open_file (fd, cur);
+  if (of == NULL || (off_t)offset < 0)
+    {
+      return EXIT_FAILURE;
+    }
+
+  return (int)file_transfer (of->file, buffer, size, offset, false);
+}
+
+/* Writes SIZE bytes from BUFFER at OFFSET in the file without moving the
+ * file position. */
+int
+pwrite (int fd, const void *buffer, unsigned size, unsigned offset)
+{
+  struct thread *cur = thread_current ();
+
+  struct open_file *of = find_open_file (fd, cur);
+  if (of == NULL || (off_t)offset < 0)
+    {
+      return EXIT_FAILURE;
+    }
+
+  return (int)file_transfer (of->file, (void *)buffer, size, offset, true);
+}
+
+/* Copies the user's IOVCNT-element array IOV into KIOV and validates
+ * every buffer it describes, writable ones if WRITE is true.  Returns
+ * false if IOVCNT is out of range. */
+static bool
+copy_iovec (struct iovec *kiov, const struct iovec *iov, int iovcnt,
+            bool write)
+{
+  int i;
+
+  if (iovcnt < 0 || iovcnt > IOV_MAX)
+    return false;
+
+  if (!copy_from_user (kiov, iov, iovcnt * sizeof *iov))
+    exit (EXIT_FAILURE);
+  for (i = 0; i < iovcnt; i++)
+    validate_buffer (kiov[i].iov_base, kiov[i].iov_len, write);
+  return true;
+}
+
+/* Reads from the file into IOVCNT buffers in one pass, advancing the file
+ * position. */
+int
+readv (int fd, const struct iovec *iov, int iovcnt)
+{
+  struct thread *cur = thread_current ();
+  struct iovec kiov[IOV_MAX];
+  int bytes;
+
+  if (!copy_iovec (kiov, iov, iovcnt, true))
+    {
+      return EXIT_FAILURE;
+    }
+
+  struct open_file *of = find_open_file (fd, cur);
+  if (of == NULL)
+    {
+      return EXIT_FAILURE;
+    }
+
+#ifdef VM
+  /* as in file_transfer(), since evicting a page may write it back to
+     its file */
+  if (!pin_iovec (kiov, iovcnt, true, true))
     exit (EXIT_FAILURE);
+#endif
+  bytes = (int)file_readv (of->file, kiov, iovcnt);
+#ifdef VM
+  pin_iovec (kiov, iovcnt, true, false);
+#endif
+  return bytes;
+}
+
+/* Writes IOVCNT buffers to the file in one pass, advancing the file
+ * position. */
+int
+writev (int fd, const struct iovec *iov, int iovcnt)
+{
+  struct thread *cur = thread_current ();
+  struct iovec kiov[IOV_MAX];
+  int i, bytes = 0;
+
+  if (!copy_iovec (kiov, iov, iovcnt, false))
+    {
+      return EXIT_FAILURE;
+    }
 
-  return (int)page_ptr;
+  if (fd == STDOUT)
+    {
+      for (i = 0; i < iovcnt; i++)
+        {
+          putbuf (kiov[i].iov_base, kiov[i].iov_len);
+          bytes += kiov[i].iov_len;
+        }
+      return bytes;
+    }
+
+  struct open_file *of = find_open_file (fd, cur);
+  if (of == NULL)
+    {
+      return EXIT_FAILURE;
+    }
+
+#ifdef VM
+  if (!pin_iovec (kiov, iovcnt, false, true))
+    exit (EXIT_FAILURE);
+#endif
+  bytes = (int)file_writev (of->file, kiov, iovcnt);
+#ifdef VM
+  pin_iovec (kiov, iovcnt, false, false);
+#endif
+  return bytes;
 }
 
-/* Validates that the provided address exists and is within the user address
- * space. */
-void
-validate_addr (const void *addr)
+/* Copies SIZE bytes at OFF_IN in one file to OFF_OUT in another without
+ * bouncing the data through user memory.  Neither file position moves.
+ * Returns the number of bytes copied, 0 only at end of the input file,
+ * or -1 on failure. */
+int
+copy_file_range (int fd_in, unsigned off_in, int fd_out, unsigned off_out,
+                 unsigned size)
 {
-  if (addr == NULL || !is_user_vaddr (addr) || addr < 0x08048000)
+  struct thread *cur = thread_current ();
+
+  struct open_file *in = find_open_file (fd_in, cur);
+  struct open_file *out = find_open_file (fd_out, cur);
+  if (in == NULL || out == NULL || (off_t)off_in < 0 || (off_t)off_out < 0
+      || (off_t)size < 0)
     {
-      exit (EXIT_FAILURE);
+      return EXIT_FAILURE;
+    }
+
+  /* overlapping ranges of the same file are not allowed */
+  if (file_get_inode (in->file) == file_get_inode (out->file)
+      && off_in < off_out + size && off_out < off_in + size)
+    {
+      return EXIT_FAILURE;
     }
-};
 
-/* Validates all addresses within the provided buffer. */
+  return (int)file_copy_range (in->file, off_in, out->file, off_out, size);
+}
+
+/* Takes, converts or drops an advisory lock on the whole file, as
+ * OPERATION says, like BSD flock.  The lock belongs to the open file, so
+ * a forked child shares it, and closing the last descriptor drops it.
+ * Fails if OPERATION is not valid, or if it has LOCK_NB and another open
+ * file holds a conflicting lock. */
+int
+flock (int fd, int operation)
+{
+  struct thread *cur = thread_current ();
+
+  struct open_file *of = find_open_file (fd, cur);
+  if (of == NULL)
+    {
+      return EXIT_FAILURE;
+    }
+
+  switch (operation & ~LOCK_NB)
+    {
+    case LOCK_SH:
+    case LOCK_EX:
+      if (!file_flock (of->file, (operation & LOCK_EX) != 0,
+                       (operation & LOCK_NB) != 0))
+        return EXIT_FAILURE;
+      return 0;
+    case LOCK_UN:
+      file_funlock (of->file);
+      return 0;
+    default:
+      return EXIT_FAILURE;
+    }
+}
+
+#ifdef VM
+/* Maps the file open as FD into memory at ADDR, which must be page
+ * aligned and not 0, over pages the process does not use yet and below
+ * the stack region.  Pages are read in when first touched and written
+ * back to the file only if they were written.  The mapping has its own
+ * handle on the file, so it outlives FD.  Returns the mapping's id, or
+ * -1 if the file is empty or a directory or the pages are not free. */
+int
+mmap (int fd, void *addr)
+{
+  struct thread *cur = thread_current ();
+  uint8_t *start = addr;
+  uint8_t *stack_bottom = (uint8_t *)PHYS_BASE - STACK_MAX;
+
+  struct open_file *of = find_open_file (fd, cur);
+  if (of == NULL || start == NULL || pg_ofs (start) != 0
+      || start >= stack_bottom
+      || inode_is_directory (file_get_inode (of->file)))
+    {
+      return EXIT_FAILURE;
+    }
+
+  off_t length = file_length (of->file);
+  if (length == 0 || length > stack_bottom - start)
+    {
+      return EXIT_FAILURE;
+    }
+
+  struct file_mapping *m = malloc (sizeof *m);
+  if (m == NULL)
+    {
+      return EXIT_FAILURE;
+    }
+  m->file = file_reopen (of->file);
+  if (m->file == NULL || !page_add_mapping (m->file, length, start))
+    {
+      file_close (m->file);
+      free (m);
+      return EXIT_FAILURE;
+    }
+
+  m->id = cur->next_mapid++;
+  m->start = start;
+  m->page_count = DIV_ROUND_UP (length, PGSIZE);
+  list_push_back (&cur->mappings, &m->elem);
+  return m->id;
+}
+
+/* Removes mapping M of the current process, writing its pages back to
+ * the file if they were written. */
+static void
+unmap (struct file_mapping *m)
+{
+  page_unmap (m->start, m->page_count);
+  list_remove (&m->elem);
+  file_close (m->file);
+  free (m);
+}
+
+/* Removes the mapping with id MAPPING, if the current process has
+ * one. */
 void
-validate_buffer (void *buffer, unsigned size)
+munmap (int mapping)
 {
-  int i;
-  char *ptr = (char *)buffer;
-  for (i = 0; i < size; i++)
+  struct thread *cur = thread_current ();
+  struct list_elem *e;
+
+  for (e = list_begin (&cur->mappings); e != list_end (&cur->mappings);
+       e = list_next (e))
     {
-      validate_addr ((const void *)ptr);
-      ptr++;
+      struct file_mapping *m = list_entry (e, struct file_mapping, elem);
+      if (m->id == mapping)
+        {
+          unmap (m);
+          return;
+        }
     }
 }
 
-/* Pulls the arguments for this command from the stack. */
+/* Removes all the current process's mappings, as it exits. */
 void
-get_stack_args (struct intr_frame *f, int *argv, int argc)
+munmap_all (void)
+{
+  struct thread *cur = thread_current ();
+
+  while (!list_empty (&cur->mappings))
+    unmap (list_entry (list_front (&cur->mappings), struct file_mapping,
+                       elem));
+}
+#endif
+
+/* Copies SIZE bytes from user address USRC to DST, killing the
+   process if USRC is a bad pointer. */
+static void
+get_user_bytes (void *dst, const void *usrc, size_t size)
+{
+  if (!copy_from_user (dst, usrc, size))
+    exit (EXIT_FAILURE);
+}
+
+/* Copies SIZE bytes from SRC to user address UDST, killing the
+   process if UDST is a bad pointer. */
+static void
+put_user_bytes (void *udst, const void *src, size_t size)
+{
+  if (!copy_to_user (udst, src, size))
+    exit (EXIT_FAILURE);
+}
+
+/* Carries out the operation described by SQE, checking its
+   pointers as the system call it stands for would, and returns
+   that system call's result. */
+static int
+ring_execute (const struct ring_sqe *sqe)
+{
+  char *name;
+  int result;
+
+  switch (sqe->op)
+    {
+    case RING_OP_READ:
+    case RING_OP_WRITE:
+      /* read() and write() pin the buffer a page at a time */
+      validate_buffer (sqe->buf, sqe->len, sqe->op == RING_OP_READ);
+      if (sqe->op == RING_OP_READ)
+        result = read (sqe->fd, sqe->buf, sqe->len);
+      else
+        result = write (sqe->fd, sqe->buf, sqe->len);
+      return result;
+    case RING_OP_OPEN:
+      name = copy_in_string (sqe->buf);
+      result = open (name);
+      palloc_free_page (name);
+      return result;
+    case RING_OP_CLOSE:
+      close (sqe->fd);
+      return 0;
+    default:
+      return EXIT_FAILURE;
+    }
+}
+
+/* Carries out up to TO_SUBMIT queued operations from RING's
+   submission queue in order, posting a completion for each, so a
+   process can batch many small reads and writes into one trap.
+   Stops early if the completion queue fills up.  Returns the
+   number of operations carried out.
+
+   The operations run synchronously in the calling thread, whose
+   page directory and file descriptor table they need. */
+int
+ring_enter (struct ring *ring, unsigned to_submit)
 {
-  int i, *ptr;
-  for (i = 0; i < argc; i++)
+  unsigned sq_head, sq_tail, cq_head, cq_tail;
+  struct ring_sqe sqe;
+  struct ring_cqe cqe;
+  unsigned done;
+
+  get_user_bytes (&sq_head, &ring->sq_head, sizeof sq_head);
+  get_user_bytes (&sq_tail, &ring->sq_tail, sizeof sq_tail);
+  get_user_bytes (&cq_head, &ring->cq_head, sizeof cq_head);
+  get_user_bytes (&cq_tail, &ring->cq_tail, sizeof cq_tail);
+
+  for (done = 0; done < to_submit && sq_head != sq_tail
+                 && cq_tail - cq_head < RING_ENTRIES;
+       done++)
     {
-      ptr = (int *)f->esp + i + 1;
-      validate_addr ((const void *)ptr);
-      argv[i] = *ptr;
+      get_user_bytes (&sqe, &ring->sq[sq_head++ % RING_ENTRIES],
+                      sizeof sqe);
+      cqe.user_data = sqe.user_data;
+      cqe.result = ring_execute (&sqe);
+      put_user_bytes (&ring->cq[cq_tail++ % RING_ENTRIES], &cqe,
+                      sizeof cqe);
     }
-}
\ No newline at end of file
+
+  put_user_bytes (&ring->sq_head, &sq_head, sizeof sq_head);
+  put_user_bytes (&ring->cq_tail, &cq_tail, sizeof cq_tail);
+  return done;
+}
+
+#ifdef VM
+/* Copies the latest heat map of the current process's memory to
+ * HEATMAP.  Returns -1 if the kernel does not sample memory heat. */
+int
+heatmap (struct heatmap *heatmap)
+{
+  struct heatmap h;
+
+  if (!heat_get (&h))
+    {
+      return EXIT_FAILURE;
+    }
+  put_user_bytes (heatmap, &h, sizeof h);
+  return 0;
+}
+#endif
+
+/* Kills the process unless the SIZE bytes at user address BUFFER are
+ * mapped, and writable if WRITE is true.  Checks one byte per page. */
+static void
+validate_buffer (void *buffer, unsigned size, bool write)
+{
+  if (!user_range_ok (buffer, size, write))
+    exit (EXIT_FAILURE);
+}
@@ -2,6 +2,8 @@
 #define USERPROG_SYSCALL_H
 
 #include "filesys/file.h"
+#include <heat.h>
+#include <ring.h>
 #include <list.h>
 #include <stdbool.h>
 
@@ -10,27 +12,36 @@
 
 typedef int pid_t;
 
+/* An entry in a thread's file descriptor table (thread.fds).  File
+   descriptors 0 and 1 are the console and never have an entry. */
+#define FD_MIN 2
+#define FD_TABLE_INIT 16 /* Initial number of slots in a table. */
+
 struct open_file
 {
   int fd;
   struct file *file;
-  struct list_elem elem;
 };
 
+/* A file a process has mapped into memory (thread.mappings). */
 struct file_mapping
 {
-  int id;
-  struct file *file;
-  struct list_elem elem;
-  uint8_t *start;
-  size_t page_count;
+  int id;                /* Mapping id returned by mmap. */
+  struct file *file;     /* The mapping's own handle on the file. */
+  struct list_elem elem; /* Element in thread.mappings. */
+  uint8_t *start;        /* First mapped page. */
+  size_t page_count;     /* Number of mapped pages. */
 };
 
+extern bool halt_crashes;
+
 void syscall_init (void);
+void syscall_print_stats (void);
 
 void halt (void);
 void exit (int status);
 pid_t exec (const char *cmd_line);
+pid_t fork (void);
 int wait (pid_t pid);
 bool create (const char *file, unsigned initial_size);
 bool remove (const char *file);
@@ -49,4 +60,30 @@ bool readdir (int fd, char *name);
 bool isdir (int fd);
 int inumber (int fd);
 
+/* durability */
+int fsync (int fd);
+int fdatasync (int fd);
+
+/* positional and vectored I/O */
+int pread (int fd, void *buffer, unsigned size, unsigned offset);
+int pwrite (int fd, const void *buffer, unsigned size, unsigned offset);
+int readv (int fd, const struct iovec *iov, int iovcnt);
+int writev (int fd, const struct iovec *iov, int iovcnt);
+int copy_file_range (int fd_in, unsigned off_in, int fd_out,
+                     unsigned off_out, unsigned size);
+
+/* batched submission */
+int ring_enter (struct ring *ring, unsigned to_submit);
+
+/* advisory locking */
+int flock (int fd, int operation);
+
+/* memory-mapped files */
+int mmap (int fd, void *addr);
+void munmap (int mapping);
+void munmap_all (void);
+
+/* memory profiling */
+int heatmap (struct heatmap *heatmap);
+
 #endif /* userprog/syscall.h */
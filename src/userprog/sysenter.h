@@ -0,0 +1,15 @@
+#ifndef USERPROG_SYSENTER_H
+#define USERPROG_SYSENTER_H
+
+struct intr_frame;
+
+/* Fast system call entry point, in sysenter.S.  Reached by the
+   sysenter instruction once syscall_init() has passed it to
+   tss_enable_sysenter(). */
+void sysenter_entry (void);
+
+/* System call handler called by sysenter_entry() with the frame
+   it builds on the kernel stack. */
+void syscall_sysenter (struct intr_frame *);
+
+#endif /* userprog/sysenter.h */
@@ -75,6 +75,22 @@ struct tss
 /* Kernel TSS. */
 static struct tss *tss;
 
+/* Model-specific registers that control sysenter. */
+#define MSR_SYSENTER_CS  0x174  /* Kernel code selector. */
+#define MSR_SYSENTER_ESP 0x175  /* Kernel stack pointer. */
+#define MSR_SYSENTER_EIP 0x176  /* Kernel entry point. */
+
+/* True once sysenter has been enabled, in which case
+   tss_update() keeps MSR_SYSENTER_ESP in step with esp0. */
+static bool sysenter_enabled;
+
+/* Writes VALUE to model-specific register MSR. */
+static inline void
+wrmsr (uint32_t msr, uint32_t value) 
+{
+  asm volatile ("wrmsr" : : "c" (msr), "a" (value), "d" (0));
+}
+
 /* Initializes the kernel TSS. */
 void
 tss_init (void) 
@@ -103,4 +119,38 @@ tss_update (void)
 {
   ASSERT (tss != NULL);
   tss->esp0 = (uint8_t *) thread_current () + PGSIZE;
+  if (sysenter_enabled)
+    wrmsr (MSR_SYSENTER_ESP, (uint32_t) tss->esp0);
+}
+
+/* If the CPU supports the sysenter and sysexit instructions,
+   directs sysenter to ENTRY, running on the same ring 0 stack
+   that the TSS provides for interrupts, and returns true.
+   Otherwise returns false, and user programs must enter the
+   kernel with an interrupt. */
+bool
+tss_enable_sysenter (void (*entry) (void)) 
+{
+  uint32_t eax, ebx, ecx, edx;
+  unsigned family, model, stepping;
+
+  asm ("cpuid" : "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx) : "a" (1));
+  family = (eax >> 8) & 0xf;
+  model = (eax >> 4) & 0xf;
+  stepping = eax & 0xf;
+
+  /* Early Pentium Pros set the SEP bit without implementing the
+     instructions. */
+  if ((edx & (1u << 11)) == 0
+      || (family == 6 && model < 3 && stepping < 3))
+    return false;
+
+  /* sysenter loads %ss from the selector after SEL_KCSEG, and
+     sysexit loads %cs and %ss from the two after that, which is
+     exactly the layout of our GDT. */
+  wrmsr (MSR_SYSENTER_CS, SEL_KCSEG);
+  wrmsr (MSR_SYSENTER_EIP, (uint32_t) entry);
+  sysenter_enabled = true;
+  tss_update ();
+  return true;
 }
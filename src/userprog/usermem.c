@@ -0,0 +1,138 @@
+#include "userprog/usermem.h"
+#include "threads/vaddr.h"
+#include <stdint.h>
+#include <string.h>
+
+/* Access to user memory from the kernel.
+
+   Instead of walking the page table, the kernel simply touches user
+   memory and lets the MMU check it.  The probes below load the address
+   of their own end into EAX before the access; if the access faults,
+   page_fault in userprog/exception.c sees a kernel-mode fault on a user
+   address inside a probe, resumes at that address, and sets EAX to -1.
+
+   A range is checked with one probe per page it touches, after which
+   it is copied with memcpy.  Eviction on behalf of another process can
+   unmap a page between the probe and the copy, but the page is still
+   the process's: the copy faults it back in like any other access, so
+   only faults inside the probes are failures. */
+
+/* The probes are out of line, between two labels, so that page_fault
+   can tell a fault in one of them from a kernel bug.  Each returns -1
+   if the access faulted. */
+int usermem_get_user (const uint8_t *uaddr);
+int usermem_put_user (uint8_t *udst, uint8_t byte);
+
+asm (".text\n"
+     "usermem_probe_start:\n"
+     ".globl usermem_get_user\n"
+     "usermem_get_user:\n"
+     "  movl 4(%esp), %edx\n"
+     "  movl $1f, %eax\n"
+     "  movzbl (%edx), %eax\n"
+     "1:ret\n"
+     ".globl usermem_put_user\n"
+     "usermem_put_user:\n"
+     "  movl 4(%esp), %edx\n"
+     "  movl 8(%esp), %ecx\n"
+     "  movl $1f, %eax\n"
+     "  movb %cl, (%edx)\n"
+     "1:ret\n"
+     "usermem_probe_end:\n");
+
+extern const char usermem_probe_start[], usermem_probe_end[];
+
+/* Returns true if EIP is inside one of the probes. */
+bool
+usermem_probe_at (const void *eip)
+{
+  return (const char *)eip >= usermem_probe_start
+         && (const char *)eip < usermem_probe_end;
+}
+
+/* Reads a byte at user virtual address UADDR, which must be below
+   PHYS_BASE.  Returns the byte value if successful, -1 if a fault
+   occurred. */
+static inline int
+get_user (const uint8_t *uaddr)
+{
+  return usermem_get_user (uaddr);
+}
+
+/* Writes BYTE to user address UDST, which must be below PHYS_BASE.
+   Returns true if successful, false if a fault occurred. */
+static inline bool
+put_user (uint8_t *udst, uint8_t byte)
+{
+  return usermem_put_user (udst, byte) != -1;
+}
+
+/* Returns true if the SIZE bytes at user address UADDR are mapped, and
+   writable if WRITE is true.  Touches one byte per page. */
+bool
+user_range_ok (const void *uaddr, size_t size, bool write)
+{
+  const uint8_t *p = uaddr;
+  const uint8_t *end = p + size;
+
+  if (size == 0)
+    return true;
+  if (end < p || !is_user_vaddr (end - 1))
+    return false;
+
+  while (p < end)
+    {
+      int byte = get_user (p);
+      if (byte == -1 || (write && !put_user ((uint8_t *)p, byte)))
+        return false;
+
+      /* on to the next page */
+      p = (const uint8_t *)pg_round_down (p) + PGSIZE;
+    }
+  return true;
+}
+
+/* Copies SIZE bytes from user address USRC to kernel address DST.
+   Returns false, having copied nothing, if the user range is bad. */
+bool
+copy_from_user (void *dst, const void *usrc, size_t size)
+{
+  if (!user_range_ok (usrc, size, false))
+    return false;
+  memcpy (dst, usrc, size);
+  return true;
+}
+
+/* Copies SIZE bytes from kernel address SRC to user address UDST.
+   Returns false, having copied nothing, if the user range is bad. */
+bool
+copy_to_user (void *udst, const void *src, size_t size)
+{
+  if (!user_range_ok (udst, size, true))
+    return false;
+  memcpy (udst, src, size);
+  return true;
+}
+
+/* Copies the null-terminated string at user address USRC into DST,
+   which has room for SIZE bytes including the terminator.  Returns the
+   string's length, SIZE if it does not fit (DST is then not
+   terminated), or -1 if the string runs into a bad address. */
+int
+strncpy_from_user (char *dst, const char *usrc, size_t size)
+{
+  const uint8_t *p = (const uint8_t *)usrc;
+  size_t i;
+
+  for (i = 0; i < size; i++)
+    {
+      int byte;
+
+      if (!is_user_vaddr (p + i) || (byte = get_user (p + i)) == -1)
+        return -1;
+      dst[i] = byte;
+      if (byte == '\0')
+        return i;
+    }
+  return size;
+}
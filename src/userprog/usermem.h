@@ -0,0 +1,13 @@
+#ifndef USERPROG_USERMEM_H
+#define USERPROG_USERMEM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+bool user_range_ok (const void *uaddr, size_t size, bool write);
+bool copy_from_user (void *dst, const void *usrc, size_t size);
+bool copy_to_user (void *udst, const void *src, size_t size);
+int strncpy_from_user (char *dst, const char *usrc, size_t size);
+bool usermem_probe_at (const void *eip);
+
+#endif /* userprog/usermem.h */
@@ -0,0 +1,316 @@
+#include "vm/frame.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/exec-cache.h"
+#include "userprog/pagedir.h"
+#include "vm/page.h"
+#include <debug.h>
+#include <round.h>
+#include <string.h>
+
+/* A physical frame, as the frame table sees it.  A frame is owned
+   when exactly one process maps it, at UPAGE, and only an owned
+   frame that is not pinned can be evicted.  Frames shared after
+   fork or through the executable cache have no owner and stay
+   resident, but when the pool runs out the cache first gives back
+   the frames of executables no process is running.  A frame shared
+   by fork goes back to the one process left mapping it once the
+   others have copied it or exited. */
+struct frame
+{
+  struct thread *owner; /* Process mapping the frame, or null. */
+  void *upage;          /* Where OWNER maps it, or where the processes
+                           sharing it since fork all map it. */
+  int pin_cnt;          /* Reasons the frame may not be evicted. */
+};
+
+/* The frame table, indexed by physical page number, so finding the
+   entry of a frame takes no search. */
+static struct frame *frames;
+
+/* Next entry the clock hand looks at. */
+static size_t clock_hand;
+
+/* Protects the frame table, and the supplemental page tables and
+   user mappings of every process, since eviction changes those of
+   whichever process owns the victim.  May be acquired while holding
+   an executable image's lock, but not the other way around. */
+static struct lock frame_lock;
+
+/* Signaled, with frame_lock, when page_evict() has finished writing
+   pages out. */
+static struct condition frame_written;
+
+static void *frame_evict (void);
+
+/* Returns the entry for frame KPAGE. */
+static struct frame *
+frame_of (void *kpage)
+{
+  ASSERT (pg_ofs (kpage) == 0);
+  return &frames[vtop (kpage) >> PGBITS];
+}
+
+/* Sets up the frame table for every physical frame.  Must be called
+   after palloc_init(). */
+void
+frame_init (void)
+{
+  size_t pages = DIV_ROUND_UP (init_ram_pages * sizeof *frames, PGSIZE);
+
+  frames = palloc_get_multiple (PAL_ASSERT | PAL_ZERO, pages);
+  lock_init (&frame_lock);
+  cond_init (&frame_written);
+}
+
+/* Acquires the frame table lock unless the current thread already
+   holds it.  Returns true if it was already held, to be passed to
+   frame_table_unlock(). */
+bool
+frame_table_lock (void)
+{
+  bool lock_held = lock_held_by_current_thread (&frame_lock);
+  if (!lock_held)
+    lock_acquire (&frame_lock);
+  return lock_held;
+}
+
+/* Undoes frame_table_lock(), releasing the lock only if
+   frame_table_lock() acquired it. */
+void
+frame_table_unlock (bool held)
+{
+  if (!held)
+    lock_release (&frame_lock);
+}
+
+/* Releases the frame table lock, which the caller holds, until
+   page_evict() next finishes writing pages out. */
+void
+frame_table_wait (void)
+{
+  cond_wait (&frame_written, &frame_lock);
+}
+
+/* Wakes up the threads in frame_table_wait().  The caller must hold
+   the frame table lock. */
+void
+frame_table_signal (void)
+{
+  cond_broadcast (&frame_written, &frame_lock);
+}
+
+/* Gives frame KPAGE its owner, as frame_alloc() describes.  The
+   caller must hold frame_lock. */
+static void
+frame_claim (void *kpage, void *upage)
+{
+  struct frame *f = frame_of (kpage);
+
+  f->owner = upage != NULL ? thread_current () : NULL;
+  f->upage = upage;
+  f->pin_cnt = upage != NULL;
+}
+
+/* Returns a frame from the user pool, evicting a page of some
+   process if the pool is empty.  FLAGS are as for palloc_get_page();
+   PAL_USER is implied.  If UPAGE is nonnull, the frame is owned by
+   the current process, to be mapped at UPAGE, and comes back pinned
+   so it cannot be evicted before the caller has mapped and filled
+   it; the caller unpins it with frame_unpin().  Returns a null
+   pointer if no frame can be had.  The caller must not hold the
+   frame table lock, which eviction releases while it writes. */
+void *
+frame_alloc (enum palloc_flags flags, void *upage)
+{
+  void *kpage = palloc_get_page (PAL_USER | (flags & ~PAL_ASSERT));
+
+  /* executables nobody runs give their frames back before any
+     process loses a page */
+  while (kpage == NULL && exec_cache_reclaim ())
+    kpage = palloc_get_page (PAL_USER | (flags & ~PAL_ASSERT));
+
+  ASSERT (!lock_held_by_current_thread (&frame_lock));
+  lock_acquire (&frame_lock);
+
+  if (kpage == NULL)
+    {
+      kpage = frame_evict ();
+      if (kpage == NULL)
+        {
+          lock_release (&frame_lock);
+          if (flags & PAL_ASSERT)
+            PANIC ("frame_alloc: out of pages");
+          return NULL;
+        }
+      if (flags & PAL_ZERO)
+        memset (kpage, 0, PGSIZE);
+    }
+
+  frame_claim (kpage, upage);
+  lock_release (&frame_lock);
+  return kpage;
+}
+
+/* Like frame_alloc (0, UPAGE), but returns a null pointer instead
+   of evicting anything if the pool is empty, for reading pages in
+   before they are needed. */
+void *
+frame_try_alloc (void *upage)
+{
+  void *kpage = palloc_get_page (PAL_USER);
+
+  if (kpage != NULL)
+    {
+      bool held = frame_table_lock ();
+      frame_claim (kpage, upage);
+      frame_table_unlock (held);
+    }
+  return kpage;
+}
+
+/* Frees frame KPAGE, which no process may map any more. */
+void
+frame_free (void *kpage)
+{
+  bool held = frame_table_lock ();
+  struct frame *f = frame_of (kpage);
+
+  f->owner = NULL;
+  f->upage = NULL;
+  f->pin_cnt = 0;
+  frame_table_unlock (held);
+  palloc_free_page (kpage);
+}
+
+/* Makes the current process, which now maps shared frame KPAGE at
+   UPAGE all by itself, its owner. */
+void
+frame_adopt (void *kpage, void *upage)
+{
+  bool held = frame_table_lock ();
+  struct frame *f = frame_of (kpage);
+
+  f->owner = thread_current ();
+  f->upage = upage;
+  frame_table_unlock (held);
+}
+
+/* Marks frame KPAGE as shared, so that it is no longer evicted.
+   Its processes keep mapping it where its owner did. */
+void
+frame_disown (void *kpage)
+{
+  bool held = frame_table_lock ();
+  struct frame *f = frame_of (kpage);
+
+  f->owner = NULL;
+  frame_table_unlock (held);
+}
+
+/* Finds the process that maps frame KPAGE at the frame's UPAGE, for
+   frame_readopt().  AUX is the frame. */
+static void
+find_mapper (struct thread *t, void *aux)
+{
+  struct frame *f = aux;
+
+  if (f->owner == NULL && t->pagedir != NULL
+      && pagedir_get_page (t->pagedir, f->upage)
+             == ptov ((uintptr_t)(f - frames) << PGBITS))
+    f->owner = t;
+}
+
+/* Makes the process that maps shared frame KPAGE its owner again, now
+   that no other process shares it, so that it can be evicted.  Does
+   nothing if no process maps it.  The caller must hold the frame
+   table lock, so that no process drops its page directory
+   meanwhile. */
+void
+frame_readopt (void *kpage)
+{
+  struct frame *f = frame_of (kpage);
+  enum intr_level old_level;
+
+  ASSERT (lock_held_by_current_thread (&frame_lock));
+  if (f->owner != NULL || f->upage == NULL)
+    return;
+
+  old_level = intr_disable ();
+  thread_foreach (find_mapper, f);
+  intr_set_level (old_level);
+}
+
+/* Keeps frame KPAGE from being evicted until a matching
+   frame_unpin(). */
+void
+frame_pin (void *kpage)
+{
+  bool held = frame_table_lock ();
+  frame_of (kpage)->pin_cnt++;
+  frame_table_unlock (held);
+}
+
+/* Undoes one frame_pin() of frame KPAGE. */
+void
+frame_unpin (void *kpage)
+{
+  bool held = frame_table_lock ();
+  struct frame *f = frame_of (kpage);
+
+  ASSERT (f->pin_cnt > 0);
+  f->pin_cnt--;
+  frame_table_unlock (held);
+}
+
+/* Returns true if frame KPAGE is owned by OWNER and not pinned, so
+   that it may be evicted along with a neighbor.  The caller must
+   hold the frame table lock. */
+bool
+frame_evictable (void *kpage, struct thread *owner)
+{
+  struct frame *f = frame_of (kpage);
+
+  ASSERT (lock_held_by_current_thread (&frame_lock));
+  return f->owner == owner && f->pin_cnt == 0;
+}
+
+/* Chooses an owned, unpinned frame with the clock algorithm, evicts
+   its page from the owner and returns it, unowned.  A frame whose
+   page was accessed since the hand last passed gets another round.
+   Returns a null pointer if two full turns find nothing evictable.
+   The caller must hold frame_lock, which page_evict() may release
+   and reacquire. */
+static void *
+frame_evict (void)
+{
+  ASSERT (lock_held_by_current_thread (&frame_lock));
+
+  for (size_t i = 0; i < 2 * init_ram_pages; i++)
+    {
+      size_t idx = clock_hand;
+      struct frame *f = &frames[idx];
+      clock_hand = (clock_hand + 1) % init_ram_pages;
+
+      /* exiting processes clear their page directory first */
+      if (f->owner == NULL || f->pin_cnt > 0 || f->owner->pagedir == NULL)
+        continue;
+
+      void *kpage = ptov ((uintptr_t)idx << PGBITS);
+      uint32_t *pd = f->owner->pagedir;
+      if (pagedir_get_page (pd, f->upage) != kpage)
+        continue;
+      if (pagedir_is_accessed (pd, f->upage))
+        pagedir_set_accessed (pd, f->upage, false);
+      else if (page_evict (f->owner, f->upage))
+        {
+          f->owner = NULL;
+          f->upage = NULL;
+          return kpage;
+        }
+    }
+  return NULL;
+}
@@ -0,0 +1,25 @@
+#ifndef VM_FRAME_H
+#define VM_FRAME_H
+
+#include "threads/palloc.h"
+#include <stdbool.h>
+
+struct thread;
+
+void frame_init (void);
+void *frame_alloc (enum palloc_flags, void *upage);
+void *frame_try_alloc (void *upage);
+void frame_free (void *kpage);
+void frame_adopt (void *kpage, void *upage);
+void frame_disown (void *kpage);
+void frame_readopt (void *kpage);
+void frame_pin (void *kpage);
+void frame_unpin (void *kpage);
+bool frame_evictable (void *kpage, struct thread *owner);
+
+bool frame_table_lock (void);
+void frame_table_unlock (bool held);
+void frame_table_wait (void);
+void frame_table_signal (void);
+
+#endif /* vm/frame.h */
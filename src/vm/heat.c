@@ -0,0 +1,147 @@
+#include "vm/heat.h"
+#include "devices/timer.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "vm/frame.h"
+#include "vm/page.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+
+/* The heat sampler is a kernel thread that wakes up every
+   heat_interval ticks and samples the pages of each user process
+   with page_table_heat(), which clears their accessed and dirty
+   bits.  It is off unless the kernel is started with -heat, since
+   clearing accessed bits also hides recent use from frame_evict(). */
+
+/* Timer ticks between samples, or 0 if sampling is off. */
+static int64_t heat_interval;
+
+/* User processes to sample, by thread.heat_elem. */
+static struct list heat_list;
+
+/* Protects heat_list and the heat maps of the processes on it.
+   Acquired before the frame table lock. */
+static struct lock heat_lock;
+
+static const char *region_names[HEAT_REGION_CNT] = {
+  [HEAT_CODE] = "code",
+  [HEAT_DATA] = "data",
+  [HEAT_STACK] = "stack",
+  [HEAT_MMAP] = "mmap",
+};
+
+static thread_func heat_sampler NO_RETURN;
+
+/* Sets up the heat sampler, and starts it sampling every
+   INTERVAL_MS milliseconds unless INTERVAL_MS is 0. */
+void
+heat_init (unsigned interval_ms)
+{
+  list_init (&heat_list);
+  lock_init (&heat_lock);
+  if (interval_ms == 0)
+    return;
+
+  heat_interval = (int64_t)interval_ms * TIMER_FREQ / 1000;
+  if (heat_interval == 0)
+    heat_interval = 1;
+  if (thread_create ("heat", PRI_DEFAULT, heat_sampler, NULL) == TID_ERROR)
+    PANIC ("heat_init: cannot start the sampler");
+}
+
+/* Starts sampling the pages of T, which has just been given a page
+   directory. */
+void
+heat_add (struct thread *t)
+{
+  if (heat_interval == 0)
+    return;
+
+  t->heat = NULL;
+  lock_acquire (&heat_lock);
+  list_push_back (&heat_list, &t->heat_elem);
+  lock_release (&heat_lock);
+}
+
+/* Stops sampling the pages of T, which is about to destroy its page
+   directory, and prints its latest heat map. */
+void
+heat_remove (struct thread *t)
+{
+  struct heatmap *h;
+
+  if (heat_interval == 0)
+    return;
+
+  lock_acquire (&heat_lock);
+  list_remove (&t->heat_elem);
+  h = t->heat;
+  t->heat = NULL;
+  lock_release (&heat_lock);
+  if (h == NULL)
+    return;
+
+  printf ("heat: %s: %u samples, working set %u pages, peak %u pages\n",
+          t->name, h->samples, h->working_set, h->peak_working_set);
+  for (int r = 0; r < HEAT_REGION_CNT; r++)
+    {
+      struct heat_counts *c = &h->regions[r];
+      printf ("heat: %s: %-5s %5u hot %5u warm %5u cold %5u absent "
+              "%5u written\n",
+              t->name, region_names[r], c->hot, c->warm, c->cold, c->absent,
+              c->written);
+    }
+  free (h);
+}
+
+/* Copies the current process's latest heat map into *H, all zeros
+   if it has not been sampled yet.  Returns false if sampling is
+   off. */
+bool
+heat_get (struct heatmap *h)
+{
+  struct thread *t = thread_current ();
+
+  if (heat_interval == 0)
+    return false;
+
+  lock_acquire (&heat_lock);
+  if (t->heat != NULL)
+    *h = *t->heat;
+  else
+    memset (h, 0, sizeof *h);
+  lock_release (&heat_lock);
+  return true;
+}
+
+/* Samples the pages of every user process every heat_interval
+   ticks. */
+static void
+heat_sampler (void *aux UNUSED)
+{
+  for (;;)
+    {
+      struct list_elem *e;
+
+      timer_sleep (heat_interval);
+
+      lock_acquire (&heat_lock);
+      for (e = list_begin (&heat_list); e != list_end (&heat_list);
+           e = list_next (e))
+        {
+          struct thread *t = list_entry (e, struct thread, heat_elem);
+          if (t->heat == NULL)
+            t->heat = calloc (1, sizeof *t->heat);
+          if (t->heat == NULL)
+            continue;
+
+          bool held = frame_table_lock ();
+          ASSERT (t->pagedir != NULL);
+          page_table_heat (t, t->heat);
+          frame_table_unlock (held);
+        }
+      lock_release (&heat_lock);
+    }
+}
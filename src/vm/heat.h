@@ -0,0 +1,14 @@
+#ifndef VM_HEAT_H
+#define VM_HEAT_H
+
+#include <heat.h>
+#include <stdbool.h>
+
+struct thread;
+
+void heat_init (unsigned interval_ms);
+void heat_add (struct thread *);
+void heat_remove (struct thread *);
+bool heat_get (struct heatmap *);
+
+#endif /* vm/heat.h */
@@ -0,0 +1,781 @@
+#include "vm/page.h"
+#include "filesys/file.h"
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/exec-cache.h"
+#include "userprog/pagedir.h"
+#include "userprog/process.h"
+#include "userprog/usermem.h"
+#include "vm/frame.h"
+#include "vm/swap.h"
+#include <debug.h>
+#include <heat.h>
+#include <string.h>
+
+/* The supplemental page table of a process is a hash table of its
+   user pages, keyed by address, so finding the page behind a fault
+   takes constant time however many pages the process has.  It is
+   created with the page directory and destroyed with it, in one
+   pass over the table.
+
+   A table is changed by its own process, and by frame_evict() when
+   it takes a frame from the process, so both do so holding the
+   frame table lock.  Reading a table needs the lock only when
+   another process may evict pages from it at the same time. */
+
+static hash_hash_func page_hash;
+static hash_less_func page_less;
+static hash_action_func page_free;
+
+/* Returns a hash value for page P. */
+static unsigned
+page_hash (const struct hash_elem *p_, void *aux UNUSED)
+{
+  const struct page *p = hash_entry (p_, struct page, elem);
+  return hash_int (pg_no (p->upage));
+}
+
+/* Returns true if page A precedes page B. */
+static bool
+page_less (const struct hash_elem *a_, const struct hash_elem *b_,
+           void *aux UNUSED)
+{
+  const struct page *a = hash_entry (a_, struct page, elem);
+  const struct page *b = hash_entry (b_, struct page, elem);
+  return a->upage < b->upage;
+}
+
+/* Frees page P, for hash_destroy(). */
+static void
+page_free (struct hash_elem *p_, void *aux UNUSED)
+{
+  struct page *p = hash_entry (p_, struct page, elem);
+
+  if (p->image != NULL)
+    exec_cache_release (p->image);
+  if (p->location == PAGE_SWAP)
+    swap_free (p->swap_slot);
+  free (p);
+}
+
+/* Creates the current process's supplemental page table.  Returns
+   true if successful, false if memory runs out. */
+bool
+page_table_init (void)
+{
+  return hash_init (&thread_current ()->pages, page_hash, page_less, NULL);
+}
+
+/* Waits until page_evict() has written page P out, if it is doing
+   so.  The caller must hold the frame table lock, which is released
+   while waiting. */
+static void
+page_settle (struct page *p)
+{
+  while (p->evicting)
+    frame_table_wait ();
+}
+
+/* Frees the current process's supplemental page table.  Frames of
+   resident pages belong to its page directory and are freed with
+   it.  The page directory must be gone already, so that no more
+   pages start being evicted while we wait for those that have. */
+void
+page_table_destroy (void)
+{
+  struct thread *t = thread_current ();
+  struct hash_iterator i;
+  bool held;
+
+  ASSERT (t->pagedir == NULL);
+  held = frame_table_lock ();
+  hash_first (&i, &t->pages);
+  while (hash_next (&i))
+    page_settle (hash_entry (hash_cur (&i), struct page, elem));
+  frame_table_unlock (held);
+  hash_destroy (&t->pages, page_free);
+}
+
+/* Returns the page of T containing user address UADDR, or a null
+   pointer if there is none. */
+struct page *
+page_lookup (struct thread *t, const void *uaddr)
+{
+  struct page p;
+  struct hash_elem *e;
+
+  p.upage = pg_round_down (uaddr);
+  e = hash_find (&t->pages, &p.elem);
+  return e != NULL ? hash_entry (e, struct page, elem) : NULL;
+}
+
+/* Returns true if resident page P, mapped in page directory PD, was
+   written since it was read in. */
+static bool
+page_is_dirty (uint32_t *pd, const struct page *p)
+{
+  return p->dirty || pagedir_is_dirty (pd, p->upage);
+}
+
+/* Returns a new page at UPAGE in the current process's table, or a
+   null pointer if memory runs out or UPAGE is taken. */
+static struct page *
+page_insert (void *upage, bool writable, enum page_location location)
+{
+  struct page *p = calloc (1, sizeof *p);
+
+  if (p == NULL)
+    return NULL;
+  p->upage = upage;
+  p->writable = writable;
+  p->location = location;
+
+  bool held = frame_table_lock ();
+  bool inserted = hash_insert (&thread_current ()->pages, &p->elem) == NULL;
+  frame_table_unlock (held);
+  if (!inserted)
+    {
+      free (p);
+      return NULL;
+    }
+  return p;
+}
+
+/* Adds READ_BYTES + ZERO_BYTES bytes of memory at UPAGE to the
+   current process, to be filled in page by page on first access:
+   the first READ_BYTES from FILE starting at offset OFS, the rest
+   with zeros.  FILE must stay open as long as the process runs.
+   Returns true if successful, false if memory runs out or some of
+   the pages exist already. */
+bool
+page_add_file (struct file *file, off_t ofs, uint8_t *upage,
+               uint32_t read_bytes, uint32_t zero_bytes, bool writable)
+{
+  ASSERT ((read_bytes + zero_bytes) % PGSIZE == 0);
+  ASSERT (pg_ofs (upage) == 0);
+  ASSERT (ofs % PGSIZE == 0);
+
+  while (read_bytes > 0 || zero_bytes > 0)
+    {
+      size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
+      struct page *p = page_insert (
+          upage, writable, page_read_bytes > 0 ? PAGE_FILE : PAGE_ZERO);
+      if (p == NULL)
+        return false;
+      p->file = file;
+      p->ofs = ofs;
+      p->read_bytes = page_read_bytes;
+
+      read_bytes -= page_read_bytes;
+      zero_bytes -= PGSIZE - page_read_bytes;
+      ofs += PGSIZE;
+      upage += PGSIZE;
+    }
+  return true;
+}
+
+/* Adds read-only segment SEG of IMAGE to the current process, to be
+   mapped page by page on first access from the frames IMAGE shares
+   among all processes running it.  FILE is the process's handle on
+   the executable.  Each page keeps a use of IMAGE until the process
+   exits.  Returns true if successful, false if memory runs out or
+   some of the pages exist already. */
+bool
+page_add_image (struct exec_image *image, struct exec_segment *seg,
+                struct file *file)
+{
+  size_t page_cnt = (seg->read_bytes + seg->zero_bytes) / PGSIZE;
+
+  ASSERT (seg->frames != NULL);
+
+  for (size_t i = 0; i < page_cnt; i++)
+    {
+      struct page *p = page_insert (seg->upage + i * PGSIZE, false,
+                                    PAGE_IMAGE);
+      if (p == NULL)
+        return false;
+      p->file = file;
+      p->image = image;
+      p->seg = seg;
+      p->seg_page = i;
+      exec_cache_hold (image);
+    }
+  return true;
+}
+
+/* Records that UPAGE of the current process is resident, having
+   just been given a frame.  Returns true if successful, false if
+   memory runs out or UPAGE exists already. */
+bool
+page_add_frame (void *upage, bool writable)
+{
+  return page_insert (upage, writable, PAGE_FRAME) != NULL;
+}
+
+/* Maps the LENGTH bytes of FILE into the current process at UPAGE,
+   to be read in page by page on first access, like page_add_file(),
+   and written back to FILE when a page that was written is evicted
+   or unmapped.  FILE must stay open until the pages are removed
+   with page_unmap().  Returns true if successful, false if memory
+   runs out or some of the pages exist already, in which case none
+   are added. */
+bool
+page_add_mapping (struct file *file, off_t length, uint8_t *upage)
+{
+  off_t ofs;
+
+  ASSERT (pg_ofs (upage) == 0);
+
+  for (ofs = 0; ofs < length; ofs += PGSIZE)
+    {
+      struct page *p = page_insert (upage + ofs, true, PAGE_FILE);
+      if (p == NULL)
+        {
+          while (ofs > 0)
+            {
+              ofs -= PGSIZE;
+              page_remove (upage + ofs);
+            }
+          return false;
+        }
+      p->file = file;
+      p->ofs = ofs;
+      p->read_bytes = length - ofs < PGSIZE ? length - ofs : PGSIZE;
+      p->mapped = true;
+    }
+  return true;
+}
+
+/* Removes the PAGE_CNT pages at UPAGE from the current process,
+   which added them with page_add_mapping(), first writing those
+   that are resident and dirty back to their file. */
+void
+page_unmap (uint8_t *upage, size_t page_cnt)
+{
+  struct thread *t = thread_current ();
+
+  for (size_t i = 0; i < page_cnt; i++, upage += PGSIZE)
+    {
+      void *kpage = NULL;
+      bool held;
+
+      /* once out of the table the page cannot be evicted, so its
+         frame holds still while it is written */
+      held = frame_table_lock ();
+      struct page *p = page_lookup (t, upage);
+      ASSERT (p != NULL && p->mapped);
+      page_settle (p);
+      hash_delete (&t->pages, &p->elem);
+      if (p->location == PAGE_FRAME && page_is_dirty (t->pagedir, p))
+        kpage = pagedir_get_page (t->pagedir, upage);
+      frame_table_unlock (held);
+
+      if (kpage != NULL)
+        file_write_at (p->file, kpage, p->read_bytes, p->ofs);
+
+      held = frame_table_lock ();
+      pagedir_free_page (t->pagedir, upage);
+      frame_table_unlock (held);
+      page_free (&p->elem, NULL);
+    }
+}
+
+/* Removes UPAGE from the current process's table, if it is there.
+   If it is resident, the caller frees its frame. */
+void
+page_remove (void *upage)
+{
+  struct thread *t = thread_current ();
+  bool held = frame_table_lock ();
+  struct page *p = page_lookup (t, upage);
+
+  if (p != NULL)
+    {
+      page_settle (p);
+      hash_delete (&t->pages, &p->elem);
+    }
+  frame_table_unlock (held);
+
+  if (p != NULL)
+    page_free (&p->elem, NULL);
+}
+
+/* Maps KPAGE, a pinned frame holding the contents of page P of
+   the current process, and unpins it.  Returns true if successful,
+   false if memory runs out, in which case KPAGE is freed. */
+static bool
+page_map (struct page *p, void *kpage)
+{
+  struct thread *t = thread_current ();
+  bool held = frame_table_lock ();
+  bool success = pagedir_set_page (t->pagedir, p->upage, kpage, p->writable);
+
+  if (success && p->location == PAGE_SWAP)
+    {
+      /* the frame is all there is of the page now */
+      pagedir_set_dirty (t->pagedir, p->upage, true);
+      swap_free (p->swap_slot);
+    }
+  if (success)
+    {
+      p->location = PAGE_FRAME;
+      p->dirty = false;
+    }
+  frame_table_unlock (held);
+
+  if (!success)
+    {
+      frame_free (kpage);
+      return false;
+    }
+  frame_unpin (kpage);
+  return true;
+}
+
+/* Reads page P of the current process back from swap.  If the page
+   before it was the last one read back, the process is probably
+   sweeping through memory, so the pages that were swapped out with P
+   are read in the same transfer while there are free frames for
+   them. */
+static bool
+page_swap_in (struct page *p, void *kpage)
+{
+  struct thread *t = thread_current ();
+  struct page *cluster[SWAP_CLUSTER];
+  void *kpages[SWAP_CLUSTER];
+  size_t cnt = 1;
+  bool success = true;
+
+  cluster[0] = p;
+  kpages[0] = kpage;
+  if (t->last_swap_in + PGSIZE == p->upage)
+    {
+      bool held = frame_table_lock ();
+      while (cnt < SWAP_CLUSTER && is_user_vaddr (p->upage + cnt * PGSIZE))
+        {
+          struct page *q = page_lookup (t, p->upage + cnt * PGSIZE);
+          if (q == NULL || q->location != PAGE_SWAP || q->evicting
+              || q->swap_slot != p->swap_slot + cnt)
+            break;
+          kpages[cnt] = frame_try_alloc (q->upage);
+          if (kpages[cnt] == NULL)
+            break;
+          cluster[cnt++] = q;
+        }
+      frame_table_unlock (held);
+    }
+
+  swap_read (p->swap_slot, kpages, cnt);
+  for (size_t i = 0; i < cnt; i++)
+    if (!page_map (cluster[i], kpages[i]) && i == 0)
+      success = false;
+  t->last_swap_in = cluster[cnt - 1]->upage;
+  return success;
+}
+
+/* Brings in the page containing user address FAULT_ADDR, if the
+   current process has one there that is not resident.  Returns true
+   if successful, false if there is no such page or memory runs
+   out. */
+bool
+page_fault_in (const void *fault_addr)
+{
+  struct thread *t = thread_current ();
+  enum page_location location;
+  struct page *p;
+  uint8_t *kpage;
+  bool held;
+
+  if (t->pagedir == NULL || !is_user_vaddr (fault_addr))
+    return false;
+
+  /* Only this process adds or removes its pages, so P stays valid
+     after the lock is dropped, and once page_evict() has written it
+     out, nothing but this function changes a page that is not
+     resident. */
+  held = frame_table_lock ();
+  p = page_lookup (t, fault_addr);
+  if (p != NULL)
+    page_settle (p);
+  location = p != NULL ? p->location : PAGE_FRAME;
+  frame_table_unlock (held);
+  if (location == PAGE_FRAME)
+    return false;
+
+  if (location == PAGE_IMAGE)
+    {
+      kpage = exec_image_frame (p->image, p->seg, p->seg_page, p->file);
+      if (kpage == NULL)
+        return false;
+      held = frame_table_lock ();
+      bool success = pagedir_share_page (t->pagedir, p->upage, kpage, false);
+      if (success)
+        p->location = PAGE_FRAME;
+      frame_table_unlock (held);
+      return success;
+    }
+
+  /* read into a pinned frame with no lock held; zero pages come
+     from the pool the idle thread keeps zeroed */
+  kpage = frame_alloc (location == PAGE_ZERO ? PAL_ZERO : 0, p->upage);
+  if (kpage == NULL)
+    return false;
+  switch (location)
+    {
+    case PAGE_ZERO:
+      break;
+    case PAGE_FILE:
+      if (file_read_at (p->file, kpage, p->read_bytes, p->ofs)
+          != (off_t)p->read_bytes)
+        {
+          frame_free (kpage);
+          return false;
+        }
+      memset (kpage + p->read_bytes, 0, PGSIZE - p->read_bytes);
+      break;
+    case PAGE_SWAP:
+      return page_swap_in (p, kpage);
+    default:
+      NOT_REACHED ();
+    }
+  return page_map (p, kpage);
+}
+
+/* Grows the current process's stack down to the page containing
+   FAULT_ADDR, a user address it faulted on with its stack pointer at
+   ESP, if that looks like a stack access: no more than 32 bytes below
+   ESP, as PUSHA writes, and within stack_limit of the top of the
+   stack, clear of the guard at the bottom of the stack region.  If
+   the fault is on the page just below the stack, the stack is
+   probably growing fast, so the STACK_PREFETCH - 1 pages below are
+   mapped along with it while there are free frames for them.
+   Returns true if successful, false if FAULT_ADDR is not a stack
+   access or memory runs out. */
+bool
+page_grow_stack (const void *fault_addr, const void *esp)
+{
+  struct thread *t = thread_current ();
+  uint8_t *upage = pg_round_down (fault_addr);
+  uint8_t *limit = (uint8_t *)PHYS_BASE - STACK_MAX + STACK_GUARD;
+  size_t cnt = 1;
+
+  if (stack_limit < STACK_MAX - STACK_GUARD)
+    limit = (uint8_t *)PHYS_BASE - stack_limit;
+  if (t->pagedir == NULL || !is_user_vaddr (fault_addr) || upage < limit
+      || (const uint8_t *)fault_addr + 32 < (const uint8_t *)esp)
+    return false;
+
+  if (upage + PGSIZE == t->stack_low)
+    cnt = STACK_PREFETCH;
+  for (size_t i = 0; i < cnt && upage - i * PGSIZE >= limit; i++)
+    {
+      uint8_t *stack_page = upage - i * PGSIZE;
+      struct page *p = page_insert (stack_page, true, PAGE_ZERO);
+      if (p == NULL)
+        return i > 0;
+
+      /* a page mapped ahead that no frame is free for comes in
+         zeroed when first touched */
+      void *kpage = i == 0 ? frame_alloc (PAL_ZERO, stack_page)
+                           : frame_try_alloc (stack_page);
+      if (kpage == NULL)
+        return i > 0;
+      if (i > 0)
+        memset (kpage, 0, PGSIZE);
+      if (!page_map (p, kpage))
+        return i > 0;
+      if (stack_page < t->stack_low)
+        t->stack_low = stack_page;
+    }
+  return true;
+}
+
+/* Writes out the CNT pages in CLUSTER, just unmapped by
+   page_evict(), from frames KPAGES: to swap slots SLOT onward, or to
+   the file of CLUSTER[0], a memory-mapped page, if SLOT is
+   SWAP_ERROR.  The frames stay pinned and the pages marked evicting
+   while the frame table lock, which the caller holds, is released
+   for the transfer.  Then KPAGES[0] is left for frame_evict() to
+   reuse and the rest are freed. */
+static void
+page_write_out (struct page **cluster, void **kpages, size_t cnt,
+                size_t slot)
+{
+  for (size_t i = 0; i < cnt; i++)
+    {
+      cluster[i]->evicting = true;
+      frame_pin (kpages[i]);
+    }
+  frame_table_unlock (false);
+
+  if (slot != SWAP_ERROR)
+    swap_write (slot, kpages, cnt);
+  else
+    file_write_at (cluster[0]->file, kpages[0], cluster[0]->read_bytes,
+                   cluster[0]->ofs);
+
+  frame_table_lock ();
+  for (size_t i = 0; i < cnt; i++)
+    {
+      cluster[i]->evicting = false;
+      if (i > 0)
+        frame_free (kpages[i]);
+      else
+        frame_unpin (kpages[i]);
+    }
+  frame_table_signal ();
+}
+
+/* Takes resident page UPAGE away from process OWNER, whose frame
+   frame_evict() is about to reuse.  A clean page is dropped, since
+   its file or zeros give it back.  A dirty memory-mapped page is
+   written back to its file.  Any other dirty page is written to swap,
+   together with the cold, dirty pages that follow it in OWNER, if
+   their frames may be evicted, so that a run of pages goes out in
+   one transfer and frees several frames at once.  Returns true if
+   the page was evicted, false if it cannot be.  The caller must
+   hold the frame table lock, which is released while the pages are
+   written, so that other processes can fault and allocate
+   meanwhile; OWNER waits for them in page_settle(). */
+bool
+page_evict (struct thread *owner, void *upage)
+{
+  struct page *p = page_lookup (owner, upage);
+  uint32_t *pd = owner->pagedir;
+  struct page *cluster[SWAP_CLUSTER];
+  void *kpages[SWAP_CLUSTER];
+  enum intr_level old_level;
+  size_t cnt, slot;
+  bool dirty;
+
+  if (p == NULL || p->location != PAGE_FRAME || p->image != NULL)
+    return false;
+
+  /* OWNER may be preempted in the middle of a write, so check the
+     dirty bit and unmap the page in one step. */
+  old_level = intr_disable ();
+  dirty = page_is_dirty (pd, p);
+  if (!dirty)
+    pagedir_clear_page (pd, upage);
+  intr_set_level (old_level);
+  if (!dirty)
+    {
+      p->location = p->read_bytes > 0 ? PAGE_FILE : PAGE_ZERO;
+      return true;
+    }
+
+  cluster[0] = p;
+  kpages[0] = pagedir_get_page (pd, upage);
+  if (p->mapped)
+    {
+      old_level = intr_disable ();
+      pagedir_clear_page (pd, upage);
+      intr_set_level (old_level);
+      p->location = PAGE_FILE;
+      p->dirty = false;
+      page_write_out (cluster, kpages, 1, SWAP_ERROR);
+      return true;
+    }
+
+  for (cnt = 1; cnt < SWAP_CLUSTER; cnt++)
+    {
+      uint8_t *next = p->upage + cnt * PGSIZE;
+      if (!is_user_vaddr (next))
+        break;
+
+      struct page *q = page_lookup (owner, next);
+      void *kq = pagedir_get_page (pd, next);
+      if (q == NULL || q->location != PAGE_FRAME || q->image != NULL
+          || q->mapped || kq == NULL || !frame_evictable (kq, owner)
+          || pagedir_is_accessed (pd, next) || !page_is_dirty (pd, q))
+        break;
+      cluster[cnt] = q;
+      kpages[cnt] = kq;
+    }
+
+  slot = swap_alloc (cnt);
+  if (slot == SWAP_ERROR && cnt > 1)
+    {
+      cnt = 1;
+      slot = swap_alloc (cnt);
+    }
+  if (slot == SWAP_ERROR)
+    return false;
+
+  old_level = intr_disable ();
+  for (size_t i = 0; i < cnt; i++)
+    pagedir_clear_page (pd, cluster[i]->upage);
+  intr_set_level (old_level);
+  for (size_t i = 0; i < cnt; i++)
+    {
+      cluster[i]->location = PAGE_SWAP;
+      cluster[i]->swap_slot = slot + i;
+      cluster[i]->dirty = false;
+    }
+  page_write_out (cluster, kpages, cnt, slot);
+  return true;
+}
+
+/* Faults in the pages of the current process spanning the SIZE
+   bytes at user address UADDR, writing to them if WRITE is true, and
+   pins them in their frames, so that a system call can access them
+   while holding locks that page_fault_in() might need.  Returns false,
+   with nothing pinned, if the range is not mapped or not writable as
+   WRITE asks.  Undo with page_unpin(). */
+bool
+page_pin (const void *uaddr, size_t size, bool write)
+{
+  struct thread *t = thread_current ();
+  uint8_t *start = pg_round_down (uaddr);
+  uint8_t *end = (uint8_t *)uaddr + size;
+  uint8_t *upage;
+
+  if (size == 0)
+    return true;
+  for (upage = start; upage < end; upage += PGSIZE)
+    for (;;)
+      {
+        /* bring the page in, and make a private copy if it is
+           copy-on-write, then pin it unless it went away again */
+        if (!user_range_ok (upage, 1, write))
+          {
+            page_unpin (start, upage - start);
+            return false;
+          }
+
+        bool held = frame_table_lock ();
+        void *kpage = pagedir_get_page (t->pagedir, upage);
+        if (kpage != NULL)
+          frame_pin (kpage);
+        frame_table_unlock (held);
+        if (kpage != NULL)
+          break;
+      }
+  return true;
+}
+
+/* Unpins the pages spanning the SIZE bytes at user address UADDR,
+   pinned by page_pin(). */
+void
+page_unpin (const void *uaddr, size_t size)
+{
+  struct thread *t = thread_current ();
+  uint8_t *end = (uint8_t *)uaddr + size;
+  uint8_t *upage;
+
+  if (size == 0)
+    return;
+  for (upage = pg_round_down (uaddr); upage < end; upage += PGSIZE)
+    frame_unpin (pagedir_get_page (t->pagedir, upage));
+}
+
+/* Gives CHILD, being forked from PARENT, a copy of PARENT's table.
+   Resident pages are shared by pagedir_fork().  Pages reading from
+   PARENT's executable read from CHILD's own handle on it instead.
+   The caller holds the frame table lock, which is released while
+   any of PARENT's pages still being evicted are written out.
+   Returns true if successful, false if memory runs out. */
+bool
+page_table_copy (struct thread *child, struct thread *parent)
+{
+  struct hash_iterator i;
+
+  hash_first (&i, &parent->pages);
+  while (hash_next (&i))
+    {
+      struct page *p = hash_entry (hash_cur (&i), struct page, elem);
+      struct page *copy = malloc (sizeof *copy);
+      if (copy == NULL)
+        return false;
+
+      page_settle (p);
+      *copy = *p;
+      if (copy->location == PAGE_SWAP)
+        {
+          copy->swap_slot = swap_copy (p->swap_slot);
+          if (copy->swap_slot == SWAP_ERROR)
+            {
+              free (copy);
+              return false;
+            }
+        }
+      if (copy->file == parent->cur_file)
+        copy->file = child->cur_file;
+      if (copy->image != NULL)
+        exec_cache_hold (copy->image);
+      hash_insert (&child->pages, &copy->elem);
+    }
+  return true;
+}
+
+/* Returns the region of the address space page P is in. */
+static enum heat_region
+page_region (const struct page *p)
+{
+  if (p->mapped)
+    return HEAT_MMAP;
+  if (p->upage >= (uint8_t *)PHYS_BASE - STACK_MAX)
+    return HEAT_STACK;
+  return p->writable ? HEAT_DATA : HEAT_CODE;
+}
+
+/* Takes a sample of the heat of T's pages into H: shifts whether
+   each resident page was accessed or written since the last sample
+   into its history, clearing its accessed and dirty bits, and counts
+   the pages of each region by heat.  A page whose dirty bit is
+   cleared remembers that it is dirty in page.dirty.  The caller must
+   hold the frame table lock. */
+void
+page_table_heat (struct thread *t, struct heatmap *h)
+{
+  struct hash_iterator i;
+  unsigned working_set = 0;
+
+  memset (h->regions, 0, sizeof h->regions);
+  hash_first (&i, &t->pages);
+  while (hash_next (&i))
+    {
+      struct page *p = hash_entry (hash_cur (&i), struct page, elem);
+      struct heat_counts *c = &h->regions[page_region (p)];
+      bool accessed = false, written = false;
+
+      if (p->location == PAGE_FRAME)
+        {
+          /* T may be preempted in the middle of a write, so test and
+             clear the bits in one step */
+          enum intr_level old_level = intr_disable ();
+          accessed = pagedir_is_accessed (t->pagedir, p->upage);
+          written = pagedir_is_dirty (t->pagedir, p->upage);
+          if (accessed)
+            pagedir_set_accessed (t->pagedir, p->upage, false);
+          if (written)
+            {
+              pagedir_set_dirty (t->pagedir, p->upage, false);
+              p->dirty = true;
+            }
+          intr_set_level (old_level);
+        }
+      p->accessed_samples = p->accessed_samples >> 1 | accessed << 7;
+      p->written_samples = p->written_samples >> 1 | written << 7;
+
+      if (p->location != PAGE_FRAME)
+        c->absent++;
+      else if (p->accessed_samples >> (8 - HEAT_HOT) != 0)
+        c->hot++;
+      else if (p->accessed_samples != 0)
+        c->warm++;
+      else
+        c->cold++;
+      if (p->written_samples != 0)
+        c->written++;
+      if (p->accessed_samples != 0)
+        working_set++;
+    }
+
+  h->samples++;
+  h->working_set = working_set;
+  if (working_set > h->peak_working_set)
+    h->peak_working_set = working_set;
+}
@@ -0,0 +1,80 @@
+#ifndef VM_PAGE_H
+#define VM_PAGE_H
+
+#include "filesys/off_t.h"
+#include <hash.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct exec_image;
+struct exec_segment;
+struct file;
+struct heatmap;
+struct thread;
+
+/* Where the contents of a user page are. */
+enum page_location
+{
+  PAGE_ZERO,  /* Not loaded yet, all zeros. */
+  PAGE_FILE,  /* Not loaded yet, read from FILE, then zeros. */
+  PAGE_IMAGE, /* Not mapped yet, a frame of the executable cache. */
+  PAGE_SWAP,  /* Evicted to swap slot SWAP_SLOT. */
+  PAGE_FRAME  /* Resident, mapped to a frame by the page directory. */
+};
+
+/* A user page of a process, in its supplemental page table
+   (thread.pages), which says what the process's page directory
+   cannot: where a page that is not resident is to be found. */
+struct page
+{
+  struct hash_elem elem;       /* Element in thread.pages. */
+  uint8_t *upage;              /* User virtual address. */
+  bool writable;               /* Writable by the process? */
+  enum page_location location; /* Where the contents are. */
+
+  /* File-backed pages (PAGE_FILE). */
+  struct file *file;   /* File to read from. */
+  off_t ofs;           /* Offset in FILE. */
+  uint32_t read_bytes; /* Bytes to read, the rest are zeroed. */
+  bool mapped;         /* Memory-mapped, so written back to FILE. */
+
+  /* Pages shared through the executable cache (PAGE_IMAGE). */
+  struct exec_image *image; /* Image the process holds a use of. */
+  struct exec_segment *seg; /* Read-only segment of IMAGE. */
+  size_t seg_page;          /* Page number within SEG. */
+
+  /* Evicted pages (PAGE_SWAP). */
+  size_t swap_slot; /* Swap slot holding the contents. */
+  bool evicting;    /* Still being written out by page_evict(), to
+                       swap or to FILE. */
+
+  /* Heat, sampled by page_table_heat(). */
+  uint8_t accessed_samples; /* Bit 7 set if accessed in the latest
+                               sample, bit 6 in the one before... */
+  uint8_t written_samples;  /* Likewise, if written. */
+  bool dirty;               /* Written since the sampler cleared the
+                               dirty bit of its frame. */
+};
+
+bool page_table_init (void);
+void page_table_destroy (void);
+bool page_table_copy (struct thread *child, struct thread *parent);
+
+struct page *page_lookup (struct thread *, const void *uaddr);
+bool page_add_file (struct file *, off_t ofs, uint8_t *upage,
+                    uint32_t read_bytes, uint32_t zero_bytes, bool writable);
+bool page_add_image (struct exec_image *, struct exec_segment *,
+                     struct file *);
+bool page_add_frame (void *upage, bool writable);
+bool page_add_mapping (struct file *, off_t length, uint8_t *upage);
+void page_unmap (uint8_t *upage, size_t page_cnt);
+void page_remove (void *upage);
+bool page_fault_in (const void *fault_addr);
+bool page_grow_stack (const void *fault_addr, const void *esp);
+bool page_evict (struct thread *owner, void *upage);
+bool page_pin (const void *uaddr, size_t size, bool write);
+void page_unpin (const void *uaddr, size_t size);
+void page_table_heat (struct thread *, struct heatmap *);
+
+#endif /* vm/page.h */
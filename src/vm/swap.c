@@ -0,0 +1,121 @@
+#include "vm/swap.h"
+#include "devices/block.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include <bitmap.h>
+#include <debug.h>
+
+/* Sectors in a swap slot, which holds one page. */
+#define SECTORS_PER_SLOT (PGSIZE / BLOCK_SECTOR_SIZE)
+
+/* The swap device, or a null pointer if there is none, in which case
+   only pages that can be read back from their file are evicted. */
+static struct block *swap_device;
+
+/* Slots in use, one bit per page-sized slot. */
+static struct bitmap *swap_slots;
+
+/* Protects swap_slots.  Transfers happen without it; a slot belongs
+   to the page stored in it from swap_alloc() to swap_free(). */
+static struct lock swap_lock;
+
+/* Sets up the swap device, if there is one.  Must be called after
+   the block devices have been assigned their roles. */
+void
+swap_init (void)
+{
+  lock_init (&swap_lock);
+  swap_device = block_get_role (BLOCK_SWAP);
+  if (swap_device == NULL)
+    return;
+
+  swap_slots = bitmap_create (block_size (swap_device) / SECTORS_PER_SLOT);
+  if (swap_slots == NULL)
+    PANIC ("swap_init: bitmap creation failed");
+}
+
+/* Allocates CNT adjacent slots and returns the first, or SWAP_ERROR
+   if there is no swap device or no run of CNT free slots on it. */
+size_t
+swap_alloc (size_t cnt)
+{
+  size_t slot;
+
+  if (swap_device == NULL)
+    return SWAP_ERROR;
+
+  lock_acquire (&swap_lock);
+  slot = bitmap_scan_and_flip (swap_slots, 0, cnt, false);
+  lock_release (&swap_lock);
+  return slot != BITMAP_ERROR ? slot : SWAP_ERROR;
+}
+
+/* Frees SLOT. */
+void
+swap_free (size_t slot)
+{
+  lock_acquire (&swap_lock);
+  ASSERT (bitmap_test (swap_slots, slot));
+  bitmap_reset (swap_slots, slot);
+  lock_release (&swap_lock);
+}
+
+/* Transfers the CNT pages in PAGES to or from CNT adjacent slots
+   starting at SLOT, in one multi-sector transfer. */
+static void
+swap_transfer (size_t slot, void *const pages[], size_t cnt, bool write)
+{
+  void *sectors[SWAP_CLUSTER * SECTORS_PER_SLOT];
+  size_t i;
+
+  ASSERT (cnt <= SWAP_CLUSTER);
+
+  for (i = 0; i < cnt * SECTORS_PER_SLOT; i++)
+    sectors[i] = (uint8_t *)pages[i / SECTORS_PER_SLOT]
+                 + i % SECTORS_PER_SLOT * BLOCK_SECTOR_SIZE;
+  if (write)
+    block_write_multiple (swap_device, slot * SECTORS_PER_SLOT,
+                          cnt * SECTORS_PER_SLOT,
+                          (const void *const *)sectors);
+  else
+    block_read_multiple (swap_device, slot * SECTORS_PER_SLOT,
+                         cnt * SECTORS_PER_SLOT, sectors);
+}
+
+/* Writes the CNT pages in PAGES, at most SWAP_CLUSTER, to the CNT
+   slots starting at SLOT, as allocated by swap_alloc(). */
+void
+swap_write (size_t slot, void *const pages[], size_t cnt)
+{
+  swap_transfer (slot, pages, cnt, true);
+}
+
+/* Reads the CNT slots starting at SLOT into the CNT pages in PAGES,
+   at most SWAP_CLUSTER.  The slots stay allocated. */
+void
+swap_read (size_t slot, void *const pages[], size_t cnt)
+{
+  swap_transfer (slot, pages, cnt, false);
+}
+
+/* Returns a new slot holding a copy of SLOT, or SWAP_ERROR if swap
+   or memory runs out. */
+size_t
+swap_copy (size_t slot)
+{
+  void *page;
+  size_t copy;
+
+  page = palloc_get_page (0);
+  if (page == NULL)
+    return SWAP_ERROR;
+  copy = swap_alloc (1);
+  if (copy != SWAP_ERROR)
+    {
+      swap_read (slot, &page, 1);
+      swap_write (copy, &page, 1);
+    }
+  palloc_free_page (page);
+  return copy;
+}
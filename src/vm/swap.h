@@ -0,0 +1,20 @@
+#ifndef VM_SWAP_H
+#define VM_SWAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Most pages written or read ahead with one transfer. */
+#define SWAP_CLUSTER 8
+
+/* Returned by swap_alloc() when there is no room. */
+#define SWAP_ERROR ((size_t)-1)
+
+void swap_init (void);
+size_t swap_alloc (size_t cnt);
+void swap_free (size_t slot);
+void swap_write (size_t slot, void *const pages[], size_t cnt);
+void swap_read (size_t slot, void *const pages[], size_t cnt);
+size_t swap_copy (size_t slot);
+
+#endif /* vm/swap.h */